@@ -0,0 +1,41 @@
+#ifndef ATLAS_HPP_
+#define ATLAS_HPP_
+
+#include "base_type.hpp"
+
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// where a source image landed, remap its texture coordinate by
+// `offset + coord * scale` and sample from atlas page `page`
+struct AtlasRegion {
+  uint32_t page;
+  ::glm::vec2 offset;
+  ::glm::vec2 scale;
+
+  auto remap(::glm::vec2 const &coord) const -> ::glm::vec2 {
+    return this->offset + coord * this->scale;
+  }
+};
+
+// Pack the base level of `images` into as few pages of at most
+// `width` x `height` texels as possible. Each image is surrounded by at least
+// `padding` texels of its clamped border, so filtering doesn't bleed into the
+// neighbour. Padded rects and the page extent are aligned to the block of
+// the last level get_atlas_mip_levels allows. All images must share one
+// format. Pages are cropped to the packed area and returned without mip
+// levels, the regions follow the order of `images`.
+auto create_atlas(::std::vector<Image> const &images, int width, int height,
+                  int padding = 2)
+    -> ::std::pair<::std::vector<Image>, ::std::vector<AtlasRegion>>;
+
+// Level k halves the padding k times, past log2(padding) a texel averages
+// its neighbour in. create_atlas aligns rects so that the levels up to this
+// bound never mix two rects, build page mips with at most this many levels.
+auto get_atlas_mip_levels(int padding) -> int;
+
+#endif // ATLAS_HPP_
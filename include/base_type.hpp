@@ -1,34 +1,92 @@
 #ifndef BASE_TYPE_HPP_
 #define BASE_TYPE_HPP_
 
+#include <memory>
 #include <utility>
 #include <vector>
 
 #include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
 
 struct MVP {
   alignas(16)::glm::mat4 model, view, project;
 };
 
+// per-instance data of instanced draws, read at instance rate, see
+// get_instance_input_description
+struct Instance {
+  ::glm::mat4 model;
+  // texture coordinates are remapped to region.xy + coord * region.zw
+  ::glm::vec4 region;
+  uint32_t texture_index;
+};
+
+// who owns the texels behind an Image
+enum class ImageStorage {
+  kOwned,    // heap buffer allocated by the Image itself
+  kShared,   // reference counted buffer handed over by the caller
+  kBorrowed, // external memory the caller keeps alive, e.g. a staging arena
+  kMapped,   // read only file mapping
+};
+
+// Texels are immutable once in an Image, copies share them in O(1).
+// get_mutable_data() copies on write unless the Image is the sole owner.
 struct Image {
 public:
   Image() = default;
-  Image(::std::vector<unsigned char> const &image);
-  Image(unsigned char const *image, int width, int height);
-  Image(Image const &);
-  Image(Image &&) noexcept;
-  auto operator=(Image const &) -> Image &;
-  auto operator=(Image &&) noexcept -> Image &;
-  ~Image();
-
-  auto get_data() const -> unsigned char * { return this->data_; }
+  // channels is the requested channel count, 0 keeps the source's own count,
+  // srgb selects sRGB or UNORM encoding, HDR sources always decode to RGBA16F.
+  // sRGB grey and grey alpha widen to RGBA8, their formats are optional
+  Image(::std::vector<unsigned char> const &image, int channels = 4,
+        bool srgb = true);
+  // copy the texels into an owned buffer
+  Image(unsigned char const *image, int width, int height,
+        ::vk::Format format = ::vk::Format::eR8G8B8A8Srgb, int levels = 1);
+  // allocate an owned buffer, filled through get_mutable_data()
+  Image(int width, int height,
+        ::vk::Format format = ::vk::Format::eR8G8B8A8Srgb, int levels = 1);
+  // wrap texels without copying, data keeps whatever holds them alive
+  Image(::std::shared_ptr<unsigned char const> data, int width, int height,
+        ::vk::Format format, int levels, ImageStorage storage);
+
+  // external texels, data must outlive the Image and all of its copies
+  static auto borrow(unsigned char const *data, int width, int height,
+                     ::vk::Format format = ::vk::Format::eR8G8B8A8Srgb,
+                     int levels = 1) -> Image;
+
+  auto get_data() const -> unsigned char const * { return this->data_.get(); }
+  auto get_mutable_data() -> unsigned char *;
+  auto get_storage() const -> ImageStorage { return this->storage_; }
   auto get_width() const -> int { return this->width_; }
   auto get_height() const -> int { return this->height_; }
-  auto get_size() const -> size_t { return this->width_ * this->height_ * 4; }
+  auto get_levels() const -> int { return this->levels_; }
+  auto get_format() const -> ::vk::Format { return this->format_; }
+  auto get_channels() const -> int;
+  auto get_texel_size() const -> size_t;
+  auto get_size() const -> size_t;
+  auto get_level_offset(int level) const -> size_t;
 
 private:
-  unsigned char *data_{nullptr};
-  int width_{0}, height_{0};
+  ::std::shared_ptr<unsigned char const> data_;
+  ImageStorage storage_{ImageStorage::kOwned};
+  int width_{0}, height_{0}, levels_{1};
+  ::vk::Format format_{::vk::Format::eR8G8B8A8Srgb};
 };
 
+// channel count of the formats an Image can hold, 0 for anything else
+auto get_format_channels(::vk::Format format) -> int;
+
+// bytes per texel of the formats an Image can hold, 0 for anything else
+auto get_format_size(::vk::Format format) -> size_t;
+
+// bytes of the first levels mips of a width x height image
+auto image_size(int width, int height, int levels, size_t texel) -> size_t;
+
+// full mip chain length of a width x height image
+auto get_mip_levels(int width, int height) -> int;
+
+// build the mip chain of the image's base level, filter in linear space.
+// levels caps the chain, 0 builds all of it
+auto generate_mipmaps(Image const &image, int levels = 0) -> Image;
+
 #endif // BASE_TYPE_HPP_
@@ -0,0 +1,52 @@
+#ifndef BINDLESS_HPP_
+#define BINDLESS_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// One descriptor set holding every sampled image and sampler of an app, shaders
+// pick them by index (push constants or instance data) so draws with different
+// textures share the same set and pipeline layout.
+//
+//   layout(set = N, binding = 0) uniform sampler samplers[kSamplerCount];
+//   layout(set = N, binding = 1) uniform texture2D textures[];
+//
+// Both arrays are partially bound and update-after-bind, an index may be
+// written while the set is bound, as long as pending draws do not read it.
+// Needs DeviceFeatures::descriptor_indexing.
+class BindlessTable final {
+public:
+  static constexpr uint32_t kSamplerCount{16};
+
+  BindlessTable(::vk::PhysicalDevice &physical, ::vk::Device &device,
+                uint32_t max_images = 4096);
+  BindlessTable(BindlessTable const &) = delete;
+  BindlessTable &operator=(BindlessTable const &) = delete;
+
+  auto add_image(::vk::ImageView view) -> uint32_t;
+  auto set_image(uint32_t index, ::vk::ImageView view) -> void;
+  // the index is recycled, the caller makes sure no pending draw reads it
+  auto remove_image(uint32_t index) -> void;
+  auto add_sampler(::vk::Sampler sampler) -> uint32_t;
+
+  auto get_layout() const -> ::vk::DescriptorSetLayout { return this->layout_; }
+  auto get_set() const -> ::vk::DescriptorSet { return this->set_; }
+  auto get_max_images() const -> uint32_t { return this->max_images_; }
+
+  auto destroy() -> void;
+
+private:
+  ::vk::Device device_;
+  uint32_t max_images_;
+  ::vk::DescriptorPool pool_{nullptr};
+  ::vk::DescriptorSetLayout layout_{nullptr};
+  ::vk::DescriptorSet set_{nullptr};
+  uint32_t image_count_{0};
+  uint32_t sampler_count_{0};
+  ::std::vector<uint32_t> free_images_;
+};
+
+#endif // BINDLESS_HPP_
@@ -2,10 +2,14 @@
 #define CREATE_HPP_
 
 #include "base_type.hpp"
+#include "descriptor_allocator.hpp"
+#include "layout_cache.hpp"
 #include "window.hpp"
 
+#include <array>
 #include <filesystem>
 #include <optional>
+#include <tuple>
 
 #include <vulkan/vulkan.hpp>
 
@@ -14,6 +18,31 @@ struct QueueFamilyIndices {
   ::std::optional<uint32_t> present_indices;
 };
 
+// optional device capabilities, queried before the logic device is created and
+// enabled on it when present
+struct DeviceFeatures {
+  // VK_EXT_host_image_copy, textures are written from host memory directly
+  bool host_image_copy{false};
+  // 1.2 timeline semaphores, otherwise one fence per submission
+  bool timeline_semaphore{false};
+  // 1.2 descriptor indexing, partially bound update-after-bind sampled image
+  // arrays indexed at runtime, see BindlessTable
+  bool descriptor_indexing{false};
+  // 1.1 descriptor update templates, see create_update_template
+  bool update_template{false};
+  // VK_KHR_push_descriptor, small per-draw bindings are recorded inline with
+  // pushDescriptorSetKHR instead of allocated sets
+  bool push_descriptor{false};
+  // VK_EXT_descriptor_buffer with 1.2 buffer device address, descriptors are
+  // written into a mapped buffer, see DescriptorBuffer
+  bool descriptor_buffer{false};
+  // core multiDrawIndirect and drawIndirectFirstInstance, one indirect call
+  // issues many draws each reading its own instances, see GpuCuller
+  bool multi_draw_indirect{false};
+  // 1.2 drawIndirectCount, the GPU writes how many indirect draws to issue
+  bool draw_indirect_count{false};
+};
+
 struct SwapchainRequiredInfo {
   ::vk::SurfaceCapabilitiesKHR capabilities;
   ::vk::SurfaceFormatKHR format;
@@ -35,8 +64,11 @@ auto pickup_physical_device(::vk::Instance &instance, ::vk::SurfaceKHR &surface)
 auto pickup_queue_family(::vk::PhysicalDevice &device,
                          ::vk::SurfaceKHR &surface) -> QueueFamilyIndices;
 
+auto query_device_features(::vk::PhysicalDevice &physical) -> DeviceFeatures;
+
 auto create_logic_device(::vk::PhysicalDevice &physical,
                          QueueFamilyIndices &queue_indices,
+                         DeviceFeatures const &features = {},
                          ::std::vector<char const *> const &app_extensions = {
                              VK_KHR_SWAPCHAIN_EXTENSION_NAME}) -> ::vk::Device;
 
@@ -51,20 +83,42 @@ auto query_swapchain_required_info(SDL_Window *window,
                                    uint32_t image_count)
     -> SwapchainRequiredInfo;
 
-auto create_image_view(::vk::Device &device, ::vk::Image &image,
-                       ::vk::Format const &format) -> ::vk::ImageView;
+auto create_image_view(
+    ::vk::Device &device, ::vk::Image &image, ::vk::Format const &format,
+    uint32_t levels = 1,
+    ::vk::ImageAspectFlags aspect = ::vk::ImageAspectFlagBits::eColor,
+    uint32_t base_level = 0) -> ::vk::ImageView;
 
 auto create_image_views(::vk::Device &device,
                         ::std::vector<::vk::Image> &images,
-                        ::vk::Format const &format)
+                        ::vk::Format const &format, uint32_t levels = 1)
     -> ::std::vector<::vk::ImageView>;
 
-auto create_frame_buffers(::vk::Device &device,
-                          ::std::vector<::vk::ImageView> &views,
-                          ::vk::RenderPass &render_pass,
-                          SwapchainRequiredInfo &required_info)
+// one frame buffer per view, with the depth view of the same index as its
+// second attachment when depth_views is not empty
+auto create_frame_buffers(
+    ::vk::Device &device, ::std::vector<::vk::ImageView> &views,
+    ::vk::RenderPass &render_pass, SwapchainRequiredInfo &required_info,
+    ::std::vector<::vk::ImageView> const &depth_views = {})
     -> ::std::vector<::vk::Framebuffer>;
 
+// the first of D32, D32S8, D24S8, X8D24 and D16 the device attaches with
+// optimal tiling and supports for usage, e.g. sampling it
+auto pickup_depth_format(::vk::PhysicalDevice &physical,
+                         ::vk::ImageUsageFlags usage = {}) -> ::vk::Format;
+
+// A depth attachment. Without further usage it never leaves the render pass,
+// so the image is transient and bound to lazily allocated memory where the
+// device has it, which tiled GPUs keep on chip. Usage such as eSampled makes
+// it an ordinary device local image.
+auto create_depth_image(::vk::PhysicalDevice &physical, ::vk::Device &device,
+                        ::vk::Format format, ::vk::Extent2D const &extent,
+                        ::vk::ImageUsageFlags usage = {})
+    -> ::std::tuple<::vk::Image, ::vk::DeviceMemory, ::vk::ImageView>;
+
+// cleared on load and discarded on store
+auto get_depth_attachment(::vk::Format format) -> ::vk::AttachmentDescription;
+
 auto create_command_pool(::vk::Device &device,
                          QueueFamilyIndices &queue_indices)
     -> ::vk::CommandPool;
@@ -78,16 +132,16 @@ auto create_buffer(::vk::Device &device, QueueFamilyIndices &indices,
     -> ::vk::Buffer;
 
 auto create_image(::vk::Device &device, uint32_t width, uint32_t height,
-                  ::vk::ImageUsageFlags flag) -> ::vk::Image;
+                  ::vk::ImageUsageFlags flag, uint32_t levels = 1,
+                  ::vk::Format format = ::vk::Format::eR8G8B8A8Srgb)
+    -> ::vk::Image;
 
 auto create_shader_module(::vk::Device &device,
                           ::std::filesystem::path const &filename)
     -> ::vk::ShaderModule;
 
-auto create_image_data(::std::filesystem::path const &filename) -> Image;
-
-auto create_descriptor_pool(::vk::Device &device, size_t max_size,
-                            ::vk::DescriptorType type) -> ::vk::DescriptorPool;
+auto create_image_data(::std::filesystem::path const &filename,
+                       int channels = 4, bool srgb = true) -> Image;
 
 auto create_texture_sampler(::vk::PhysicalDevice &physical,
                             ::vk::Device &device) -> ::vk::Sampler;
@@ -101,8 +155,11 @@ auto create_fences(::vk::Device &device, size_t size)
 template <typename T, bool IsBuffer = ::std::is_same_v<T, ::vk::Buffer>,
           bool IsImage = ::std::is_same_v<T, ::vk::Image>,
           typename = ::std::enable_if_t<IsBuffer || IsImage>>
+// alloc_flag eDeviceAddress lets buffers bound to the memory report their
+// device address
 auto allocate_memory(::vk::PhysicalDevice &physical, ::vk::Device &device,
-                     T const &buffer, ::vk::MemoryPropertyFlags flag)
+                     T const &buffer, ::vk::MemoryPropertyFlags flag,
+                     ::vk::MemoryAllocateFlags alloc_flag = {})
     -> ::vk::DeviceMemory;
 
 template <typename T, bool IsBuffer = ::std::is_same_v<T, ::vk::Buffer>,
@@ -118,8 +175,8 @@ template <typename T, bool IsBuffer = ::std::is_same_v<T, ::vk::Buffer>,
               IsBuffer,
               ::std::vector<::std::tuple<::vk::Buffer, ::vk::DeviceMemory, T,
                                          ::vk::DeviceSize>>,
-              ::std::vector<::std::tuple<::vk::Buffer, ::vk::DeviceMemory, T,
-                                         uint32_t, uint32_t>>>,
+              ::std::vector<
+                  ::std::tuple<::vk::Buffer, ::vk::DeviceMemory, T, Image>>>,
           typename = ::std::enable_if_t<IsBuffer || IsImage>>
 auto allocate_memory(::vk::PhysicalDevice &physical, ::vk::Device &device,
                      ::vk::CommandPool &pool, ::vk::Queue &queue,
@@ -133,9 +190,23 @@ auto copy_buffer(::vk::Device &device, ::vk::CommandPool &pool,
                  ::vk::Queue &queue, ::vk::Buffer const &src,
                  ::vk::Buffer const &dest, ::vk::DeviceSize size) -> void;
 
+// record the staging copy of all levels, the image ends up in
+// eShaderReadOnlyOptimal, visible to fragment shaders
+auto record_copy_image(::vk::CommandBuffer &cmd_buffer, ::vk::Buffer const &src,
+                       ::vk::Image const &dest, uint32_t width,
+                       uint32_t height, uint32_t levels = 1,
+                       ::vk::Format format = ::vk::Format::eR8G8B8A8Srgb)
+    -> void;
+
 auto copy_image(::vk::Device &device, ::vk::CommandPool &pool,
                 ::vk::Queue &queue, ::vk::Buffer const &src,
-                ::vk::Image const &dest, uint32_t width, uint32_t height)
+                ::vk::Image const &dest, uint32_t width, uint32_t height,
+                uint32_t levels = 1,
+                ::vk::Format format = ::vk::Format::eR8G8B8A8Srgb) -> void;
+
+// host image copy, no staging buffer and no queue submission, dest must have
+// been created with eHostTransferEXT usage
+auto copy_image(::vk::Device &device, Image const &src, ::vk::Image const &dest)
     -> void;
 
 template <typename T>
@@ -145,11 +216,12 @@ auto wrap_buffer(::vk::PhysicalDevice &physical, ::vk::Device &device,
     -> ::std::tuple<::vk::Buffer, ::vk::DeviceMemory, ::vk::Buffer,
                     ::vk::DeviceSize>;
 
+// the staging buffer and memory are null when the image is uploaded with a
+// host image copy, allocate_memory picks the matching copy
 auto wrap_image(::vk::PhysicalDevice &physical, ::vk::Device &device,
                 QueueFamilyIndices &indices, Image const &image,
-                ::vk::ImageUsageFlags flag)
-    -> ::std::tuple<::vk::Buffer, ::vk::DeviceMemory, ::vk::Image, uint32_t,
-                    uint32_t>;
+                ::vk::ImageUsageFlags flag, DeviceFeatures const &features = {})
+    -> ::std::tuple<::vk::Buffer, ::vk::DeviceMemory, ::vk::Image, Image>;
 
 template <typename T, size_t N>
 auto wrap_buffer(::vk::PhysicalDevice &physical, ::vk::Device &device,
@@ -165,11 +237,31 @@ template <typename Buffer,
           typename Attr = ::std::enable_if_t<
               IsBuffer || IsView,
               ::std::conditional_t<IsBuffer, size_t, ::vk::Sampler>>>
-auto allocate_descriptor_set(::vk::Device &device, Iter begin, Iter end,
-                             ::vk::DescriptorType type,
+auto allocate_descriptor_set(::vk::Device &device, LayoutCache &layouts,
+                             DescriptorAllocator &allocator, Iter begin,
+                             Iter end, ::vk::DescriptorType type,
                              ::vk::ShaderStageFlags stage, Attr const &attr)
-    -> ::std::tuple<::vk::DescriptorPool, ::vk::DescriptorSetLayout,
-                    ::std::vector<::vk::DescriptorSet>>;
+    -> ::std::pair<::vk::DescriptorSetLayout,
+                   ::std::vector<::vk::DescriptorSet>>;
+
+// Instance read at instance rate from binding, the model matrix takes four
+// locations from first_location on, then region and texture_index
+auto get_instance_input_description(uint32_t binding, uint32_t first_location)
+    -> ::std::pair<::std::array<::vk::VertexInputAttributeDescription, 6>,
+                   ::vk::VertexInputBindingDescription>;
+
+// writes a whole set from one packed struct in a single call, each entry gives
+// a binding's offset and stride inside it.
+// Needs DeviceFeatures::update_template.
+auto create_update_template(
+    ::vk::Device &device, ::vk::DescriptorSetLayout layout,
+    ::std::vector<::vk::DescriptorUpdateTemplateEntry> const &entries)
+    -> ::vk::DescriptorUpdateTemplate;
+
+// data points at the packed struct the template's entries describe
+auto update_descriptor_set(::vk::Device &device, ::vk::DescriptorSet set,
+                           ::vk::DescriptorUpdateTemplate update_template,
+                           void const *data) -> void;
 
 #include "create.tcc"
 
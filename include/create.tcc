@@ -16,7 +16,8 @@ template <typename Int> auto gcd(Int num1, Int num2) -> Int {
 
 template <typename T, bool IsBuffer, bool IsImage, typename>
 auto allocate_memory(::vk::PhysicalDevice &physical, ::vk::Device &device,
-                     T const &buffer, ::vk::MemoryPropertyFlags flag)
+                     T const &buffer, ::vk::MemoryPropertyFlags flag,
+                     ::vk::MemoryAllocateFlags alloc_flag)
     -> ::vk::DeviceMemory {
   ::vk::MemoryRequirements requirement;
   if constexpr (IsBuffer) {
@@ -36,6 +37,10 @@ auto allocate_memory(::vk::PhysicalDevice &physical, ::vk::Device &device,
   }
   ::vk::MemoryAllocateInfo info;
   info.setAllocationSize(requirement.size).setMemoryTypeIndex(index);
+  ::vk::MemoryAllocateFlagsInfo flags_info{alloc_flag};
+  if (alloc_flag) {
+    info.setPNext(&flags_info);
+  }
   ::vk::DeviceMemory memory = device.allocateMemory(info);
   assert(memory && "device memory allocate failed!");
   if constexpr (IsBuffer) {
@@ -128,10 +133,13 @@ auto allocate_memory(::vk::PhysicalDevice &physical, ::vk::Device &device,
     if constexpr (IsBuffer) {
       copy_buffer(device, pool, queue, ::std::get<0>(buffer),
                   ::std::get<2>(buffer), ::std::get<3>(buffer));
+    } else if (!::std::get<0>(buffer)) {
+      copy_image(device, ::std::get<3>(buffer), ::std::get<2>(buffer));
     } else {
+      auto const &image = ::std::get<3>(buffer);
       copy_image(device, pool, queue, ::std::get<0>(buffer),
-                 ::std::get<2>(buffer), ::std::get<3>(buffer),
-                 ::std::get<4>(buffer));
+                 ::std::get<2>(buffer), image.get_width(), image.get_height(),
+                 image.get_levels(), image.get_format());
     }
   }
   return ::std::make_pair(::std::move(device_buffers), memory);
@@ -167,51 +175,48 @@ auto wrap_buffer(::vk::PhysicalDevice &physical, ::vk::Device &device,
 
 template <typename Buffer, typename Iter, bool IsBuffer, bool IsView,
           typename Attr>
-auto allocate_descriptor_set(::vk::Device &device, Iter begin, Iter end,
-                             ::vk::DescriptorType type,
+auto allocate_descriptor_set(::vk::Device &device, LayoutCache &layouts,
+                             DescriptorAllocator &allocator, Iter begin,
+                             Iter end, ::vk::DescriptorType type,
                              ::vk::ShaderStageFlags stage, Attr const &attr)
-    -> ::std::tuple<::vk::DescriptorPool, ::vk::DescriptorSetLayout,
-                    ::std::vector<::vk::DescriptorSet>> {
+    -> ::std::pair<::vk::DescriptorSetLayout,
+                   ::std::vector<::vk::DescriptorSet>> {
   size_t size = ::std::distance(begin, end);
   ::std::vector<::vk::DescriptorSetLayoutBinding> bindings;
   for (decltype(size) i = 0; i < size; ++i) {
     bindings.emplace_back(i, type, 1, stage);
+    // the sampler is baked into the layout, sets only carry the views
+    if constexpr (IsView) {
+      bindings.back().setImmutableSamplers(attr);
+    }
   }
-  ::vk::DescriptorSetLayout layout =
-      device.createDescriptorSetLayout(::vk::DescriptorSetLayoutCreateInfo{
-          ::vk::DescriptorSetLayoutCreateFlags{}, static_cast<uint32_t>(size),
-          bindings.data()});
-  assert(layout && "uniform descriptor set layout create failed!");
-  ::vk::DescriptorPool pool =
-      create_descriptor_pool(device, static_cast<uint32_t>(size), type);
-  ::vk::DescriptorSetAllocateInfo alloc_info;
-  alloc_info.setSetLayouts(layout)
-      .setDescriptorPool(pool)
-      .setDescriptorSetCount(1);
-  ::std::vector<::vk::DescriptorSet> sets =
-      device.allocateDescriptorSets(alloc_info);
-
-  ::vk::WriteDescriptorSet write_set;
-  ::std::conditional_t<IsBuffer, ::vk::DescriptorBufferInfo,
-                       ::vk::DescriptorImageInfo>
-      desc_info;
+  ::vk::DescriptorSetLayout layout = layouts.get_set_layout(bindings);
+  ::std::vector<::vk::DescriptorSet> sets = allocator.allocate(layout, 1);
+
+  // every write points into desc_infos, reserved so it never reallocates
+  ::std::vector<::std::conditional_t<IsBuffer, ::vk::DescriptorBufferInfo,
+                                     ::vk::DescriptorImageInfo>>
+      desc_infos;
+  desc_infos.reserve(size);
+  ::std::vector<::vk::WriteDescriptorSet> write_sets(size);
   for (decltype(size) i = 0; i < size; ++i) {
-    write_set.setDescriptorType(type)
+    write_sets[i]
+        .setDescriptorType(type)
         .setDstSet(sets.back())
         .setDstArrayElement(0)
         .setDstBinding(i);
     if constexpr (IsBuffer) {
-      desc_info.setOffset(0).setRange(attr).setBuffer(begin[i]);
-      write_set.setBufferInfo(desc_info);
+      desc_infos.emplace_back(begin[i], 0, attr);
+      write_sets[i].setBufferInfo(desc_infos.back());
     } else {
-      desc_info.setImageView(begin[i]).setSampler(attr).setImageLayout(
-          ::vk::ImageLayout::eShaderReadOnlyOptimal);
-      write_set.setImageInfo(desc_info);
+      desc_infos.emplace_back(attr, begin[i],
+                              ::vk::ImageLayout::eShaderReadOnlyOptimal);
+      write_sets[i].setImageInfo(desc_infos.back());
     }
-    device.updateDescriptorSets(write_set, {});
   }
+  device.updateDescriptorSets(write_sets, {});
 
-  return ::std::make_tuple(pool, layout, sets);
+  return ::std::make_pair(layout, sets);
 }
 
 #endif // CREATE_TCC
@@ -0,0 +1,50 @@
+#ifndef CULLING_HPP_
+#define CULLING_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// clip volume planes, normals point inwards, a point p is inside when
+// dot(plane.xyz, p) + plane.w >= 0 for every plane
+struct Frustum {
+  ::std::array<::glm::vec4, 6> planes;
+};
+
+// planes in the space view_project maps from, e.g. world space for
+// project * view of an MVP, or model space for the whole MVP
+auto extract_frustum(::glm::mat4 const &view_project) -> Frustum;
+
+// bounding spheres as structure of arrays
+struct SphereBounds {
+  ::std::vector<float> x, y, z, radius;
+
+  // xyz is the center, w the radius
+  auto push(::glm::vec4 const &sphere) -> void;
+  auto size() const -> size_t { return this->x.size(); }
+};
+
+// axis aligned boxes as structure of arrays
+struct BoxBounds {
+  ::std::array<::std::vector<float>, 3> min, max;
+
+  auto push(::glm::vec3 const &min, ::glm::vec3 const &max) -> void;
+  auto size() const -> size_t { return this->min[0].size(); }
+};
+
+// Test every volume against the frustum, visible receives the ascending
+// indices of the ones at least partly inside, ready to pick instances or
+// draws. Eight volumes are tested at once with AVX, four with SSE or NEON,
+// counts large enough are split between thread_count threads.
+auto cull_spheres(Frustum const &frustum, SphereBounds const &bounds,
+                  ::std::vector<uint32_t> &visible, unsigned thread_count = 1)
+    -> void;
+auto cull_boxes(Frustum const &frustum, BoxBounds const &bounds,
+                ::std::vector<uint32_t> &visible, unsigned thread_count = 1)
+    -> void;
+
+#endif // CULLING_HPP_
@@ -0,0 +1,62 @@
+#ifndef DEPTH_PYRAMID_HPP_
+#define DEPTH_PYRAMID_HPP_
+
+#include "create.hpp"
+#include "descriptor_allocator.hpp"
+#include "layout_cache.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <filesystem>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// A hierarchical Z buffer. Level 0 halves the depth buffer, rounding up, and
+// every further level halves the one before down to a single texel. A texel
+// holds the farthest depth of the 2x2 texels below it, so texel (x, y) of
+// level k bounds depth pixels [x, x + 1) * 2^(k + 1) and the same in y, odd
+// sizes included. build() records one compute dispatch of depth_reduce.comp
+// per level. The image stays in eGeneral, read it with get_sampler().
+class DepthPyramid final {
+public:
+  DepthPyramid() = default;
+  // shader is the compiled depth_reduce.comp, one source set per depth view
+  DepthPyramid(::vk::PhysicalDevice &physical, ::vk::Device &device,
+               LayoutCache &layouts, DescriptorAllocator &descriptors,
+               ::std::filesystem::path const &shader,
+               ::std::vector<::vk::ImageView> const &depth_views,
+               ::vk::Extent2D const &extent);
+  DepthPyramid(DepthPyramid const &) = delete;
+  DepthPyramid &operator=(DepthPyramid const &) = delete;
+  DepthPyramid(DepthPyramid &&) = default;
+  DepthPyramid &operator=(DepthPyramid &&) = default;
+
+  // outside of a render pass, depth_views[depth_index] in
+  // eDepthStencilReadOnlyOptimal with its writes visible to compute shaders.
+  // Compute shaders recorded afterwards see the whole pyramid.
+  auto build(::vk::CommandBuffer &cbuf, size_t depth_index) -> void;
+
+  // every level, read with texelFetch
+  auto get_view() const -> ::vk::ImageView { return this->view_; }
+  auto get_sampler() const -> ::vk::Sampler { return this->sampler_; }
+
+  auto destroy() -> void;
+
+private:
+  ::vk::Device device_{nullptr};
+  ::std::vector<::vk::Extent2D> extents_;
+  ::vk::Image image_{nullptr};
+  ::vk::DeviceMemory memory_{nullptr};
+  ::vk::ImageView view_{nullptr};
+  ::std::vector<::vk::ImageView> level_views_;
+  ::vk::Sampler sampler_{nullptr};
+  ::vk::PipelineLayout layout_{nullptr};
+  ::vk::Pipeline pipeline_{nullptr};
+  // one per depth view reducing it into level 0, then one per further level
+  ::std::vector<::vk::DescriptorSet> sets_;
+  size_t depth_count_{0};
+};
+
+#endif // DEPTH_PYRAMID_HPP_
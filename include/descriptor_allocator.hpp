@@ -0,0 +1,44 @@
+#ifndef DESCRIPTOR_ALLOCATOR_HPP_
+#define DESCRIPTOR_ALLOCATOR_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Hands out descriptor sets from a list of pools that hold every common
+// descriptor type. When the current pool is exhausted (eErrorOutOfPoolMemory
+// or eErrorFragmentedPool) the allocation moves on to a new pool, twice as
+// large as the last one. Sets are not freed one by one, reset() recycles every
+// pool in bulk, so one allocator per frame in flight makes transient sets cost
+// next to nothing.
+class DescriptorAllocator final {
+public:
+  DescriptorAllocator() = default;
+  explicit DescriptorAllocator(::vk::Device &device,
+                               uint32_t sets_per_pool = 64);
+  DescriptorAllocator(DescriptorAllocator const &) = delete;
+  DescriptorAllocator &operator=(DescriptorAllocator const &) = delete;
+  DescriptorAllocator(DescriptorAllocator &&) = default;
+  DescriptorAllocator &operator=(DescriptorAllocator &&) = default;
+
+  auto allocate(::vk::DescriptorSetLayout layout) -> ::vk::DescriptorSet;
+  auto allocate(::vk::DescriptorSetLayout layout, uint32_t count)
+      -> ::std::vector<::vk::DescriptorSet>;
+
+  // every set allocated so far becomes invalid, the pools are kept for reuse
+  auto reset() -> void;
+  auto destroy() -> void;
+
+private:
+  auto next_pool() -> ::vk::DescriptorPool;
+
+  ::vk::Device device_{nullptr};
+  uint32_t sets_per_pool_{64};
+  ::vk::DescriptorPool current_{nullptr};
+  ::std::vector<::vk::DescriptorPool> full_pools_;
+  ::std::vector<::vk::DescriptorPool> free_pools_;
+};
+
+#endif // DESCRIPTOR_ALLOCATOR_HPP_
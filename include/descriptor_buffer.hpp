@@ -0,0 +1,73 @@
+#ifndef DESCRIPTOR_BUFFER_HPP_
+#define DESCRIPTOR_BUFFER_HPP_
+
+#include "create.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Where an app keeps its descriptors, picked at startup so the paths can be
+// compared on the same device.
+enum class DescriptorBackend {
+  kPool,   // sets from a DescriptorAllocator
+  kPush,   // VK_KHR_push_descriptor, recorded inline
+  kBuffer, // VK_EXT_descriptor_buffer, see DescriptorBuffer
+};
+
+// Descriptors written straight into a mapped buffer with getDescriptorEXT, no
+// pool and no set objects. A "set" is an offset into the buffer, laid out by
+// a set layout created with eDescriptorBufferEXT, and is bound with
+// bindDescriptorBuffersEXT and setDescriptorBufferOffsetsEXT. Pipelines using
+// such layouts need eDescriptorBufferEXT too. Like UniformRing the buffer is
+// split into one region per frame in flight, begin_frame() rewinds one, sets
+// allocated before any begin_frame() live in the first region.
+// Needs DeviceFeatures::descriptor_buffer.
+class DescriptorBuffer final {
+public:
+  DescriptorBuffer() = default;
+  DescriptorBuffer(::vk::PhysicalDevice &physical, ::vk::Device &device,
+                   QueueFamilyIndices &indices, uint32_t frame_count,
+                   ::vk::DeviceSize frame_size = 64 << 10);
+  DescriptorBuffer(DescriptorBuffer const &) = delete;
+  DescriptorBuffer &operator=(DescriptorBuffer const &) = delete;
+  DescriptorBuffer(DescriptorBuffer &&) = default;
+  DescriptorBuffer &operator=(DescriptorBuffer &&) = default;
+
+  auto begin_frame(size_t frame) -> void;
+  // room for one set of layout, returns its offset
+  auto allocate(::vk::DescriptorSetLayout layout) -> ::vk::DeviceSize;
+  auto write(::vk::DeviceSize set, ::vk::DescriptorSetLayout layout,
+             uint32_t binding, ::vk::DescriptorType type,
+             ::vk::DescriptorBufferInfo const &info) -> void;
+  auto write(::vk::DeviceSize set, ::vk::DescriptorSetLayout layout,
+             uint32_t binding, ::vk::DescriptorType type,
+             ::vk::DescriptorImageInfo const &info) -> void;
+  // sets [first_set, first_set + sets.size()) of layout read from sets
+  auto bind(::vk::CommandBuffer &cbuf, ::vk::PipelineBindPoint bind_point,
+            ::vk::PipelineLayout layout, uint32_t first_set,
+            ::std::vector<::vk::DeviceSize> const &sets) const -> void;
+
+  auto destroy() -> void;
+
+private:
+  auto write_descriptor(::vk::DeviceSize set,
+                        ::vk::DescriptorSetLayout layout, uint32_t binding,
+                        ::vk::DescriptorGetInfoEXT const &info, size_t size)
+      -> void;
+
+  ::vk::Device device_{nullptr};
+  ::vk::PhysicalDeviceDescriptorBufferPropertiesEXT properties_;
+  ::vk::Buffer buffer_{nullptr};
+  ::vk::DeviceMemory memory_{nullptr};
+  ::vk::DeviceAddress address_{0};
+  unsigned char *mapped_{nullptr};
+  ::vk::DeviceSize frame_size_{0};
+  ::vk::DeviceSize begin_{0};
+  ::vk::DeviceSize head_{0};
+};
+
+#endif // DESCRIPTOR_BUFFER_HPP_
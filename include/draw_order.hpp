@@ -0,0 +1,13 @@
+#ifndef DRAW_ORDER_HPP_
+#define DRAW_ORDER_HPP_
+
+#include <stdint.h>
+
+// Sort key of an opaque draw, for an ascending radix_sort. The state, e.g.
+// pipeline << 16 | material, fills the high half so that draws sharing it
+// stay together, the view depth the low half so that every group is drawn
+// front to back and early depth testing rejects the fragments behind.
+// Negative depths count as zero.
+auto get_opaque_sort_key(uint32_t state, float depth) -> uint64_t;
+
+#endif // DRAW_ORDER_HPP_
@@ -0,0 +1,78 @@
+#ifndef GPU_CULLING_HPP_
+#define GPU_CULLING_HPP_
+
+#include "create.hpp"
+#include "descriptor_allocator.hpp"
+#include "layout_cache.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <filesystem>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+// one drawable of a GPU culled scene, matches DrawObject in cull.comp
+struct DrawObject {
+  ::glm::mat4 model;
+  // bounding sphere in model space, xyz is the center and w the radius
+  ::glm::vec4 sphere;
+  // index range of the bound index buffer
+  uint32_t first_index;
+  uint32_t index_count;
+  int32_t vertex_offset;
+  // instance rate data of the object
+  uint32_t first_instance;
+};
+
+// GPU driven drawing of a fixed set of objects. cull() records a compute pass
+// testing every object's bounding sphere against the frustum and appending a
+// DrawIndexedIndirectCommand per visible object, draw() issues all of them
+// with one drawIndexedIndirectCount, so the CPU cost of a frame does not grow
+// with the object count. Without DeviceFeatures::draw_indirect_count the
+// commands are cleared first and every slot is drawn, culled slots draw
+// nothing. Command and count buffers are split into one region per frame in
+// flight. Needs DeviceFeatures::multi_draw_indirect.
+class GpuCuller final {
+public:
+  GpuCuller() = default;
+  // shader is the compiled cull.comp
+  GpuCuller(::vk::PhysicalDevice &physical, ::vk::Device &device,
+            QueueFamilyIndices &indices, ::vk::CommandPool &pool,
+            ::vk::Queue &queue, LayoutCache &layouts,
+            DescriptorAllocator &descriptors,
+            ::std::filesystem::path const &shader,
+            ::std::vector<DrawObject> const &objects, uint32_t frame_count,
+            DeviceFeatures const &features);
+  GpuCuller(GpuCuller const &) = delete;
+  GpuCuller &operator=(GpuCuller const &) = delete;
+  GpuCuller(GpuCuller &&) = default;
+  GpuCuller &operator=(GpuCuller &&) = default;
+
+  // outside of a render pass, before draw() of the same frame
+  auto cull(::vk::CommandBuffer &cbuf, size_t frame,
+            ::glm::mat4 const &view_project) -> void;
+  // inside the render pass, with the objects' pipeline and buffers bound
+  auto draw(::vk::CommandBuffer &cbuf, size_t frame) const -> void;
+
+  auto destroy() -> void;
+
+private:
+  ::vk::Device device_{nullptr};
+  bool draw_count_{false};
+  uint32_t object_count_{0};
+  // per-frame region sizes, aligned for storage buffer descriptors
+  ::vk::DeviceSize draw_region_{0};
+  ::vk::DeviceSize count_region_{0};
+  ::vk::PipelineLayout layout_{nullptr};
+  ::vk::Pipeline pipeline_{nullptr};
+  ::std::vector<::vk::DescriptorSet> sets_;
+  // [0] objects, [1] draw commands, [2] draw counts
+  ::std::vector<::vk::Buffer> buffers_;
+  ::vk::DeviceMemory object_memory_{nullptr};
+  ::vk::DeviceMemory draw_memory_{nullptr};
+};
+
+#endif // GPU_CULLING_HPP_
@@ -0,0 +1,18 @@
+#ifndef IMAGE_CACHE_HPP_
+#define IMAGE_CACHE_HPP_
+
+#include "base_type.hpp"
+
+#include <filesystem>
+
+// Decode an image through the on-disk texture cache. The cache entry keeps the
+// decoded and mipped texels in upload layout behind a small header, it is
+// validated by the source's mtime first and by the source's content hash when
+// the mtime changed. A missing or stale entry is rebuilt from the source.
+// A valid entry is returned mapped, its texels are never copied.
+// channels and srgb are forwarded to the Image decoder, see Image.
+auto create_cached_image_data(::std::filesystem::path const &filename,
+                              ::std::filesystem::path const &cache_dir,
+                              int channels = 4, bool srgb = true) -> Image;
+
+#endif // IMAGE_CACHE_HPP_
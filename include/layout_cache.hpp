@@ -0,0 +1,84 @@
+#ifndef LAYOUT_CACHE_HPP_
+#define LAYOUT_CACHE_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Creates each distinct descriptor set layout and pipeline layout once. Equal
+// requests return the same handle, so pipelines built from equal descriptions
+// share a compatible pipeline layout and bound sets survive pipeline switches.
+// Immutable samplers are part of a set layout's identity, keyed by handle, so
+// a layout keeps its samplers in use until evict_sampler() or destroy(). The
+// cache owns every handle it returns, they are released together by destroy().
+class LayoutCache final {
+public:
+  LayoutCache() = default;
+  explicit LayoutCache(::vk::Device &device);
+  LayoutCache(LayoutCache const &) = delete;
+  LayoutCache &operator=(LayoutCache const &) = delete;
+  LayoutCache(LayoutCache &&) = default;
+  LayoutCache &operator=(LayoutCache &&) = default;
+
+  // binding_flags is empty or holds one entry per binding
+  auto get_set_layout(
+      ::std::vector<::vk::DescriptorSetLayoutBinding> const &bindings,
+      ::vk::DescriptorSetLayoutCreateFlags flags = {},
+      ::std::vector<::vk::DescriptorBindingFlags> const &binding_flags = {})
+      -> ::vk::DescriptorSetLayout;
+  auto get_pipeline_layout(
+      ::std::vector<::vk::DescriptorSetLayout> const &set_layouts,
+      ::std::vector<::vk::PushConstantRange> const &ranges = {})
+      -> ::vk::PipelineLayout;
+
+  // Destroys the set layouts baking in sampler and the pipeline layouts built
+  // from them, before sampler is destroyed and its handle can be reused. No
+  // pipeline or set using them may still be in flight.
+  auto evict_sampler(::vk::Sampler sampler) -> void;
+
+  auto destroy() -> void;
+
+private:
+  struct Binding {
+    uint32_t binding;
+    ::vk::DescriptorType type;
+    uint32_t count;
+    ::vk::ShaderStageFlags stage;
+    ::vk::DescriptorBindingFlags flags;
+    ::std::vector<::vk::Sampler> immutable_samplers;
+
+    auto operator==(Binding const &rhs) const -> bool;
+  };
+
+  struct SetLayoutKey {
+    ::vk::DescriptorSetLayoutCreateFlags flags;
+    // sorted by binding number
+    ::std::vector<Binding> bindings;
+
+    auto operator==(SetLayoutKey const &rhs) const -> bool;
+  };
+
+  struct PipelineLayoutKey {
+    ::std::vector<::vk::DescriptorSetLayout> set_layouts;
+    ::std::vector<::vk::PushConstantRange> ranges;
+
+    auto operator==(PipelineLayoutKey const &rhs) const -> bool;
+  };
+
+  struct KeyHash {
+    auto operator()(SetLayoutKey const &key) const -> size_t;
+    auto operator()(PipelineLayoutKey const &key) const -> size_t;
+  };
+
+  ::vk::Device device_{nullptr};
+  ::std::unordered_map<SetLayoutKey, ::vk::DescriptorSetLayout, KeyHash>
+      set_layouts_;
+  ::std::unordered_map<PipelineLayoutKey, ::vk::PipelineLayout, KeyHash>
+      pipeline_layouts_;
+};
+
+#endif // LAYOUT_CACHE_HPP_
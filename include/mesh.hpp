@@ -0,0 +1,94 @@
+#ifndef MESH_HPP_
+#define MESH_HPP_
+
+#include "create.hpp"
+#include "vertex_layout.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <filesystem>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+struct MeshVertex {
+  ::glm::vec3 position;
+  ::glm::vec3 normal;
+  ::glm::vec2 texcoord;
+};
+
+// MeshVertex as uploaded, 20 bytes instead of 32. The normal is remapped
+// to [0, 1] for the always supported unsigned format, the shader undoes it
+// with normal * 2 - 1.
+struct PackedMeshVertex {
+  ::glm::vec3 position;
+  Unorm1010102 normal;
+  Half2 texcoord;
+};
+
+auto pack_vertex(MeshVertex const &vertex) -> PackedMeshVertex;
+
+// indexed triangle list
+struct Mesh {
+  ::std::vector<MeshVertex> vertices;
+  ::std::vector<uint32_t> indices;
+};
+
+// Parse a Wavefront OBJ, polygons are triangulated as fans and every
+// distinct position/texcoord/normal triple becomes one vertex. Smooth
+// normals are generated when the file has none, texcoords are flipped to
+// a top left origin.
+auto load_obj(::std::filesystem::path const &filename) -> Mesh;
+
+// load_obj followed by optimize_mesh
+auto load_mesh(::std::filesystem::path const &filename) -> Mesh;
+
+// merge vertices whose attributes are bitwise equal
+auto deduplicate_vertices(Mesh &mesh) -> void;
+
+// Reorder triangles for a post-transform vertex cache of about cache_size
+// entries, the Tipsify algorithm of Sander, Nehab and Barczak.
+auto optimize_vertex_cache(::std::vector<uint32_t> &indices,
+                           size_t vertex_count, uint32_t cache_size = 16)
+    -> void;
+
+// Split a cache optimized triangle order into clusters and draw the ones
+// facing outwards first, so that depth testing rejects more of what lies
+// behind. A cluster may cost threshold times the cache misses of the
+// whole run it was split from.
+auto optimize_overdraw(::std::vector<uint32_t> &indices,
+                       ::std::vector<MeshVertex> const &vertices,
+                       float threshold = 1.05f) -> void;
+
+// Renumber vertices in order of first use, unreferenced ones are dropped.
+auto optimize_vertex_fetch(Mesh &mesh) -> void;
+
+// deduplicate, then vertex cache, overdraw and vertex fetch in that order
+auto optimize_mesh(Mesh &mesh) -> void;
+
+// average cache miss per triangle of a FIFO cache, 0.5 is the ideal of a
+// large regular grid, 3 means no reuse at all
+auto get_acmr(::std::vector<uint32_t> const &indices, size_t vertex_count,
+              uint32_t cache_size = 16) -> float;
+
+// 16 bit indices whenever every vertex is addressable by them
+auto get_index_type(Mesh const &mesh) -> ::vk::IndexType;
+
+// Staging for the packed vertex buffer then the index buffer in the smallest
+// index type, hand both to allocate_memory.
+auto wrap_mesh(::vk::PhysicalDevice &physical, ::vk::Device &device,
+               QueueFamilyIndices &indices, Mesh const &mesh)
+    -> ::std::vector<::std::tuple<::vk::Buffer, ::vk::DeviceMemory,
+                                  ::vk::Buffer, ::vk::DeviceSize>>;
+
+// PackedMeshVertex at binding 0, locations 0 to 2
+auto get_mesh_input_description()
+    -> ::std::pair<::std::array<::vk::VertexInputAttributeDescription, 3>,
+                   ::vk::VertexInputBindingDescription>;
+
+#endif // MESH_HPP_
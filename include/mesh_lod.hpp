@@ -0,0 +1,98 @@
+#ifndef MESH_LOD_HPP_
+#define MESH_LOD_HPP_
+
+#include "mesh.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// one level of detail, a range of the mesh's index buffer
+struct MeshLod {
+  uint32_t first_index;
+  uint32_t index_count;
+  // how far, in mesh units, the level may stray from the full mesh
+  float error;
+};
+
+struct SimplifyResult {
+  ::std::vector<uint32_t> indices;
+  // in mesh units
+  float error;
+};
+
+// Collapse edges, cheapest quadric error first, until at most
+// target_index_count indices remain or the next collapse would move the
+// surface further than target_error, relative to the mesh's extent. Every
+// vertex collapses onto a neighbour, so the vertex buffer is shared with the
+// input. UV seams and non-manifold vertices stay, open borders only collapse
+// along themselves.
+auto simplify_mesh(::std::vector<uint32_t> const &indices,
+                   ::std::vector<MeshVertex> const &vertices,
+                   size_t target_index_count, float target_error)
+    -> SimplifyResult;
+
+// Append up to max_count - 1 coarser levels to mesh.indices, each with about
+// ratio times the triangles of the one before and its own vertex cache
+// order. The first level is the mesh as it was. Simplifying stops early when
+// a level would not shrink by a tenth.
+auto build_lods(Mesh &mesh, size_t max_count = 6, float ratio = .5f)
+    -> ::std::vector<MeshLod>;
+
+// screen pixels covered by one unit of length one unit in front of a
+// perspective camera
+auto get_lod_scale(float fovy, float viewport_height) -> float;
+
+// The coarsest level whose error stays under max_pixels on screen.
+// pixel_scale is the pixels one mesh unit covers where the instance is, e.g.
+// get_lod_scale(...) * instance scale / distance to the bounding sphere.
+auto select_lod(::std::vector<MeshLod> const &lods, float pixel_scale,
+                float max_pixels = 1.f) -> size_t;
+
+// a cluster of triangles with few enough vertices to stay on chip
+struct Meshlet {
+  uint32_t vertex_offset;
+  // in triangles, the meshlet draws index range [3 * offset, 3 * (offset +
+  // count)) of get_meshlet_indices
+  uint32_t triangle_offset;
+  uint32_t vertex_count;
+  uint32_t triangle_count;
+};
+
+// The bounding sphere, and the cone of the triangle normals. A meshlet is
+// backfacing, and may be skipped, when
+//   dot(center - eye, cone_axis) >= cone_cutoff * |center - eye| + radius
+struct MeshletBounds {
+  ::glm::vec3 center;
+  float radius;
+  ::glm::vec3 cone_axis;
+  // 1 when the normals spread too wide for the test to ever pass
+  float cone_cutoff;
+};
+
+struct Meshlets {
+  ::std::vector<Meshlet> meshlets;
+  ::std::vector<MeshletBounds> bounds;
+  // mesh vertex of every meshlet vertex
+  ::std::vector<uint32_t> vertices;
+  // three meshlet vertices per triangle
+  ::std::vector<uint8_t> triangles;
+};
+
+// Cut an index range into meshlets in triangle order, a cache optimized
+// order keeps them compact. max_vertices stays below 255.
+auto build_meshlets(uint32_t const *indices, size_t index_count,
+                    ::std::vector<MeshVertex> const &vertices,
+                    size_t max_vertices = 64, size_t max_triangles = 124)
+    -> Meshlets;
+
+auto is_meshlet_backfacing(MeshletBounds const &bounds, ::glm::vec3 const &eye)
+    -> bool;
+
+// the meshlets' triangles back as mesh indices, meshlet by meshlet
+auto get_meshlet_indices(Meshlets const &meshlets) -> ::std::vector<uint32_t>;
+
+#endif // MESH_LOD_HPP_
@@ -0,0 +1,88 @@
+#ifndef OCCLUSION_CULLING_HPP_
+#define OCCLUSION_CULLING_HPP_
+
+#include "create.hpp"
+#include "depth_pyramid.hpp"
+#include "descriptor_allocator.hpp"
+#include "gpu_culling.hpp"
+#include "layout_cache.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <filesystem>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+enum class CullPhase : uint32_t {
+  // objects visible last frame, frustum tested only
+  eEarly,
+  // every object, frustum and occlusion tested against the pyramid of the
+  // early phase's depth, only the newly visible ones are drawn
+  eLate,
+};
+
+// Two phase occlusion culling of a fixed set of objects, GpuCuller plus a
+// visibility bit per object that outlives the frame. A frame goes
+//   cull(early), render pass drawing draw(early) and storing depth,
+//   DepthPyramid::build, cull(late), render pass loading depth and colour
+//   drawing draw(late).
+// Last frame's visible set seen from this frame's camera stands in for the
+// previous depth buffer, so only objects coming out from behind others wait
+// for the late phase. The far plane is left to the rasterizer.
+// Spheres are projected with the 2D polyhedral bounds of Mara and McGuire,
+// and the pyramid level where the bounds cover at most 2x2 texels decides.
+// Needs DeviceFeatures::multi_draw_indirect and a symmetric perspective
+// camera.
+class OcclusionCuller final {
+public:
+  OcclusionCuller() = default;
+  // shader is the compiled occlusion cull.comp, pyramid must outlive the
+  // culler
+  OcclusionCuller(::vk::PhysicalDevice &physical, ::vk::Device &device,
+                  QueueFamilyIndices &indices, ::vk::CommandPool &pool,
+                  ::vk::Queue &queue, LayoutCache &layouts,
+                  DescriptorAllocator &descriptors,
+                  ::std::filesystem::path const &shader,
+                  ::std::vector<DrawObject> const &objects,
+                  DepthPyramid const &pyramid, ::vk::Extent2D const &extent,
+                  uint32_t frame_count, DeviceFeatures const &features);
+  OcclusionCuller(OcclusionCuller const &) = delete;
+  OcclusionCuller &operator=(OcclusionCuller const &) = delete;
+  OcclusionCuller(OcclusionCuller &&) = default;
+  OcclusionCuller &operator=(OcclusionCuller &&) = default;
+
+  // outside of a render pass, before draw() of the same phase. project is a
+  // perspective projection with near plane z_near.
+  auto cull(::vk::CommandBuffer &cbuf, size_t frame, CullPhase phase,
+            ::glm::mat4 const &view, ::glm::mat4 const &project, float z_near)
+      -> void;
+  // inside the render pass, with the objects' pipeline and buffers bound
+  auto draw(::vk::CommandBuffer &cbuf, size_t frame, CullPhase phase) const
+      -> void;
+
+  auto destroy() -> void;
+
+private:
+  // region of frame and phase in the command and count buffers
+  auto get_region(size_t frame, CullPhase phase) const -> size_t;
+
+  ::vk::Device device_{nullptr};
+  bool draw_count_{false};
+  uint32_t object_count_{0};
+  ::vk::Extent2D extent_;
+  ::vk::DeviceSize draw_region_{0};
+  ::vk::DeviceSize count_region_{0};
+  ::vk::PipelineLayout layout_{nullptr};
+  ::vk::Pipeline pipeline_{nullptr};
+  // one per region
+  ::std::vector<::vk::DescriptorSet> sets_;
+  // [0] objects, [1] visibility, [2] draw commands, [3] draw counts
+  ::std::vector<::vk::Buffer> buffers_;
+  ::vk::DeviceMemory object_memory_{nullptr};
+  ::vk::DeviceMemory draw_memory_{nullptr};
+};
+
+#endif // OCCLUSION_CULLING_HPP_
@@ -0,0 +1,38 @@
+#ifndef PIXEL_CONVERT_HPP_
+#define PIXEL_CONVERT_HPP_
+
+#include <stddef.h>
+
+enum class PixelIsa {
+  kScalar,
+  kSsse3,
+  kAvx2,
+  kNeon,
+};
+
+// Pixel conversion kernels, `count` is always a number of texels. Source and
+// destination must not overlap unless a kernel says it works in place.
+struct PixelKernels {
+  PixelIsa isa;
+  // RGB8 -> RGBA8, alpha is 255
+  void (*rgb_to_rgba)(unsigned char const *src, unsigned char *dest,
+                      size_t count);
+  // RGBA8 <-> BGRA8, works in place
+  void (*rgba_to_bgra)(unsigned char const *src, unsigned char *dest,
+                       size_t count);
+  // RGBA8, multiply color by alpha with exact rounding, works in place
+  void (*premultiply_alpha)(unsigned char const *src, unsigned char *dest,
+                            size_t count);
+  // sRGB RGBA8 -> linear RGBA32F, alpha is linear in both
+  void (*srgb_to_linear)(unsigned char const *src, float *dest, size_t count);
+  // linear RGBA32F -> sRGB RGBA8, alpha is linear in both
+  void (*linear_to_srgb)(float const *src, unsigned char *dest, size_t count);
+};
+
+// the fastest kernels the running CPU supports, chosen once
+auto get_pixel_kernels() -> PixelKernels const &;
+
+// kernels of one instruction set, nullptr when the CPU or build lacks it
+auto get_pixel_kernels(PixelIsa isa) -> PixelKernels const *;
+
+#endif // PIXEL_CONVERT_HPP_
@@ -0,0 +1,56 @@
+#ifndef RADIX_SORT_HPP_
+#define RADIX_SORT_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Stable LSD radix sort of unsigned keys, 8 bits per pass. order receives the
+// indices of keys in ascending key order, scratch is working memory, both
+// keep their capacity so per-frame sorts do not allocate. Passes whose digit
+// is the same for every key are skipped, so narrow keys in wide types cost
+// only the passes they need.
+template <typename Key>
+auto radix_sort(Key const *keys, size_t count, ::std::vector<uint32_t> &order,
+                ::std::vector<uint32_t> &scratch) -> void {
+  static_assert(::std::is_unsigned_v<Key>, "radix sort keys are unsigned!");
+  order.resize(count);
+  scratch.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    order[i] = static_cast<uint32_t>(i);
+  }
+
+  // every histogram in one read of the keys
+  ::std::array<::std::array<uint32_t, 256>, sizeof(Key)> histograms{};
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t pass = 0; pass < sizeof(Key); ++pass) {
+      ++histograms[pass][(keys[i] >> (pass * 8)) & 0xff];
+    }
+  }
+
+  for (size_t pass = 0; pass < sizeof(Key); ++pass) {
+    auto &histogram = histograms[pass];
+    if (count == 0 ||
+        histogram[(keys[0] >> (pass * 8)) & 0xff] == count) {
+      continue;
+    }
+    // exclusive prefix sum, the first slot of every digit
+    uint32_t sum{0};
+    for (auto &bucket : histogram) {
+      uint32_t size = bucket;
+      bucket = sum;
+      sum += size;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      uint32_t index = order[i];
+      scratch[histogram[(keys[index] >> (pass * 8)) & 0xff]++] = index;
+    }
+    order.swap(scratch);
+  }
+}
+
+#endif // RADIX_SORT_HPP_
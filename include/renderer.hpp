@@ -2,6 +2,9 @@
 #define RENDERER_HPP_
 
 #include "create.hpp"
+#include "descriptor_allocator.hpp"
+#include "layout_cache.hpp"
+#include "uniform_ring.hpp"
 #include "window.hpp"
 
 #include <initializer_list>
@@ -20,9 +23,16 @@ public:
   auto destroy() -> void;
 
 protected:
+  // depth tested and written once create_depth_buffers has run
   auto create_pipeline(
-      ::std::initializer_list<::vk::PipelineShaderStageCreateInfo> stages)
-      -> ::vk::Pipeline;
+      ::std::initializer_list<::vk::PipelineShaderStageCreateInfo> stages,
+      ::vk::PipelineCreateFlags flags = {}) -> ::vk::Pipeline;
+
+  // One depth image per swapchain image, for apps whose render pass has a
+  // get_depth_attachment after the colour one. Hand depth_imageviews_ to
+  // create_frame_buffers. usage picks the format and is handed to
+  // create_depth_image.
+  auto create_depth_buffers(::vk::ImageUsageFlags usage = {}) -> void;
 
 private:
   static auto render(Renderer<App> *app) -> void;
@@ -37,11 +47,19 @@ protected:
   ::vk::Instance instance_{nullptr};
   ::vk::SurfaceKHR surface_{nullptr};
   ::vk::PhysicalDevice physical_{nullptr};
+  DeviceFeatures features_;
   ::vk::Device device_{nullptr};
   ::vk::Queue graphics_{nullptr};
   ::vk::Queue present_{nullptr};
   ::vk::SwapchainKHR swapchain_{nullptr};
   ::vk::CommandPool cmdpool_{nullptr};
+  // sets living as long as the app, and sets living one frame which are
+  // recycled before that frame records again
+  DescriptorAllocator descriptors_;
+  LayoutCache layouts_;
+  ::std::vector<DescriptorAllocator> frame_descriptors_;
+  // per-frame constants, rewound before each frame records
+  UniformRing uniforms_;
 
   SwapchainRequiredInfo required_info_;
   ::vk::RenderPass render_pass_{nullptr};
@@ -51,6 +69,10 @@ protected:
   ::std::vector<::vk::Image> swapchain_images_;
   ::std::vector<::vk::ImageView> swapchain_imageviews_;
   ::std::vector<::vk::Framebuffer> framebuffers_;
+  ::vk::Format depth_format_{::vk::Format::eUndefined};
+  ::std::vector<::vk::Image> depth_images_;
+  ::std::vector<::vk::DeviceMemory> depth_memories_;
+  ::std::vector<::vk::ImageView> depth_imageviews_;
   ::std::vector<::vk::CommandBuffer> cmd_buffers_;
   ::std::vector<::vk::Semaphore> image_avaliables_;
   ::std::vector<::vk::Semaphore> present_finishes_;
@@ -63,7 +85,9 @@ template <typename App> auto Renderer<App>::init() -> void {
   this->physical_ = pickup_physical_device(this->instance_, this->surface_);
   QueueFamilyIndices queue_indices =
       pickup_queue_family(this->physical_, this->surface_);
-  this->device_ = create_logic_device(this->physical_, queue_indices);
+  this->features_ = query_device_features(this->physical_);
+  this->device_ =
+      create_logic_device(this->physical_, queue_indices, this->features_);
   this->graphics_ =
       this->device_.getQueue(queue_indices.graphics_indices.value(), 0);
   this->present_ =
@@ -80,6 +104,15 @@ template <typename App> auto Renderer<App>::init() -> void {
   this->cmdpool_ = create_command_pool(this->device_, queue_indices);
   this->cmd_buffers_ = allocate_command_buffers(
       this->device_, this->cmdpool_, this->required_info_.image_count);
+  this->descriptors_ = DescriptorAllocator{this->device_};
+  this->layouts_ = LayoutCache{this->device_};
+  for (decltype(required_info_.image_count) i = 0;
+       i < required_info_.image_count; ++i) {
+    this->frame_descriptors_.emplace_back(this->device_);
+  }
+  this->uniforms_ = UniformRing{this->physical_, this->device_, queue_indices,
+                                this->required_info_.image_count,
+                                this->features_.descriptor_buffer};
 
   this->image_avaliables_ =
       create_semaphores(this->device_, this->required_info_.image_count);
@@ -93,8 +126,8 @@ template <typename App> auto Renderer<App>::init() -> void {
 
 template <typename App>
 auto Renderer<App>::create_pipeline(
-    ::std::initializer_list<::vk::PipelineShaderStageCreateInfo> stages)
-    -> ::vk::Pipeline {
+    ::std::initializer_list<::vk::PipelineShaderStageCreateInfo> stages,
+    ::vk::PipelineCreateFlags flags) -> ::vk::Pipeline {
   // vertex input
   auto [attr_descs, bind_desc] =
       this->underlying()->App::this_class::get_vertex_input_description();
@@ -129,7 +162,11 @@ auto Renderer<App>::create_pipeline(
   ::vk::PipelineMultisampleStateCreateInfo multi_info{
       {}, ::vk::SampleCountFlagBits::e1, 0u};
 
-  // depth stencil
+  // depth stencil, nearer fragments win
+  ::vk::PipelineDepthStencilStateCreateInfo depth_info;
+  depth_info.setDepthTestEnable(1u)
+      .setDepthWriteEnable(1u)
+      .setDepthCompareOp(::vk::CompareOp::eLess);
 
   // color blend
   ::vk::PipelineColorBlendAttachmentState color_att;
@@ -141,14 +178,16 @@ auto Renderer<App>::create_pipeline(
 
   // graphics pipeline
   ::vk::GraphicsPipelineCreateInfo info;
-  info.setStages(stages)
+  info.setFlags(flags)
+      .setStages(stages)
       .setPVertexInputState(&vertex_input)
       .setPInputAssemblyState(&input_asm)
       .setLayout(this->layout_)
       .setPViewportState(&viewport_state)
       .setPRasterizationState(&rast_info)
       .setPMultisampleState(&multi_info)
-      .setPDepthStencilState(nullptr)
+      .setPDepthStencilState(
+          this->depth_imageviews_.empty() ? nullptr : &depth_info)
       .setPColorBlendState(&color_state)
       .setRenderPass(this->render_pass_);
   auto result = this->device_.createGraphicsPipeline(nullptr, info);
@@ -157,20 +196,48 @@ auto Renderer<App>::create_pipeline(
   return result.value;
 }
 
+template <typename App>
+auto Renderer<App>::create_depth_buffers(::vk::ImageUsageFlags usage) -> void {
+  this->depth_format_ = pickup_depth_format(this->physical_, usage);
+  // the swapchain may hold more images than were asked for
+  for (size_t i = 0; i < this->swapchain_imageviews_.size(); ++i) {
+    auto [image, memory, view] =
+        create_depth_image(this->physical_, this->device_,
+                           this->depth_format_, this->required_info_.extent,
+                           usage);
+    this->depth_images_.push_back(image);
+    this->depth_memories_.push_back(memory);
+    this->depth_imageviews_.push_back(view);
+  }
+}
+
 template <typename App> auto Renderer<App>::run() -> void {
   this->window_.main_loop(this, &Renderer<App>::render);
   this->device_.waitIdle();
 }
 
 template <typename App> auto Renderer<App>::destroy() -> void {
+  // sets and layouts may still refer to the app's immutable samplers
+  for (auto &descriptors : this->frame_descriptors_) {
+    descriptors.destroy();
+  }
+  this->descriptors_.destroy();
+  this->layouts_.destroy();
   this->underlying()->App::this_class::app_destroy();
 
+  for (size_t i = 0; i < this->depth_images_.size(); ++i) {
+    this->device_.destroyImageView(this->depth_imageviews_[i]);
+    this->device_.destroyImage(this->depth_images_[i]);
+    this->device_.freeMemory(this->depth_memories_[i]);
+  }
+
   for (decltype(required_info_.image_count) i = 0;
        i < required_info_.image_count; ++i) {
     this->device_.destroyFence(this->fences_[i]);
     this->device_.destroySemaphore(this->present_finishes_[i]);
     this->device_.destroySemaphore(this->image_avaliables_[i]);
   }
+  this->uniforms_.destroy();
 
   this->device_.freeCommandBuffers(this->cmdpool_, this->cmd_buffers_);
   this->device_.destroyCommandPool(this->cmdpool_);
@@ -196,6 +263,9 @@ template <typename App> auto Renderer<App>::render(Renderer<App> *app) -> void {
   uint32_t image_index = option_index.value;
 
   app->cmd_buffers_[app->current_frame_].reset();
+  // the fence above has been waited, none of this frame's sets are in use
+  app->frame_descriptors_[app->current_frame_].reset();
+  app->uniforms_.begin_frame(app->current_frame_);
   app->underlying()->record_command(app->cmd_buffers_[app->current_frame_],
                                     app->framebuffers_[image_index]);
 
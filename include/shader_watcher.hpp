@@ -0,0 +1,41 @@
+#ifndef SHADER_WATCHER_HPP_
+#define SHADER_WATCHER_HPP_
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+// Recompiles the GLSL sources of a directory as they are saved, on a thread
+// of its own. Saves are picked up with inotify on Linux and by polling
+// modification times elsewhere. compiler is the glslangValidator or glslc
+// the build uses, called with the build's flags, and source.frag becomes
+// output_dir / source.frag.spv. on_compiled runs on the watcher thread with
+// both paths, sources failing to compile are reported on stderr by the
+// compiler and skipped.
+class ShaderWatcher final {
+public:
+  using Callback = ::std::function<void(::std::filesystem::path const &source,
+                                        ::std::filesystem::path const &binary)>;
+
+  ShaderWatcher(::std::filesystem::path source_dir,
+                ::std::filesystem::path output_dir,
+                ::std::filesystem::path compiler, Callback on_compiled);
+  ShaderWatcher(ShaderWatcher const &) = delete;
+  ShaderWatcher &operator=(ShaderWatcher const &) = delete;
+  // stops watching, a compile under way finishes first
+  ~ShaderWatcher();
+
+private:
+  auto watch() -> void;
+  auto compile(::std::filesystem::path const &source) -> void;
+
+  ::std::filesystem::path source_dir_;
+  ::std::filesystem::path output_dir_;
+  ::std::filesystem::path compiler_;
+  Callback on_compiled_;
+  ::std::atomic<bool> is_stopped_{false};
+  ::std::thread thread_;
+};
+
+#endif // SHADER_WATCHER_HPP_
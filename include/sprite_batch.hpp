@@ -0,0 +1,97 @@
+#ifndef SPRITE_BATCH_HPP_
+#define SPRITE_BATCH_HPP_
+
+#include "create.hpp"
+#include "vertex_layout.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+struct Sprite {
+  // center and extent in pixels
+  ::glm::vec2 position;
+  ::glm::vec2 size;
+  // radians, counter clockwise around the center
+  float rotation{0.f};
+  // texture coordinates are remapped to region.xy + coord * region.zw
+  ::glm::vec4 region{0.f, 0.f, 1.f, 1.f};
+  // RGBA8 in memory order, 0xAABBGGRR, multiplied with the texel
+  uint32_t color{0xffffffff};
+  // draw state, e.g. pipeline << 16 | texture, sprites of one key share a draw
+  uint32_t key{0};
+};
+
+// 16 bytes, texture coordinates in 16 bit fixed point
+struct SpriteVertex {
+  ::glm::vec2 position;
+  Unorm16x2 coord;
+  Unorm8x4 color;
+};
+
+// consecutive indices drawn with the same key
+struct SpriteRun {
+  uint32_t key;
+  uint32_t first_index;
+  uint32_t index_count;
+};
+
+// Collects the sprites of a frame and draws them with one indexed draw per
+// distinct key. flush() radix sorts the submissions by key, stable so sprites
+// of one key keep their submission order, and expands them into quads
+// written straight into a host visible vertex buffer that stays mapped. Like
+// UniformRing the buffer is split into one region per frame in flight, the
+// quad index buffer is shared and never changes.
+class SpriteBatch final {
+public:
+  SpriteBatch() = default;
+  SpriteBatch(::vk::PhysicalDevice &physical, ::vk::Device &device,
+              QueueFamilyIndices &indices, ::vk::CommandPool &pool,
+              ::vk::Queue &queue, uint32_t frame_count,
+              uint32_t max_sprites = 1 << 18);
+  SpriteBatch(SpriteBatch const &) = delete;
+  SpriteBatch &operator=(SpriteBatch const &) = delete;
+  SpriteBatch(SpriteBatch &&) = default;
+  SpriteBatch &operator=(SpriteBatch &&) = default;
+
+  // drop the last frame's sprites and write to frame's region, the GPU must
+  // be done reading it
+  auto begin_frame(size_t frame) -> void;
+  auto submit(Sprite const &sprite) -> void;
+  // sort and write the submitted sprites, draw each run with
+  // drawIndexed(index_count, 1, first_index, 0, 0) after bind()
+  auto flush() -> ::std::vector<SpriteRun> const &;
+  auto bind(::vk::CommandBuffer &cbuf) const -> void;
+
+  // SpriteVertex at binding 0, locations 0 to 2
+  static auto get_vertex_input_description()
+      -> ::std::pair<::std::array<::vk::VertexInputAttributeDescription, 3>,
+                     ::vk::VertexInputBindingDescription>;
+
+  auto destroy() -> void;
+
+private:
+  ::vk::Device device_{nullptr};
+  uint32_t max_sprites_{0};
+  ::vk::Buffer vertex_buffer_{nullptr};
+  ::vk::DeviceMemory vertex_memory_{nullptr};
+  unsigned char *mapped_{nullptr};
+  ::vk::DeviceSize frame_size_{0};
+  ::vk::DeviceSize begin_{0};
+  ::std::vector<::vk::Buffer> index_buffers_;
+  ::vk::DeviceMemory index_memory_{nullptr};
+
+  ::std::vector<Sprite> sprites_;
+  ::std::vector<uint32_t> keys_;
+  ::std::vector<uint32_t> order_;
+  ::std::vector<uint32_t> scratch_;
+  ::std::vector<SpriteRun> runs_;
+};
+
+#endif // SPRITE_BATCH_HPP_
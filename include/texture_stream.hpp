@@ -0,0 +1,107 @@
+#ifndef TEXTURE_STREAM_HPP_
+#define TEXTURE_STREAM_HPP_
+
+#include "base_type.hpp"
+#include "create.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+using TextureHandle = uint32_t;
+
+// Streams textures in behind a placeholder. request() returns at once with a
+// handle whose view is a 1x1 placeholder, the image is loaded on worker
+// threads, uploaded from update() within a per-frame byte budget and becomes
+// resident once its submission retires on the timeline semaphore.
+class TextureStreamer final {
+public:
+  TextureStreamer(::vk::PhysicalDevice &physical, ::vk::Device &device,
+                  QueueFamilyIndices &indices, ::vk::Queue &queue,
+                  DeviceFeatures const &features,
+                  ::vk::DeviceSize frame_budget = 8 << 20);
+  TextureStreamer(TextureStreamer const &) = delete;
+  TextureStreamer &operator=(TextureStreamer const &) = delete;
+  ~TextureStreamer();
+
+  // load runs on a worker and returns the full mip chain to upload
+  auto request(::std::function<Image()> load) -> TextureHandle;
+  auto request(::std::filesystem::path const &filename, int channels = 4,
+               bool srgb = true) -> TextureHandle;
+
+  // once per frame while no frame is in flight: retire finished uploads and
+  // start new ones, returns the handles that became resident, their
+  // descriptors should be pointed at get_view() again
+  auto update() -> ::std::vector<TextureHandle>;
+
+  auto get_view(TextureHandle handle) const -> ::vk::ImageView;
+  auto is_resident(TextureHandle handle) const -> bool;
+
+  // wait for pending uploads, stop workers and release every texture, must be
+  // called before the device is destroyed
+  auto destroy() -> void;
+
+private:
+  struct Texture {
+    ::vk::Image image{nullptr};
+    ::vk::DeviceMemory memory{nullptr};
+    ::vk::ImageView view{nullptr};
+    bool resident{false};
+  };
+
+  // one submission, its staging buffers are released when it retires
+  struct Batch {
+    uint64_t value{0};
+    ::vk::Fence fence{nullptr};
+    ::vk::CommandBuffer cmd_buffer{nullptr};
+    ::std::vector<::std::pair<::vk::Buffer, ::vk::DeviceMemory>> stagings;
+    ::std::vector<TextureHandle> handles;
+  };
+
+  struct Job {
+    TextureHandle handle;
+    ::std::function<Image()> load;
+  };
+
+  auto work() -> void;
+  auto stop_workers() -> void;
+  auto retire(::std::vector<TextureHandle> &residents) -> void;
+  auto is_finished(Batch const &batch) const -> bool;
+  auto upload(TextureHandle handle, Image const &image, Batch &batch) -> bool;
+
+  ::vk::PhysicalDevice physical_;
+  ::vk::Device device_;
+  QueueFamilyIndices indices_;
+  ::vk::Queue queue_;
+  DeviceFeatures features_;
+  ::vk::DeviceSize frame_budget_;
+
+  ::vk::CommandPool cmdpool_{nullptr};
+  ::vk::Semaphore timeline_{nullptr};
+  uint64_t timeline_value_{0};
+  ::vk::Image placeholder_{nullptr};
+  ::vk::DeviceMemory placeholder_memory_{nullptr};
+  ::vk::ImageView placeholder_view_{nullptr};
+
+  ::std::vector<Texture> textures_;
+  ::std::deque<Batch> batches_;
+  // decoded images in the order they finished, waiting for upload budget
+  ::std::deque<::std::pair<TextureHandle, Image>> ready_;
+
+  // shared with the workers
+  ::std::mutex mutex_;
+  ::std::condition_variable cond_;
+  bool is_stopped_{false};
+  ::std::deque<Job> jobs_;
+  ::std::vector<::std::pair<TextureHandle, Image>> loaded_;
+  ::std::vector<::std::thread> workers_;
+};
+
+#endif // TEXTURE_STREAM_HPP_
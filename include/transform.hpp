@@ -0,0 +1,67 @@
+#ifndef TRANSFORM_HPP_
+#define TRANSFORM_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// A transform hierarchy stored as structure of arrays. Nodes keep a local
+// translation, rotation and scale, update() turns them into affine world
+// matrices. Storage is kept sorted by depth, so every parent precedes its
+// children and the nodes of one depth are contiguous and independent: they
+// are updated in SIMD batches of four and, for large levels, in parallel
+// chunks. Only dirty subtrees are recomputed, setting a node dirties it and
+// everything below it. Nodes are named by the id add() returns, which stays
+// valid while storage is resorted.
+class TransformHierarchy final {
+public:
+  static uint32_t const kNoParent;
+
+  // parent must already exist
+  auto add(uint32_t parent = kNoParent) -> uint32_t;
+
+  auto set_translation(uint32_t id, ::glm::vec3 const &translation) -> void;
+  // unit quaternion
+  auto set_rotation(uint32_t id, ::glm::quat const &rotation) -> void;
+  auto set_scale(uint32_t id, ::glm::vec3 const &scale) -> void;
+
+  // recompute the world matrices of dirty nodes, levels with enough nodes
+  // are split between thread_count threads
+  auto update(unsigned thread_count = 1) -> void;
+
+  // valid after update()
+  auto get_world(uint32_t id) const -> ::glm::mat4;
+  // world matrices of all nodes in id order, the one of node i goes to
+  // dest + i * stride, e.g. the model of a mapped Instance array
+  auto write_world(void *dest, size_t stride = sizeof(::glm::mat4)) const
+      -> void;
+
+  auto size() const -> size_t { return this->parents_.size(); }
+
+private:
+  auto sort() -> void;
+  auto update_range(size_t begin, size_t end) -> void;
+
+  // per slot, in depth order
+  ::std::vector<uint32_t> parents_; // slot of the parent or kNoParent
+  ::std::vector<uint32_t> depths_;
+  ::std::vector<uint32_t> ids_;
+  ::std::vector<uint8_t> dirty_;
+  ::std::array<::std::vector<float>, 3> translation_;
+  ::std::array<::std::vector<float>, 4> rotation_; // x, y, z, w
+  ::std::array<::std::vector<float>, 3> scale_;
+  // affine 3x4 column major, element c * 3 + r
+  ::std::array<::std::vector<float>, 12> world_;
+
+  ::std::vector<uint32_t> slots_; // per id
+  // first slot of every depth, and the end
+  ::std::vector<size_t> levels_;
+  bool sorted_{true};
+};
+
+#endif // TRANSFORM_HPP_
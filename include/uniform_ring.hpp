@@ -0,0 +1,52 @@
+#ifndef UNIFORM_RING_HPP_
+#define UNIFORM_RING_HPP_
+
+#include "create.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.hpp>
+
+// A host visible uniform buffer that stays mapped, split into one region per
+// frame in flight. push() copies per-frame or per-draw constants into the
+// current region, aligned to minUniformBufferOffsetAlignment, and returns the
+// dynamic offset to bind them with. Descriptors are eUniformBufferDynamic
+// bindings over get_buffer() with a range of the largest pushed struct, so no
+// set is written and nothing is staged once they exist.
+class UniformRing final {
+public:
+  UniformRing() = default;
+  // device_address lets descriptor buffers point into the ring
+  UniformRing(::vk::PhysicalDevice &physical, ::vk::Device &device,
+              QueueFamilyIndices &indices, uint32_t frame_count,
+              bool device_address = false,
+              ::vk::DeviceSize frame_size = 64 << 10);
+  UniformRing(UniformRing const &) = delete;
+  UniformRing &operator=(UniformRing const &) = delete;
+  UniformRing(UniformRing &&) = default;
+  UniformRing &operator=(UniformRing &&) = default;
+
+  // rewind to the start of frame's region, the GPU must be done reading it
+  auto begin_frame(size_t frame) -> void;
+  auto push(void const *data, ::vk::DeviceSize size) -> uint32_t;
+  template <typename T> auto push(T const &data) -> uint32_t {
+    return this->push(&data, sizeof(T));
+  }
+
+  auto get_buffer() const -> ::vk::Buffer { return this->buffer_; }
+
+  auto destroy() -> void;
+
+private:
+  ::vk::Device device_{nullptr};
+  ::vk::Buffer buffer_{nullptr};
+  ::vk::DeviceMemory memory_{nullptr};
+  unsigned char *mapped_{nullptr};
+  ::vk::DeviceSize alignment_{1};
+  ::vk::DeviceSize frame_size_{0};
+  ::vk::DeviceSize begin_{0};
+  ::vk::DeviceSize head_{0};
+};
+
+#endif // UNIFORM_RING_HPP_
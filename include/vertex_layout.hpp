@@ -0,0 +1,204 @@
+#ifndef VERTEX_LAYOUT_HPP_
+#define VERTEX_LAYOUT_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <type_traits>
+#include <utility>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+// Packed attribute types, the shader reads them as floats. Constructors
+// clamp to the range of the encoding and round to nearest even.
+
+// IEEE binary16
+struct Half2 {
+  ::std::array<uint16_t, 2> bits;
+  Half2() = default;
+  explicit Half2(::glm::vec2 const &value);
+};
+struct Half4 {
+  ::std::array<uint16_t, 4> bits;
+  Half4() = default;
+  explicit Half4(::glm::vec4 const &value);
+};
+
+// [-1, 1] as signed integers, e.g. normals and tangents
+struct Snorm16x2 {
+  ::std::array<int16_t, 2> bits;
+  Snorm16x2() = default;
+  explicit Snorm16x2(::glm::vec2 const &value);
+};
+struct Snorm16x4 {
+  ::std::array<int16_t, 4> bits;
+  Snorm16x4() = default;
+  explicit Snorm16x4(::glm::vec4 const &value);
+};
+struct Snorm8x4 {
+  ::std::array<int8_t, 4> bits;
+  Snorm8x4() = default;
+  explicit Snorm8x4(::glm::vec4 const &value);
+};
+
+// [0, 1] as unsigned integers, e.g. texture coordinates and colours
+struct Unorm16x2 {
+  ::std::array<uint16_t, 2> bits;
+  Unorm16x2() = default;
+  explicit Unorm16x2(::glm::vec2 const &value);
+};
+// RGBA8 in memory order, 0xAABBGGRR
+struct Unorm8x4 {
+  uint32_t bits;
+  Unorm8x4() = default;
+  explicit Unorm8x4(::glm::vec4 const &value);
+  explicit Unorm8x4(uint32_t packed) : bits{packed} {}
+};
+
+// xyz in 10 bits each and w in 2, vertex fetch of the unsigned form is
+// always supported, of the signed one only where the device says so
+struct Unorm1010102 {
+  uint32_t bits;
+  Unorm1010102() = default;
+  explicit Unorm1010102(::glm::vec4 const &value);
+};
+struct Snorm1010102 {
+  uint32_t bits;
+  Snorm1010102() = default;
+  explicit Snorm1010102(::glm::vec4 const &value);
+};
+
+// The vertex input format of an attribute type, and how many locations it
+// spans. Types without a specialization cannot be attributes.
+template <typename T> struct VertexFormat {
+  static_assert(sizeof(T) == 0, "type has no vertex format!");
+};
+
+template <::vk::Format Format, uint32_t Locations = 1>
+struct VertexFormatOf {
+  static constexpr ::vk::Format value{Format};
+  static constexpr uint32_t locations{Locations};
+};
+
+template <>
+struct VertexFormat<float> : VertexFormatOf<::vk::Format::eR32Sfloat> {};
+template <>
+struct VertexFormat<::glm::vec2>
+    : VertexFormatOf<::vk::Format::eR32G32Sfloat> {};
+template <>
+struct VertexFormat<::glm::vec3>
+    : VertexFormatOf<::vk::Format::eR32G32B32Sfloat> {};
+template <>
+struct VertexFormat<::glm::vec4>
+    : VertexFormatOf<::vk::Format::eR32G32B32A32Sfloat> {};
+// one location per column
+template <>
+struct VertexFormat<::glm::mat4>
+    : VertexFormatOf<::vk::Format::eR32G32B32A32Sfloat, 4> {};
+template <>
+struct VertexFormat<uint32_t> : VertexFormatOf<::vk::Format::eR32Uint> {};
+template <>
+struct VertexFormat<int32_t> : VertexFormatOf<::vk::Format::eR32Sint> {};
+template <>
+struct VertexFormat<Half2> : VertexFormatOf<::vk::Format::eR16G16Sfloat> {};
+template <>
+struct VertexFormat<Half4>
+    : VertexFormatOf<::vk::Format::eR16G16B16A16Sfloat> {};
+template <>
+struct VertexFormat<Snorm16x2> : VertexFormatOf<::vk::Format::eR16G16Snorm> {
+};
+template <>
+struct VertexFormat<Snorm16x4>
+    : VertexFormatOf<::vk::Format::eR16G16B16A16Snorm> {};
+template <>
+struct VertexFormat<Snorm8x4> : VertexFormatOf<::vk::Format::eR8G8B8A8Snorm> {
+};
+template <>
+struct VertexFormat<Unorm16x2> : VertexFormatOf<::vk::Format::eR16G16Unorm> {
+};
+template <>
+struct VertexFormat<Unorm8x4> : VertexFormatOf<::vk::Format::eR8G8B8A8Unorm> {
+};
+template <>
+struct VertexFormat<Unorm1010102>
+    : VertexFormatOf<::vk::Format::eA2B10G10R10UnormPack32> {};
+template <>
+struct VertexFormat<Snorm1010102>
+    : VertexFormatOf<::vk::Format::eA2B10G10R10SnormPack32> {};
+
+namespace details {
+
+template <typename Member> struct MemberTraits;
+
+template <typename Class, typename T> struct MemberTraits<T Class::*> {
+  using class_type = Class;
+  using type = T;
+};
+
+template <auto Member>
+using member_class_t = typename MemberTraits<decltype(Member)>::class_type;
+
+template <auto Member>
+using member_type_t = typename MemberTraits<decltype(Member)>::type;
+
+template <auto... Members>
+constexpr uint32_t kLocationCount{
+    (VertexFormat<member_type_t<Members>>::locations + ...)};
+
+} // namespace details
+
+// Describe a vertex struct from pointers to its members, in location order
+// from first_location on, e.g.
+//   get_vertex_layout<&Vertex::position, &Vertex::normal>()
+// Formats and locations follow from the member types at compile time, as
+// does the check that every member is listed and none is padded. Only the
+// offsets are read at runtime, from the member pointers.
+template <auto First, auto... Rest>
+auto get_vertex_layout(
+    uint32_t binding = 0, uint32_t first_location = 0,
+    ::vk::VertexInputRate rate = ::vk::VertexInputRate::eVertex)
+    -> ::std::pair<::std::array<::vk::VertexInputAttributeDescription,
+                                details::kLocationCount<First, Rest...>>,
+                   ::vk::VertexInputBindingDescription> {
+  using Vertex = details::member_class_t<First>;
+  static_assert(
+      (::std::is_same_v<Vertex, details::member_class_t<Rest>> && ...),
+      "vertex attributes must be members of one struct!");
+  static_assert(::std::is_standard_layout_v<Vertex>,
+                "vertex struct must be standard layout!");
+  static_assert((sizeof(details::member_type_t<First>) + ... +
+                 sizeof(details::member_type_t<Rest>)) == sizeof(Vertex),
+                "vertex members missing from the layout or padded!");
+
+  static Vertex const vertex{};
+  ::std::array<::vk::VertexInputAttributeDescription,
+               details::kLocationCount<First, Rest...>>
+      attr_descs;
+  size_t index{0};
+  uint32_t location{first_location};
+  auto add = [&](auto member) {
+    using Type = typename details::MemberTraits<decltype(member)>::type;
+    using Format = VertexFormat<Type>;
+    auto offset = static_cast<uint32_t>(
+        reinterpret_cast<char const *>(&(vertex.*member)) -
+        reinterpret_cast<char const *>(&vertex));
+    for (uint32_t i = 0; i < Format::locations; ++i) {
+      attr_descs[index++]
+          .setBinding(binding)
+          .setLocation(location++)
+          .setFormat(Format::value)
+          .setOffset(offset + i * static_cast<uint32_t>(sizeof(Type) /
+                                                        Format::locations));
+    }
+  };
+  add(First);
+  (add(Rest), ...);
+
+  ::vk::VertexInputBindingDescription bind_desc;
+  bind_desc.setBinding(binding).setInputRate(rate).setStride(sizeof(Vertex));
+  return ::std::make_pair(attr_descs, bind_desc);
+}
+
+#endif // VERTEX_LAYOUT_HPP_
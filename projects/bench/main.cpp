@@ -0,0 +1,473 @@
+#include "culling.hpp"
+#include "mesh.hpp"
+#include "mesh_lod.hpp"
+#include "pixel_convert.hpp"
+#include "transform.hpp"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+size_t const kTexelCount{1024 * 1024 + 7}; // odd count exercises the tails
+
+int const kRepeatCount{32};
+
+uint32_t const kNodeCount{100000};
+
+uint32_t const kVolumeCount{1000000};
+
+uint32_t const kGridSide{256};
+
+auto get_isa_name(PixelIsa isa) -> char const * {
+  switch (isa) {
+  case PixelIsa::kScalar:
+    return "scalar";
+  case PixelIsa::kSsse3:
+    return "ssse3";
+  case PixelIsa::kAvx2:
+    return "avx2";
+  case PixelIsa::kNeon:
+    return "neon";
+  }
+  return "unknown";
+}
+
+// run fn kRepeatCount times, return GB/s of bytes read and written
+template <typename Fn> auto measure(size_t bytes, Fn &&fn) -> double {
+  fn();
+  auto start = ::std::chrono::steady_clock::now();
+  for (int i = 0; i < kRepeatCount; ++i) {
+    fn();
+  }
+  ::std::chrono::duration<double> elapsed =
+      ::std::chrono::steady_clock::now() - start;
+  return static_cast<double>(bytes) * kRepeatCount / elapsed.count() / 1e9;
+}
+
+// largest absolute difference, 0 means bit exact
+template <typename T>
+auto compare(::std::vector<T> const &lhs, ::std::vector<T> const &rhs)
+    -> double {
+  double diff{0.};
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    diff = ::std::max(diff, ::std::abs(static_cast<double>(lhs[i]) -
+                                       static_cast<double>(rhs[i])));
+  }
+  return diff;
+}
+
+struct Inputs {
+  ::std::vector<unsigned char> rgb, rgba;
+  ::std::vector<float> linear;
+};
+
+auto make_inputs() -> Inputs {
+  ::std::mt19937 engine{42};
+  ::std::uniform_int_distribution<int> byte{0, 255};
+  // a little out of range and NaN to check the clamping
+  ::std::uniform_real_distribution<float> real{-.05f, 1.05f};
+  Inputs inputs{::std::vector<unsigned char>(kTexelCount * 3),
+                ::std::vector<unsigned char>(kTexelCount * 4),
+                ::std::vector<float>(kTexelCount * 4)};
+  for (auto &value : inputs.rgb) {
+    value = static_cast<unsigned char>(byte(engine));
+  }
+  for (auto &value : inputs.rgba) {
+    value = static_cast<unsigned char>(byte(engine));
+  }
+  for (auto &value : inputs.linear) {
+    value = real(engine);
+  }
+  inputs.linear[5] = ::std::numeric_limits<float>::quiet_NaN();
+  return inputs;
+}
+
+struct Outputs {
+  ::std::vector<unsigned char> rgba, bgra, premultiplied;
+  ::std::vector<float> linear;
+  ::std::vector<unsigned char> srgb;
+};
+
+auto run(PixelKernels const &kernels, Inputs const &inputs, Outputs &outputs)
+    -> ::std::array<double, 5> {
+  size_t rgba_bytes = kTexelCount * 4;
+  size_t float_bytes = kTexelCount * 4 * sizeof(float);
+  return {
+      measure(kTexelCount * 3 + rgba_bytes,
+              [&] {
+                kernels.rgb_to_rgba(inputs.rgb.data(), outputs.rgba.data(),
+                                    kTexelCount);
+              }),
+      measure(rgba_bytes * 2,
+              [&] {
+                kernels.rgba_to_bgra(inputs.rgba.data(), outputs.bgra.data(),
+                                     kTexelCount);
+              }),
+      measure(rgba_bytes * 2,
+              [&] {
+                kernels.premultiply_alpha(inputs.rgba.data(),
+                                          outputs.premultiplied.data(),
+                                          kTexelCount);
+              }),
+      measure(rgba_bytes + float_bytes,
+              [&] {
+                kernels.srgb_to_linear(inputs.rgba.data(),
+                                       outputs.linear.data(), kTexelCount);
+              }),
+      measure(float_bytes + rgba_bytes,
+              [&] {
+                kernels.linear_to_srgb(inputs.linear.data(),
+                                       outputs.srgb.data(), kTexelCount);
+              }),
+  };
+}
+
+auto make_outputs() -> Outputs {
+  return {::std::vector<unsigned char>(kTexelCount * 4),
+          ::std::vector<unsigned char>(kTexelCount * 4),
+          ::std::vector<unsigned char>(kTexelCount * 4),
+          ::std::vector<float>(kTexelCount * 4),
+          ::std::vector<unsigned char>(kTexelCount * 4)};
+}
+
+// a wide random forest, every node updated, then one in a hundred moved. The
+// SIMD and parallel results must match plain glm matrix products.
+auto bench_transforms() -> bool {
+  ::std::mt19937 engine{42};
+  ::std::uniform_real_distribution<float> real{-1.f, 1.f};
+  TransformHierarchy transforms;
+  ::std::vector<uint32_t> parents;
+  ::std::vector<::glm::vec3> translations;
+  ::std::vector<::glm::quat> rotations;
+  for (uint32_t i = 0; i < kNodeCount; ++i) {
+    uint32_t parent =
+        i < 64 ? TransformHierarchy::kNoParent : engine() % (i / 4 + 1);
+    uint32_t id = transforms.add(parent);
+    ::glm::vec3 translation{real(engine), real(engine), real(engine)};
+    ::glm::quat rotation = ::glm::normalize(
+        ::glm::quat{real(engine), real(engine), real(engine), real(engine)});
+    transforms.set_translation(id, translation);
+    transforms.set_rotation(id, rotation);
+    parents.push_back(parent);
+    translations.push_back(translation);
+    rotations.push_back(rotation);
+  }
+  transforms.update();
+
+  auto time = [](auto &&fn) {
+    auto start = ::std::chrono::steady_clock::now();
+    for (int i = 0; i < kRepeatCount; ++i) {
+      fn();
+    }
+    ::std::chrono::duration<double, ::std::milli> elapsed =
+        ::std::chrono::steady_clock::now() - start;
+    return elapsed.count() / kRepeatCount;
+  };
+  auto dirty_all = [&transforms] {
+    for (uint32_t id = 0; id < 64; ++id) {
+      transforms.set_scale(id, {1.f, 1.f, 1.f});
+    }
+  };
+  unsigned threads = ::std::max(::std::thread::hardware_concurrency(), 1u);
+  double serial = time([&] {
+    dirty_all();
+    transforms.update();
+  });
+  double parallel = time([&] {
+    dirty_all();
+    transforms.update(threads);
+  });
+  double sparse = time([&] {
+    for (uint32_t id = 0; id < kNodeCount; id += 100) {
+      transforms.set_translation(id, {0.f, 0.f, 0.f});
+    }
+    transforms.update();
+  });
+
+  // parents are added before their children, so id order is enough
+  for (uint32_t id = 0; id < kNodeCount; id += 100) {
+    translations[id] = ::glm::vec3{0.f};
+  }
+  ::std::vector<::glm::mat4> reference(kNodeCount);
+  for (uint32_t id = 0; id < kNodeCount; ++id) {
+    ::glm::mat4 local = ::glm::translate(::glm::mat4{1.f}, translations[id]) *
+                        ::glm::mat4_cast(rotations[id]);
+    reference[id] = parents[id] == TransformHierarchy::kNoParent
+                        ? local
+                        : reference[parents[id]] * local;
+  }
+  // errors grow with depth and distance from the origin
+  auto matches = [&transforms, &reference] {
+    for (uint32_t id = 0; id < kNodeCount; ++id) {
+      ::glm::mat4 world = transforms.get_world(id);
+      for (int c = 0; c < 4; ++c) {
+        for (int r = 0; r < 4; ++r) {
+          float expected = reference[id][c][r];
+          if (::std::abs(world[c][r] - expected) >
+              1e-4f * ::std::max(1.f, ::std::abs(expected))) {
+            return false;
+          }
+        }
+      }
+    }
+    return true;
+  };
+  bool serial_matched = matches();
+  dirty_all();
+  transforms.update(threads);
+  bool parallel_matched = matches();
+
+  ::std::cout << "transforms: " << kNodeCount << " nodes, ms per update"
+              << ::std::endl;
+  ::std::cout << ::std::fixed << ::std::setprecision(3) << "\t"
+              << ::std::left << ::std::setw(20) << "all" << ::std::right
+              << ::std::setw(8) << serial
+              << (serial_matched ? "" : "  MISMATCH") << ::std::endl;
+  ::std::cout << "\t" << ::std::left << ::std::setw(20)
+              << ("all, " + ::std::to_string(threads) + " threads")
+              << ::std::right << ::std::setw(8) << parallel
+              << (parallel_matched ? "" : "  MISMATCH") << ::std::endl;
+  ::std::cout << "\t" << ::std::left << ::std::setw(20) << "1% moved"
+              << ::std::right << ::std::setw(8) << sparse << ::std::endl;
+  return serial_matched && parallel_matched;
+}
+
+// the SIMD results must match a plain loop over the same SoA data
+auto bench_culling() -> bool {
+  ::std::mt19937 engine{42};
+  ::std::uniform_real_distribution<float> position{-100.f, 100.f};
+  ::std::uniform_real_distribution<float> extent{.1f, 4.f};
+  SphereBounds spheres;
+  BoxBounds boxes;
+  for (uint32_t i = 0; i < kVolumeCount; ++i) {
+    ::glm::vec3 center{position(engine), position(engine), position(engine)};
+    ::glm::vec3 half{extent(engine), extent(engine), extent(engine)};
+    spheres.push(::glm::vec4{center, half.x});
+    boxes.push(center - half, center + half);
+  }
+  Frustum frustum = extract_frustum(
+      ::glm::perspective(::glm::radians(60.f), 16.f / 9.f, .1f, 150.f) *
+      ::glm::lookAt(::glm::vec3{0.f, 0.f, 0.f}, ::glm::vec3{1.f, 0.f, 1.f},
+                    ::glm::vec3{0.f, 1.f, 0.f}));
+
+  ::std::vector<uint32_t> reference;
+  for (uint32_t i = 0; i < kVolumeCount; ++i) {
+    bool inside{true};
+    for (auto const &plane : frustum.planes) {
+      float distance = (plane.x * spheres.x[i] + plane.y * spheres.y[i]) +
+                       (plane.z * spheres.z[i] + plane.w);
+      inside = inside && distance >= -spheres.radius[i];
+    }
+    if (inside) {
+      reference.push_back(i);
+    }
+  }
+
+  auto time = [](auto &&fn) {
+    auto start = ::std::chrono::steady_clock::now();
+    for (int i = 0; i < kRepeatCount; ++i) {
+      fn();
+    }
+    ::std::chrono::duration<double, ::std::milli> elapsed =
+        ::std::chrono::steady_clock::now() - start;
+    return elapsed.count() / kRepeatCount;
+  };
+  unsigned threads = ::std::max(::std::thread::hardware_concurrency(), 1u);
+  ::std::vector<uint32_t> visible;
+  ::std::vector<uint32_t> parallel_visible;
+  ::std::vector<uint32_t> box_visible;
+  double serial = time([&] { cull_spheres(frustum, spheres, visible); });
+  double parallel = time(
+      [&] { cull_spheres(frustum, spheres, parallel_visible, threads); });
+  double box = time([&] { cull_boxes(frustum, boxes, box_visible); });
+  bool matched = visible == reference && parallel_visible == reference;
+
+  ::std::cout << "culling: " << kVolumeCount << " volumes, "
+              << reference.size() << " visible spheres, "
+              << box_visible.size() << " visible boxes, ms per pass"
+              << ::std::endl;
+  ::std::cout << ::std::fixed << ::std::setprecision(3) << "\t"
+              << ::std::left << ::std::setw(20) << "spheres" << ::std::right
+              << ::std::setw(8) << serial << (matched ? "" : "  MISMATCH")
+              << ::std::endl;
+  ::std::cout << "\t" << ::std::left << ::std::setw(20)
+              << ("spheres, " + ::std::to_string(threads) + " threads")
+              << ::std::right << ::std::setw(8) << parallel << ::std::endl;
+  ::std::cout << "\t" << ::std::left << ::std::setw(20) << "boxes"
+              << ::std::right << ::std::setw(8) << box << ::std::endl;
+  return matched;
+}
+
+// a grid with three vertices per triangle in random order, the worst input
+auto bench_mesh() -> void {
+  Mesh mesh;
+  ::std::vector<::std::array<MeshVertex, 3>> triangles;
+  auto vertex = [](uint32_t x, uint32_t y) {
+    ::glm::vec2 texcoord{static_cast<float>(x) / kGridSide,
+                         static_cast<float>(y) / kGridSide};
+    return MeshVertex{::glm::vec3{texcoord, 0.f}, ::glm::vec3{0.f, 0.f, 1.f},
+                      texcoord};
+  };
+  for (uint32_t y = 0; y < kGridSide; ++y) {
+    for (uint32_t x = 0; x < kGridSide; ++x) {
+      triangles.push_back(
+          {vertex(x, y), vertex(x + 1, y), vertex(x + 1, y + 1)});
+      triangles.push_back(
+          {vertex(x, y), vertex(x + 1, y + 1), vertex(x, y + 1)});
+    }
+  }
+  ::std::shuffle(triangles.begin(), triangles.end(), ::std::mt19937{42});
+  for (auto const &triangle : triangles) {
+    for (auto const &corner : triangle) {
+      mesh.indices.push_back(static_cast<uint32_t>(mesh.vertices.size()));
+      mesh.vertices.push_back(corner);
+    }
+  }
+
+  size_t vertex_count = mesh.vertices.size();
+  Mesh deduplicated = mesh;
+  deduplicate_vertices(deduplicated);
+  float acmr = get_acmr(deduplicated.indices, deduplicated.vertices.size());
+  auto start = ::std::chrono::steady_clock::now();
+  optimize_mesh(mesh);
+  ::std::chrono::duration<double, ::std::milli> elapsed =
+      ::std::chrono::steady_clock::now() - start;
+
+  char const *bits =
+      get_index_type(mesh) == ::vk::IndexType::eUint16 ? "16" : "32";
+  ::std::cout << "mesh: " << triangles.size() << " triangles, "
+              << vertex_count << " -> " << mesh.vertices.size()
+              << " vertices, " << bits << " bit indices" << ::std::endl;
+  ::std::cout << ::std::fixed << ::std::setprecision(3) << "\t"
+              << ::std::left << ::std::setw(20) << "acmr before"
+              << ::std::right << ::std::setw(8) << acmr << ::std::endl;
+  ::std::cout << "\t" << ::std::left << ::std::setw(20) << "acmr after"
+              << ::std::right << ::std::setw(8)
+              << get_acmr(mesh.indices, mesh.vertices.size()) << ::std::endl;
+  ::std::cout << "\t" << ::std::left << ::std::setw(20) << "optimize ms"
+              << ::std::right << ::std::setw(8) << elapsed.count()
+              << ::std::endl;
+}
+
+// a rippled grid, simplified into levels and cut into meshlets
+auto bench_lods() -> bool {
+  Mesh mesh;
+  for (uint32_t y = 0; y <= kGridSide; ++y) {
+    for (uint32_t x = 0; x <= kGridSide; ++x) {
+      ::glm::vec2 texcoord{static_cast<float>(x) / kGridSide,
+                           static_cast<float>(y) / kGridSide};
+      float height = .05f * ::std::sin(texcoord.x * 12.f) *
+                     ::std::cos(texcoord.y * 9.f);
+      mesh.vertices.push_back(MeshVertex{::glm::vec3{texcoord, height},
+                                         ::glm::vec3{0.f, 0.f, 1.f},
+                                         texcoord});
+    }
+  }
+  for (uint32_t y = 0; y < kGridSide; ++y) {
+    for (uint32_t x = 0; x < kGridSide; ++x) {
+      uint32_t corner = y * (kGridSide + 1) + x;
+      mesh.indices.insert(mesh.indices.end(),
+                          {corner, corner + 1, corner + kGridSide + 2, corner,
+                           corner + kGridSide + 2, corner + kGridSide + 1});
+    }
+  }
+  optimize_vertex_cache(mesh.indices, mesh.vertices.size());
+
+  auto start = ::std::chrono::steady_clock::now();
+  auto lods = build_lods(mesh, 8);
+  ::std::chrono::duration<double, ::std::milli> lod_elapsed =
+      ::std::chrono::steady_clock::now() - start;
+  start = ::std::chrono::steady_clock::now();
+  auto meshlets = build_meshlets(mesh.indices.data(), lods[0].index_count,
+                                 mesh.vertices);
+  ::std::chrono::duration<double, ::std::milli> meshlet_elapsed =
+      ::std::chrono::steady_clock::now() - start;
+
+  // meshlets keep the triangles and their order
+  auto indices = get_meshlet_indices(meshlets);
+  bool matched = ::std::equal(indices.begin(), indices.end(),
+                              mesh.indices.begin(),
+                              mesh.indices.begin() + lods[0].index_count);
+  size_t backfacing = ::std::count_if(
+      meshlets.bounds.begin(), meshlets.bounds.end(),
+      [](MeshletBounds const &bounds) {
+        return is_meshlet_backfacing(bounds, ::glm::vec3{.5f, .5f, -2.f});
+      });
+
+  ::std::cout << "lods: " << lods.size() << " levels, triangles and error"
+              << ::std::endl;
+  for (auto const &lod : lods) {
+    ::std::cout << ::std::fixed << ::std::setprecision(5) << "\t"
+                << ::std::left << ::std::setw(20) << lod.index_count / 3
+                << ::std::right << ::std::setw(8) << lod.error << ::std::endl;
+  }
+  ::std::cout << ::std::setprecision(3) << "\t" << ::std::left
+              << ::std::setw(20) << "simplify ms" << ::std::right
+              << ::std::setw(8) << lod_elapsed.count() << ::std::endl;
+  ::std::cout << "meshlets: " << meshlets.meshlets.size() << ", "
+              << backfacing << " backfacing from below" << ::std::endl;
+  ::std::cout << "\t" << ::std::left << ::std::setw(20) << "build ms"
+              << ::std::right << ::std::setw(8) << meshlet_elapsed.count()
+              << (matched ? "" : "  MISMATCH") << ::std::endl;
+  return matched;
+}
+
+} // namespace
+
+int main() {
+  ::std::array<char const *, 5> const names{
+      "rgb_to_rgba", "rgba_to_bgra", "premultiply_alpha", "srgb_to_linear",
+      "linear_to_srgb"};
+  Inputs inputs = make_inputs();
+  Outputs reference = make_outputs();
+  run(*get_pixel_kernels(PixelIsa::kScalar), inputs, reference);
+
+  ::std::cout << "dispatch: " << get_isa_name(get_pixel_kernels().isa)
+              << ", " << kTexelCount << " texels, GB/s" << ::std::endl;
+  bool passed{true};
+  for (auto isa : {PixelIsa::kScalar, PixelIsa::kSsse3, PixelIsa::kAvx2,
+                   PixelIsa::kNeon}) {
+    auto const *kernels = get_pixel_kernels(isa);
+    if (kernels == nullptr) {
+      continue;
+    }
+    Outputs outputs = make_outputs();
+    auto speeds = run(*kernels, inputs, outputs);
+    // the sRGB encode tables allow one step of difference, all else is exact
+    ::std::array<double, 5> const diffs{
+        compare(outputs.rgba, reference.rgba),
+        compare(outputs.bgra, reference.bgra),
+        compare(outputs.premultiplied, reference.premultiplied),
+        compare(outputs.linear, reference.linear),
+        compare(outputs.srgb, reference.srgb)};
+    ::std::array<double, 5> const tolerances{0., 0., 0., 0., 1.};
+    ::std::cout << get_isa_name(isa) << ::std::endl;
+    for (size_t i = 0; i < names.size(); ++i) {
+      bool matched = diffs[i] <= tolerances[i];
+      passed = passed && matched;
+      ::std::cout << "\t" << ::std::left << ::std::setw(20) << names[i]
+                  << ::std::right << ::std::fixed << ::std::setprecision(2)
+                  << ::std::setw(8) << speeds[i]
+                  << (matched ? "" : "  MISMATCH") << ::std::endl;
+    }
+  }
+  passed = bench_transforms() && passed;
+  passed = bench_culling() && passed;
+  bench_mesh();
+  passed = bench_lods() && passed;
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,9 @@
+target("VulkanBench")
+    set_kind("binary")
+    add_deps("VulkanBase")
+    add_files("main.cpp")
+    add_includedirs(path.join("$(projectdir)", "include"))
+    before_build_file(enable_clang_tidy)
+    on_load(function (target)
+            target:add(find_packages("vulkan", "sdl2"))
+    end)
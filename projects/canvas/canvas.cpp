@@ -18,6 +18,10 @@
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.hpp>
 
+#ifdef DEBUG
+#include <iostream>
+#endif
+
 extern ::std::filesystem::path shader_path;
 extern ::std::string shader_name;
 
@@ -128,29 +132,92 @@ auto CanvasApplication::app_init(QueueFamilyIndices &queue_indices) -> void {
                                     ::vk::MemoryPropertyFlagBits::eDeviceLocal);
 
   this->layout_ = create_pipeline_layout(this->device_);
-  auto entries = get_special_map_entries();
-  ::vk::SpecializationInfo special_info;
-  special_info.setMapEntries(entries)
-      .setDataSize(sizeof(SpecializationConstantData))
-      .setPData(&scd);
   this->shader_modules_ = {
       create_shader_module(this->device_, shader_path / "main.vert.spv"),
       create_shader_module(this->device_,
                            shader_path / (shader_name + ".frag.spv")),
   };
+  this->pipeline_ = this->build_pipeline(this->shader_modules_[1]);
+
+#if defined(GLSL_COMPILER) && defined(SHADER_SOURCE_DIR)
+  // Saving the shader's source swaps in a new pipeline within a few frames,
+  // neither the device nor the frames in flight are disturbed. The device
+  // is thread safe for module and pipeline creation, everything else
+  // create_pipeline reads stays as app_init left it.
+  this->watcher_.emplace(
+      SHADER_SOURCE_DIR, shader_path, GLSL_COMPILER,
+      [this](::std::filesystem::path const &source,
+             ::std::filesystem::path const &binary) {
+        if (source.filename() != shader_name + ".frag") {
+          return;
+        }
+        auto fragment = create_shader_module(this->device_, binary);
+        auto pipeline = this->build_pipeline(fragment);
+        this->device_.destroyShaderModule(fragment);
+        ::std::lock_guard lock{this->reload_mutex_};
+        // saved again before the last one was swapped in, it never drew
+        if (this->reloaded_) {
+          this->device_.destroyPipeline(this->reloaded_);
+        }
+        this->reloaded_ = pipeline;
+      });
+#endif
+}
+
+auto CanvasApplication::build_pipeline(::vk::ShaderModule fragment)
+    -> ::vk::Pipeline {
+  auto entries = get_special_map_entries();
+  ::vk::SpecializationInfo special_info;
+  special_info.setMapEntries(entries)
+      .setDataSize(sizeof(SpecializationConstantData))
+      .setPData(&scd);
   ::vk::PipelineShaderStageCreateInfo vert_stage;
   vert_stage.setStage(::vk::ShaderStageFlagBits::eVertex)
       .setModule(this->shader_modules_[0])
       .setPName("main");
   ::vk::PipelineShaderStageCreateInfo frag_stage;
   frag_stage.setStage(::vk::ShaderStageFlagBits::eFragment)
-      .setModule(this->shader_modules_[1])
+      .setModule(fragment)
       .setPName("main")
       .setPSpecializationInfo(&special_info);
-  this->pipeline_ = this->create_pipeline({vert_stage, frag_stage});
+  return this->create_pipeline({vert_stage, frag_stage});
+}
+
+auto CanvasApplication::swap_pipeline() -> void {
+  ++this->frame_count_;
+  // a frame recorded image_count frames after the swap has waited for every
+  // frame that could still draw with the old pipeline
+  auto in_flight = this->required_info_.image_count;
+  auto kept = this->retired_.begin();
+  for (auto &entry : this->retired_) {
+    if (entry.second + in_flight > this->frame_count_) {
+      *kept++ = entry;
+    } else {
+      this->device_.destroyPipeline(entry.first);
+    }
+  }
+  this->retired_.erase(kept, this->retired_.end());
+
+  ::std::lock_guard lock{this->reload_mutex_};
+  if (this->reloaded_) {
+    this->retired_.emplace_back(this->pipeline_, this->frame_count_);
+    this->pipeline_ = this->reloaded_;
+    this->reloaded_ = nullptr;
+#ifdef DEBUG
+    ::std::clog << shader_name << ": pipeline reloaded" << ::std::endl;
+#endif
+  }
 }
 
 auto CanvasApplication::app_destroy() -> void {
+  // joins the watcher thread, nothing builds pipelines past this point
+  this->watcher_.reset();
+  if (this->reloaded_) {
+    this->device_.destroyPipeline(this->reloaded_);
+  }
+  for (auto &entry : this->retired_) {
+    this->device_.destroyPipeline(entry.first);
+  }
   this->device_.destroyPipeline(this->pipeline_);
   this->device_.destroyPipelineLayout(this->layout_);
   for (auto &shader : this->shader_modules_) {
@@ -185,6 +252,7 @@ auto CanvasApplication::record_command(::vk::CommandBuffer &cbuf,
   begin_info.setFlags(::vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
   [[maybe_unused]] auto result = cbuf.begin(&begin_info);
   assert(result == ::vk::Result::eSuccess && "command buffer record failed!");
+  this->swap_pipeline();
 
   ::vk::ClearValue value{::std::array<float, 4>{1.f, 1.f, 1.f, 1.f}};
   ::vk::RenderPassBeginInfo render_pass_begin;
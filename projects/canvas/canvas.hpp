@@ -2,8 +2,15 @@
 #define CANVAS_HPP_
 
 #include "renderer.hpp"
+#include "shader_watcher.hpp"
+
+#include <stdint.h>
 
 #include <chrono>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
 
 class CanvasApplication : public Renderer<CanvasApplication> {
   using this_class = CanvasApplication;
@@ -24,11 +31,26 @@ private:
   auto record_command(::vk::CommandBuffer &cbuf, ::vk::Framebuffer &fbuf)
       -> void;
 
+  // main.vert and the given fragment stage
+  auto build_pipeline(::vk::ShaderModule fragment) -> ::vk::Pipeline;
+  // at the frame boundary, put a reloaded pipeline in place and destroy the
+  // ones no frame in flight draws with
+  auto swap_pipeline() -> void;
+
   ::std::chrono::time_point<::std::chrono::system_clock> start_time_;
 
   ::vk::DeviceMemory device_memory_{nullptr};
   ::std::vector<::vk::Buffer> device_buffers_;
   ::std::vector<::vk::ShaderModule> shader_modules_;
+
+  // rebuilds the pipeline when the fragment shader source is saved
+  ::std::optional<ShaderWatcher> watcher_;
+  ::std::mutex reload_mutex_;
+  // built on the watcher thread, waiting for swap_pipeline
+  ::vk::Pipeline reloaded_{nullptr};
+  // replaced pipelines, with the frame that replaced them
+  ::std::vector<::std::pair<::vk::Pipeline, uint64_t>> retired_;
+  uint64_t frame_count_{0};
 };
 
 #endif // CANVAS_HPP_
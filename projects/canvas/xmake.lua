@@ -15,4 +15,12 @@ target("VulkanCanvas")
     before_build_file(enable_clang_tidy)
     on_load(function (target)
             target:add(find_packages("vulkan", "sdl2"))
+            -- saved fragment shaders are recompiled and swapped in while
+            -- running
+            import("lib.detect.find_tool")
+            local compiler = find_tool("glslangValidator") or find_tool("glslc")
+            if compiler then
+                target:add("defines", "GLSL_COMPILER=\"" .. compiler.program .. "\"")
+                target:add("defines", "SHADER_SOURCE_DIR=\"" .. path.join(target:scriptdir(), "shader") .. "\"")
+            end
     end)
@@ -0,0 +1,33 @@
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#include "mesh_app.hpp"
+#include "renderer.hpp"
+
+namespace fs = ::std::filesystem;
+
+::fs::path shader_path;
+::fs::path model_path;
+
+auto main(int argc, char const *const argv[]) -> int {
+  if (argc < 3) {
+    ::std::cerr << "usage: " << argv[0] << " "
+                << "shader_path model.obj" << ::std::endl;
+    return EXIT_FAILURE;
+  }
+  shader_path = ::fs::path{argv[1]};
+  model_path = ::fs::path{argv[2]};
+
+  try {
+    MeshApplication app;
+    app.init();
+    app.run();
+    app.destroy();
+  } catch (::std::exception const &e) {
+    ::std::cerr << e.what() << ::std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
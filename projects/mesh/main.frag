@@ -0,0 +1,12 @@
+#version 450 core
+
+layout(location = 0) in vec3 in_normal;
+
+layout(location = 0) out vec4 out_color;
+
+const vec3 light = normalize(vec3(0.4, -0.8, 0.6));
+
+void main() {
+    float diffuse = max(dot(normalize(in_normal), -light), 0.0);
+    out_color = vec4(vec3(0.15 + 0.85 * diffuse), 1.0);
+}
@@ -0,0 +1,23 @@
+#version 450 core
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec4 in_normal; // remapped to [0, 1]
+layout(location = 2) in vec2 in_texcoord;
+// xyz places the copy, w scales it
+layout(location = 3) in vec4 in_placement;
+
+layout(location = 0) out vec3 out_normal;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 project;
+};
+
+void main() {
+    vec3 world = in_placement.xyz +
+                 in_placement.w * (model * vec4(in_pos, 1.0)).xyz;
+    gl_Position = project * view * vec4(world, 1.0);
+    // models are only rotated and uniformly scaled
+    out_normal = mat3(model) * (in_normal.xyz * 2.0 - 1.0);
+}
@@ -0,0 +1,410 @@
+#include "mesh_app.hpp"
+
+#include "base_type.hpp"
+#include "create.hpp"
+#include "depth_pyramid.hpp"
+#include "draw_order.hpp"
+#include "gpu_culling.hpp"
+#include "mesh.hpp"
+#include "mesh_lod.hpp"
+#include "occlusion_culling.hpp"
+#include "radix_sort.hpp"
+#include "vertex_layout.hpp"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <tuple>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <vulkan/vulkan.hpp>
+
+extern ::std::filesystem::path shader_path;
+extern ::std::filesystem::path model_path;
+
+namespace {
+
+// rows of copies receding from the camera, so that every level shows
+uint32_t const kInstanceRows{16};
+uint32_t const kInstanceColumns{5};
+float const kInstanceSpacing{3.f};
+float const kFovy{::glm::radians(45.f)};
+float const kZNear{.1f};
+::glm::vec3 const kEye{0.f, 2.f, 3.f};
+
+// how a render pass takes part in a frame, the occlusion culled path splits
+// the frame into two passes around the depth pyramid
+enum class PassRole {
+  eOnly,
+  // stores colour and depth for the late pass and the pyramid
+  eEarly,
+  // draws on top of the early pass
+  eLate,
+};
+
+auto create_render_pass(::vk::Device &device,
+                        SwapchainRequiredInfo &required_info,
+                        ::vk::Format depth_format, PassRole role)
+    -> ::vk::RenderPass {
+  ::vk::AttachmentDescription att_desc;
+  att_desc.setSamples(::vk::SampleCountFlagBits::e1)
+      .setLoadOp(::vk::AttachmentLoadOp::eClear)
+      .setStoreOp(::vk::AttachmentStoreOp::eStore)
+      .setStencilLoadOp(::vk::AttachmentLoadOp::eDontCare)
+      .setStencilStoreOp(::vk::AttachmentStoreOp::eDontCare)
+      .setFormat(required_info.format.format)
+      .setInitialLayout(::vk::ImageLayout::eUndefined)
+      .setFinalLayout(::vk::ImageLayout::ePresentSrcKHR);
+  auto depth_desc = get_depth_attachment(depth_format);
+  if (role == PassRole::eEarly) {
+    att_desc.setFinalLayout(::vk::ImageLayout::eColorAttachmentOptimal);
+    depth_desc.setStoreOp(::vk::AttachmentStoreOp::eStore)
+        .setFinalLayout(::vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+  } else if (role == PassRole::eLate) {
+    att_desc.setLoadOp(::vk::AttachmentLoadOp::eLoad)
+        .setInitialLayout(::vk::ImageLayout::eColorAttachmentOptimal);
+    depth_desc.setLoadOp(::vk::AttachmentLoadOp::eLoad)
+        .setInitialLayout(::vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+  }
+
+  ::vk::AttachmentReference att_ref;
+  att_ref.setLayout(::vk::ImageLayout::eColorAttachmentOptimal)
+      .setAttachment(0);
+  ::vk::AttachmentReference depth_ref;
+  depth_ref.setLayout(::vk::ImageLayout::eDepthStencilAttachmentOptimal)
+      .setAttachment(1);
+  ::vk::SubpassDescription sub_desc;
+  sub_desc.setPipelineBindPoint(::vk::PipelineBindPoint::eGraphics)
+      .setColorAttachments(att_ref)
+      .setPDepthStencilAttachment(&depth_ref);
+
+  // the depth clear waits for the previous frame's depth tests, the late
+  // pass for the early one and for the pyramid reading its depth
+  ::vk::PipelineStageFlags src_stages{
+      ::vk::PipelineStageFlagBits::eColorAttachmentOutput |
+      ::vk::PipelineStageFlagBits::eLateFragmentTests};
+  if (role == PassRole::eLate) {
+    src_stages |= ::vk::PipelineStageFlagBits::eComputeShader;
+  }
+  ::vk::SubpassDependency dependency;
+  dependency.setSrcSubpass(VK_SUBPASS_EXTERNAL)
+      .setDstSubpass(0)
+      .setSrcStageMask(src_stages)
+      .setDstStageMask(::vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                       ::vk::PipelineStageFlagBits::eEarlyFragmentTests)
+      .setSrcAccessMask(::vk::AccessFlagBits::eColorAttachmentWrite |
+                        ::vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+      .setDstAccessMask(::vk::AccessFlagBits::eColorAttachmentRead |
+                        ::vk::AccessFlagBits::eColorAttachmentWrite |
+                        ::vk::AccessFlagBits::eDepthStencilAttachmentRead |
+                        ::vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+  ::std::vector dependencies{dependency};
+  if (role == PassRole::eEarly) {
+    // the pyramid reduces the stored depth
+    ::vk::SubpassDependency reduce;
+    reduce.setSrcSubpass(0)
+        .setDstSubpass(VK_SUBPASS_EXTERNAL)
+        .setSrcStageMask(::vk::PipelineStageFlagBits::eLateFragmentTests)
+        .setDstStageMask(::vk::PipelineStageFlagBits::eComputeShader)
+        .setSrcAccessMask(::vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+        .setDstAccessMask(::vk::AccessFlagBits::eShaderRead);
+    dependencies.push_back(reduce);
+  }
+
+  ::std::array att_descs{att_desc, depth_desc};
+  ::vk::RenderPassCreateInfo info;
+  info.setAttachments(att_descs)
+      .setSubpasses(sub_desc)
+      .setDependencies(dependencies);
+  ::vk::RenderPass render_pass = device.createRenderPass(info);
+  assert(render_pass && "render pass create failed!");
+  return render_pass;
+}
+
+auto fit_unit_sphere(Mesh const &mesh) -> ::glm::mat4 {
+  ::glm::vec3 min{::std::numeric_limits<float>::max()};
+  ::glm::vec3 max{::std::numeric_limits<float>::lowest()};
+  for (auto const &vertex : mesh.vertices) {
+    min = ::glm::min(min, vertex.position);
+    max = ::glm::max(max, vertex.position);
+  }
+  float radius = ::glm::length(max - min) / 2.f;
+  float scale = radius > 0.f ? 1.f / radius : 1.f;
+  return ::glm::translate(::glm::scale(::glm::mat4(1.f), ::glm::vec3(scale)),
+                          -(min + max) / 2.f);
+}
+
+// Every copy draws the coarsest level that stays within a pixel of the full
+// mesh, seen from the surface of its unit bounding sphere. lod_scale comes
+// from get_lod_scale.
+auto select_instance_lod(::std::vector<MeshLod> const &lods,
+                         MeshInstance const &instance, float lod_scale)
+    -> MeshLod const & {
+  auto const &placement = instance.placement;
+  float distance = ::std::max(
+      ::glm::length(::glm::vec3(placement) - kEye) - placement.w, .1f);
+  return lods[select_lod(lods, lod_scale * placement.w / distance)];
+}
+
+} // namespace
+
+auto MeshApplication::app_init(QueueFamilyIndices &queue_indices) -> void {
+  // the occlusion culled path reduces the depth buffer into a pyramid
+  bool occlusion = this->features_.multi_draw_indirect;
+  this->create_depth_buffers(occlusion ? ::vk::ImageUsageFlagBits::eSampled
+                                       : ::vk::ImageUsageFlags{});
+  this->render_pass_ =
+      create_render_pass(this->device_, this->required_info_,
+                         this->depth_format_,
+                         occlusion ? PassRole::eEarly : PassRole::eOnly);
+  if (occlusion) {
+    this->late_pass_ =
+        create_render_pass(this->device_, this->required_info_,
+                           this->depth_format_, PassRole::eLate);
+  }
+  this->framebuffers_ = create_frame_buffers(
+      this->device_, this->swapchain_imageviews_, this->render_pass_,
+      this->required_info_, this->depth_imageviews_);
+
+  auto acmr_of = [](Mesh const &mesh) {
+    return get_acmr(mesh.indices, mesh.vertices.size());
+  };
+  Mesh mesh = load_obj(model_path);
+  float raw_acmr = acmr_of(mesh);
+  optimize_mesh(mesh);
+  ::std::clog << model_path.string() << ": " << mesh.vertices.size()
+              << " vertices, " << mesh.indices.size() / 3
+              << " triangles, acmr " << raw_acmr << " -> " << acmr_of(mesh)
+              << ::std::endl;
+  this->fit_ = fit_unit_sphere(mesh);
+  this->lods_ = build_lods(mesh);
+  for (auto &lod : this->lods_) {
+    // fit_ scales uniformly, its first column holds the factor
+    lod.error *= this->fit_[0][0];
+    ::std::clog << "lod " << &lod - this->lods_.data() << ": "
+                << lod.index_count / 3 << " triangles, error " << lod.error
+                << ::std::endl;
+  }
+  this->index_type_ = get_index_type(mesh);
+
+  for (uint32_t row = 0; row < kInstanceRows; ++row) {
+    for (uint32_t column = 0; column < kInstanceColumns; ++column) {
+      ::glm::vec3 position{
+          (static_cast<float>(column) -
+           static_cast<float>(kInstanceColumns - 1) / 2.f) *
+              kInstanceSpacing,
+          0.f, -static_cast<float>(row) * kInstanceSpacing};
+      this->instances_.push_back(MeshInstance{::glm::vec4{position, 1.f}});
+    }
+  }
+  auto buffers = wrap_mesh(this->physical_, this->device_, queue_indices, mesh);
+  buffers.push_back(wrap_buffer(this->physical_, this->device_, queue_indices,
+                                this->instances_.data(),
+                                this->instances_.size(),
+                                ::vk::BufferUsageFlagBits::eVertexBuffer));
+  ::std::tie(this->device_buffers_, this->device_memory_) =
+      allocate_memory<::vk::Buffer>(this->physical_, this->device_,
+                                    this->cmdpool_, this->graphics_, buffers,
+                                    ::vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+  if (occlusion) {
+    // the camera stays put, so does every copy's level. Front to back
+    // objects keep the draws of a phase roughly in that order.
+    auto extent = this->required_info_.extent;
+    float lod_scale = get_lod_scale(kFovy, static_cast<float>(extent.height));
+    ::std::vector<DrawObject> objects;
+    ::std::vector<uint64_t> keys;
+    for (uint32_t i = 0; i < this->instances_.size(); ++i) {
+      auto const &placement = this->instances_[i].placement;
+      auto const &lod =
+          select_instance_lod(this->lods_, this->instances_[i], lod_scale);
+      objects.push_back(DrawObject{
+          ::glm::scale(::glm::translate(::glm::mat4(1.f),
+                                        ::glm::vec3(placement)),
+                       ::glm::vec3(placement.w)),
+          ::glm::vec4{0.f, 0.f, 0.f, 1.f}, lod.first_index, lod.index_count,
+          0, i});
+      keys.push_back(get_opaque_sort_key(
+          0, ::glm::length(::glm::vec3(placement) - kEye) - placement.w));
+    }
+    radix_sort(keys.data(), keys.size(), this->order_, this->scratch_);
+    ::std::vector<DrawObject> sorted;
+    for (auto i : this->order_) {
+      sorted.push_back(objects[i]);
+    }
+    this->pyramid_.emplace(this->physical_, this->device_, this->layouts_,
+                           this->descriptors_,
+                           shader_path / "depth_reduce.comp.spv",
+                           this->depth_imageviews_, extent);
+    this->culler_.emplace(this->physical_, this->device_, queue_indices,
+                          this->cmdpool_, this->graphics_, this->layouts_,
+                          this->descriptors_, shader_path / "cull.comp.spv",
+                          sorted, *this->pyramid_, extent,
+                          this->required_info_.image_count, this->features_);
+  }
+
+  ::std::vector uniforms{this->uniforms_.get_buffer()};
+  auto [set_layout, sets] = allocate_descriptor_set<::vk::Buffer>(
+      this->device_, this->layouts_, this->descriptors_, uniforms.begin(),
+      uniforms.end(), ::vk::DescriptorType::eUniformBufferDynamic,
+      ::vk::ShaderStageFlagBits::eVertex, sizeof(MVP));
+  this->desc_sets_ = sets;
+  this->layout_ = this->layouts_.get_pipeline_layout({set_layout}, {});
+
+  this->shader_modules_ = {
+      create_shader_module(this->device_, shader_path / "main.vert.spv"),
+      create_shader_module(this->device_, shader_path / "main.frag.spv"),
+  };
+  ::vk::PipelineShaderStageCreateInfo vert_stage;
+  vert_stage.setStage(::vk::ShaderStageFlagBits::eVertex)
+      .setModule(this->shader_modules_[0])
+      .setPName("main");
+  ::vk::PipelineShaderStageCreateInfo frag_stage;
+  frag_stage.setStage(::vk::ShaderStageFlagBits::eFragment)
+      .setModule(this->shader_modules_[1])
+      .setPName("main");
+  this->pipeline_ = this->create_pipeline({vert_stage, frag_stage});
+}
+
+auto MeshApplication::app_destroy() -> void {
+  if (this->culler_) {
+    this->culler_->destroy();
+    this->culler_.reset();
+  }
+  if (this->pyramid_) {
+    this->pyramid_->destroy();
+    this->pyramid_.reset();
+  }
+  this->device_.destroyPipeline(this->pipeline_);
+  for (auto &shader : this->shader_modules_) {
+    this->device_.destroyShaderModule(shader);
+  }
+  this->device_.freeMemory(this->device_memory_);
+  for (auto &buffer : this->device_buffers_) {
+    this->device_.destroyBuffer(buffer);
+  }
+  for (auto &buffer : this->framebuffers_) {
+    this->device_.destroyFramebuffer(buffer);
+  }
+  this->device_.destroyRenderPass(this->render_pass_);
+  if (this->late_pass_) {
+    this->device_.destroyRenderPass(this->late_pass_);
+  }
+}
+
+auto MeshApplication::get_vertex_input_description() -> decltype(auto) {
+  auto [vertex_attrs, vertex_desc] = get_mesh_input_description();
+  auto [instance_attrs, instance_desc] =
+      get_vertex_layout<&MeshInstance::placement>(
+          1, static_cast<uint32_t>(vertex_attrs.size()),
+          ::vk::VertexInputRate::eInstance);
+  ::std::array<::vk::VertexInputAttributeDescription,
+               ::std::tuple_size_v<decltype(vertex_attrs)> +
+                   ::std::tuple_size_v<decltype(instance_attrs)>>
+      attr_descs;
+  ::std::copy(vertex_attrs.begin(), vertex_attrs.end(), attr_descs.begin());
+  ::std::copy(instance_attrs.begin(), instance_attrs.end(),
+              attr_descs.begin() + vertex_attrs.size());
+  ::std::array bind_descs{vertex_desc, instance_desc};
+
+  return ::std::make_pair(attr_descs, bind_descs);
+}
+
+auto MeshApplication::record_command(::vk::CommandBuffer &cbuf,
+                                     ::vk::Framebuffer &fbuf) -> void {
+  ::vk::CommandBufferBeginInfo begin_info;
+  begin_info.setFlags(::vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+  [[maybe_unused]] auto result = cbuf.begin(&begin_info);
+  assert(result == ::vk::Result::eSuccess && "command buffer record failed!");
+
+  // the meshes turn around the vertical axis
+  ::std::chrono::duration<float> time =
+      ::std::chrono::system_clock::now() - this->start_time_;
+  auto extent = this->required_info_.extent;
+  float z_far = static_cast<float>(kInstanceRows) * kInstanceSpacing + 10.f;
+  MVP mvp{
+      ::glm::rotate(::glm::mat4(1.f), time.count() * .5f,
+                    ::glm::vec3(0.f, 1.f, 0.f)) *
+          this->fit_,
+      ::glm::lookAt(kEye, ::glm::vec3(0.f, 0.f, -z_far / 2.f),
+                    ::glm::vec3(0.f, 1.f, 0.f)),
+      ::glm::perspective(kFovy,
+                         static_cast<float>(extent.width) /
+                             static_cast<float>(extent.height),
+                         kZNear, z_far),
+  };
+
+  ::std::array<::vk::ClearValue, 2> values{
+      ::vk::ClearValue{::std::array<float, 4>{1.f, 1.f, 1.f, 1.f}},
+      ::vk::ClearValue{::vk::ClearDepthStencilValue{1.f, 0}},
+  };
+  ::vk::RenderPassBeginInfo render_pass_begin;
+  render_pass_begin.setRenderPass(this->render_pass_)
+      .setRenderArea(::vk::Rect2D{::vk::Offset2D{0, 0}, extent})
+      .setClearValues(values)
+      .setFramebuffer(fbuf);
+  uint32_t offset = this->uniforms_.push(mvp);
+  auto bind = [&]() {
+    cbuf.bindPipeline(::vk::PipelineBindPoint::eGraphics, this->pipeline_);
+    cbuf.bindVertexBuffers(
+        0, {this->device_buffers_[0], this->device_buffers_[2]}, {0, 0});
+    cbuf.bindIndexBuffer(this->device_buffers_[1], 0, this->index_type_);
+    cbuf.bindDescriptorSets(::vk::PipelineBindPoint::eGraphics, this->layout_,
+                            0, this->desc_sets_, offset);
+  };
+
+  if (this->culler_) {
+    auto frame = this->current_frame_;
+    this->culler_->cull(cbuf, frame, CullPhase::eEarly, mvp.view, mvp.project,
+                        kZNear);
+    cbuf.beginRenderPass(render_pass_begin, ::vk::SubpassContents::eInline);
+    bind();
+    this->culler_->draw(cbuf, frame, CullPhase::eEarly);
+    cbuf.endRenderPass();
+
+    // the frame buffer tells which swapchain image, and so which depth
+    // image, this frame renders to
+    auto image = static_cast<size_t>(
+        ::std::find(this->framebuffers_.begin(), this->framebuffers_.end(),
+                    fbuf) -
+        this->framebuffers_.begin());
+    this->pyramid_->build(cbuf, image);
+    this->culler_->cull(cbuf, frame, CullPhase::eLate, mvp.view, mvp.project,
+                        kZNear);
+    render_pass_begin.setRenderPass(this->late_pass_);
+    cbuf.beginRenderPass(render_pass_begin, ::vk::SubpassContents::eInline);
+    bind();
+    this->culler_->draw(cbuf, frame, CullPhase::eLate);
+    cbuf.endRenderPass();
+    cbuf.end();
+    return;
+  }
+
+  cbuf.beginRenderPass(render_pass_begin, ::vk::SubpassContents::eInline);
+  bind();
+  // nearest copies first, so that early depth testing rejects the hidden
+  // parts of the ones behind
+  this->keys_.resize(this->instances_.size());
+  for (size_t i = 0; i < this->instances_.size(); ++i) {
+    auto const &placement = this->instances_[i].placement;
+    this->keys_[i] = get_opaque_sort_key(
+        0, ::glm::length(::glm::vec3(placement) - kEye) - placement.w);
+  }
+  radix_sort(this->keys_.data(), this->keys_.size(), this->order_,
+             this->scratch_);
+
+  float lod_scale = get_lod_scale(kFovy, static_cast<float>(extent.height));
+  for (auto i : this->order_) {
+    auto const &lod =
+        select_instance_lod(this->lods_, this->instances_[i], lod_scale);
+    cbuf.drawIndexed(lod.index_count, 1, lod.first_index, 0, i);
+  }
+
+  cbuf.endRenderPass();
+  cbuf.end();
+}
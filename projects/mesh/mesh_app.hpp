@@ -0,0 +1,62 @@
+#ifndef MESH_APP_HPP_
+#define MESH_APP_HPP_
+
+#include "depth_pyramid.hpp"
+#include "mesh_lod.hpp"
+#include "occlusion_culling.hpp"
+#include "renderer.hpp"
+
+#include <stdint.h>
+
+#include <chrono>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// one copy of the mesh, xyz places it and w scales it
+struct MeshInstance {
+  ::glm::vec4 placement;
+};
+
+class MeshApplication : public Renderer<MeshApplication> {
+  using this_class = MeshApplication;
+  using base_class = Renderer<this_class>;
+
+  friend base_class;
+
+private:
+  auto app_init(QueueFamilyIndices &queue_indices) -> void;
+
+  auto app_destroy() -> void;
+
+  auto get_vertex_input_description() -> decltype(auto);
+
+  auto record_command(::vk::CommandBuffer &cbuf, ::vk::Framebuffer &fbuf)
+      -> void;
+
+  ::std::chrono::time_point<::std::chrono::system_clock> start_time_{
+      ::std::chrono::system_clock::now()};
+  // centers the mesh and scales it into the unit sphere
+  ::glm::mat4 fit_{1.f};
+  // errors scaled to the unit sphere
+  ::std::vector<MeshLod> lods_;
+  ::std::vector<MeshInstance> instances_;
+  // front to back order of the instances, rebuilt every frame
+  ::std::vector<uint64_t> keys_;
+  ::std::vector<uint32_t> order_;
+  ::std::vector<uint32_t> scratch_;
+  // occlusion culled drawing where multi draw indirect is supported, the
+  // late pass loads what render_pass_ stored
+  ::std::optional<DepthPyramid> pyramid_;
+  ::std::optional<OcclusionCuller> culler_;
+  ::vk::RenderPass late_pass_{nullptr};
+  ::vk::IndexType index_type_{::vk::IndexType::eUint16};
+  ::vk::DeviceMemory device_memory_{nullptr};
+
+  ::std::vector<::vk::Buffer> device_buffers_;
+  ::std::vector<::vk::ShaderModule> shader_modules_;
+  ::std::vector<::vk::DescriptorSet> desc_sets_;
+};
+
+#endif // MESH_APP_HPP_
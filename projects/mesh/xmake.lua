@@ -0,0 +1,15 @@
+target("VulkanMesh")
+    set_kind("binary")
+    add_rules("glsl")
+    add_deps("VulkanBase")
+    add_files("main.vert"
+              ,"main.frag"
+              ,"cull.comp"
+              ,"depth_reduce.comp"
+    )
+    add_files("main.cpp", "mesh_app.cpp")
+    add_includedirs(path.join("$(projectdir)", "include"))
+    before_build_file(enable_clang_tidy)
+    on_load(function (target)
+            target:add(find_packages("vulkan", "sdl2"))
+    end)
@@ -0,0 +1,16 @@
+#version 450 core
+
+layout(location = 0) in vec4 in_color;
+layout(location = 1) in vec2 coord;
+
+layout(location = 0) out vec4 color;
+
+layout(set = 0, binding = 0) uniform sampler2D image;
+
+void main() {
+    color = texture(image, coord) * in_color;
+    // the pipeline does not blend, cut the transparent border out instead
+    if (color.a < .5f) {
+        discard;
+    }
+}
@@ -0,0 +1,19 @@
+#version 450 core
+
+// in pixels, see SpriteVertex
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 in_coord;
+layout(location = 2) in vec4 in_color;
+
+layout(location = 0) out vec4 out_color;
+layout(location = 1) out vec2 out_coord;
+
+layout(push_constant) uniform Screen {
+    vec2 extent;
+};
+
+void main() {
+    out_color = in_color;
+    out_coord = in_coord;
+    gl_Position = vec4(position / extent * 2.f - 1.f, 0.f, 1.f);
+}
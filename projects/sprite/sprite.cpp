@@ -0,0 +1,249 @@
+#include "sprite.hpp"
+
+#include "base_type.hpp"
+#include "create.hpp"
+#include "image_cache.hpp"
+#include "sprite_batch.hpp"
+#include "texture_stream.hpp"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <random>
+#include <utility>
+
+#include <glm/gtc/constants.hpp>
+#include <vulkan/vulkan.hpp>
+
+extern ::std::filesystem::path shader_path;
+
+namespace {
+
+::std::filesystem::path const kImageCacheDir{".cache/images"};
+
+::std::array const kImages{
+    "images/KagamineRin.png",
+    "images/KagamineLen.png",
+};
+
+uint32_t const kParticleCount{100000};
+
+// push constants of main.vert, sprites are positioned in pixels
+struct Screen {
+  ::glm::vec2 extent;
+};
+
+auto create_render_pass(::vk::Device &device,
+                        SwapchainRequiredInfo &required_info)
+    -> ::vk::RenderPass {
+  ::vk::AttachmentDescription att_desc;
+  att_desc.setSamples(::vk::SampleCountFlagBits::e1)
+      .setLoadOp(::vk::AttachmentLoadOp::eClear)
+      .setStoreOp(::vk::AttachmentStoreOp::eStore)
+      .setStencilLoadOp(::vk::AttachmentLoadOp::eDontCare)
+      .setStencilStoreOp(::vk::AttachmentStoreOp::eDontCare)
+      .setFormat(required_info.format.format)
+      .setInitialLayout(::vk::ImageLayout::eUndefined)
+      .setFinalLayout(::vk::ImageLayout::ePresentSrcKHR);
+
+  ::vk::AttachmentReference att_ref;
+  att_ref.setLayout(::vk::ImageLayout::eColorAttachmentOptimal)
+      .setAttachment(0);
+  ::vk::SubpassDescription sub_desc;
+  sub_desc.setPipelineBindPoint(::vk::PipelineBindPoint::eGraphics)
+      .setColorAttachments(att_ref);
+
+  ::vk::RenderPassCreateInfo info;
+  info.setAttachments(att_desc).setSubpasses(sub_desc);
+  ::vk::RenderPass render_pass = device.createRenderPass(info);
+  assert(render_pass && "render pass create failed!");
+  return render_pass;
+}
+
+} // namespace
+
+auto SpriteApplication::app_init(QueueFamilyIndices &queue_indices) -> void {
+  this->render_pass_ = create_render_pass(this->device_, this->required_info_);
+  this->framebuffers_ =
+      create_frame_buffers(this->device_, this->swapchain_imageviews_,
+                           this->render_pass_, this->required_info_);
+
+  // textures show a placeholder until their mip chain is built and uploaded
+  this->streamer_.emplace(this->physical_, this->device_, queue_indices,
+                          this->graphics_, this->features_);
+  this->sampler_ = create_texture_sampler(this->physical_, this->device_);
+  ::vk::DescriptorSetLayout set_layout{nullptr};
+  for (auto const *image : kImages) {
+    this->textures_.emplace_back(this->streamer_->request([image] {
+      return generate_mipmaps(create_cached_image_data(image, kImageCacheDir));
+    }));
+    ::std::vector views{this->streamer_->get_view(this->textures_.back())};
+    // every texture gets the same cached layout
+    auto [layout, sets] = allocate_descriptor_set<::vk::ImageView>(
+        this->device_, this->layouts_, this->descriptors_, views.begin(),
+        views.end(), ::vk::DescriptorType::eCombinedImageSampler,
+        ::vk::ShaderStageFlagBits::eFragment, this->sampler_);
+    set_layout = layout;
+    this->desc_sets_.insert(this->desc_sets_.end(), sets.begin(), sets.end());
+  }
+  this->layout_ = this->layouts_.get_pipeline_layout(
+      {set_layout}, {::vk::PushConstantRange{
+                        ::vk::ShaderStageFlagBits::eVertex, 0,
+                        sizeof(Screen)}});
+
+  this->batch_ = SpriteBatch{this->physical_,
+                             this->device_,
+                             queue_indices,
+                             this->cmdpool_,
+                             this->graphics_,
+                             this->required_info_.image_count,
+                             kParticleCount};
+  // textures are interleaved on purpose, sorting still draws each once
+  ::std::mt19937 engine{42};
+  auto extent = this->required_info_.extent;
+  ::std::uniform_real_distribution<float> x{0.f,
+                                            static_cast<float>(extent.width)};
+  ::std::uniform_real_distribution<float> y{0.f,
+                                            static_cast<float>(extent.height)};
+  ::std::uniform_real_distribution<float> size{8.f, 32.f};
+  ::std::uniform_real_distribution<float> speed{-120.f, 120.f};
+  ::std::uniform_real_distribution<float> spin{-::glm::pi<float>(),
+                                               ::glm::pi<float>()};
+  ::std::uniform_int_distribution<uint32_t> tint{0x80, 0xff};
+  for (uint32_t i = 0; i < kParticleCount; ++i) {
+    Sprite sprite;
+    sprite.position = ::glm::vec2{x(engine), y(engine)};
+    float side = size(engine);
+    sprite.size = ::glm::vec2{side, side};
+    sprite.rotation = spin(engine);
+    // separate statements, the order of operands is unspecified
+    uint32_t red = tint(engine);
+    uint32_t green = tint(engine);
+    uint32_t blue = tint(engine);
+    sprite.color = 0xff000000 | red << 16 | green << 8 | blue;
+    sprite.key = static_cast<uint32_t>(i % kImages.size());
+    this->particles_.push_back(
+        Particle{sprite, ::glm::vec2{speed(engine), speed(engine)},
+                 spin(engine)});
+  }
+
+  this->shader_modules_ = {
+      create_shader_module(this->device_, shader_path / "main.vert.spv"),
+      create_shader_module(this->device_, shader_path / "main.frag.spv"),
+  };
+  ::vk::PipelineShaderStageCreateInfo vert_stage;
+  vert_stage.setStage(::vk::ShaderStageFlagBits::eVertex)
+      .setModule(this->shader_modules_[0])
+      .setPName("main");
+  ::vk::PipelineShaderStageCreateInfo frag_stage;
+  frag_stage.setStage(::vk::ShaderStageFlagBits::eFragment)
+      .setModule(this->shader_modules_[1])
+      .setPName("main");
+  this->pipeline_ = this->create_pipeline({vert_stage, frag_stage});
+}
+
+auto SpriteApplication::app_destroy() -> void {
+  this->device_.destroyPipeline(this->pipeline_);
+  for (auto &shader : this->shader_modules_) {
+    this->device_.destroyShaderModule(shader);
+  }
+  this->batch_.destroy();
+  this->device_.destroySampler(this->sampler_);
+  this->streamer_->destroy();
+  this->streamer_.reset();
+  for (auto &buffer : this->framebuffers_) {
+    this->device_.destroyFramebuffer(buffer);
+  }
+  this->device_.destroyRenderPass(this->render_pass_);
+}
+
+auto SpriteApplication::get_vertex_input_description() -> decltype(auto) {
+  return SpriteBatch::get_vertex_input_description();
+}
+
+auto SpriteApplication::update_textures() -> void {
+  // the previous frame's fence has been waited, the sets are not in use
+  auto residents = this->streamer_->update();
+  ::std::vector<::vk::DescriptorImageInfo> image_infos;
+  image_infos.reserve(residents.size());
+  ::std::vector<::vk::WriteDescriptorSet> writes;
+  for (auto handle : residents) {
+    auto index = ::std::find(this->textures_.begin(), this->textures_.end(),
+                             handle) -
+                 this->textures_.begin();
+    image_infos.emplace_back(this->sampler_, this->streamer_->get_view(handle),
+                             ::vk::ImageLayout::eShaderReadOnlyOptimal);
+    writes.emplace_back(this->desc_sets_[index], 0, 0, 1,
+                        ::vk::DescriptorType::eCombinedImageSampler,
+                        &image_infos.back());
+  }
+  if (!writes.empty()) {
+    this->device_.updateDescriptorSets(writes, {});
+  }
+}
+
+auto SpriteApplication::update_particles() -> void {
+  auto now = ::std::chrono::steady_clock::now();
+  ::std::chrono::duration<float> elapsed = now - this->last_time_;
+  this->last_time_ = now;
+  float delta = elapsed.count();
+
+  auto extent = this->required_info_.extent;
+  ::glm::vec2 bound{static_cast<float>(extent.width),
+                    static_cast<float>(extent.height)};
+  for (auto &particle : this->particles_) {
+    auto &sprite = particle.sprite;
+    sprite.position += particle.velocity * delta;
+    sprite.rotation += particle.spin * delta;
+    for (int axis = 0; axis < 2; ++axis) {
+      if (sprite.position[axis] < 0.f || sprite.position[axis] > bound[axis]) {
+        particle.velocity[axis] = -particle.velocity[axis];
+        sprite.position[axis] =
+            ::std::clamp(sprite.position[axis], 0.f, bound[axis]);
+      }
+    }
+    this->batch_.submit(sprite);
+  }
+}
+
+auto SpriteApplication::record_command(::vk::CommandBuffer &cbuf,
+                                       ::vk::Framebuffer &fbuf) -> void {
+  this->update_textures();
+  this->batch_.begin_frame(this->current_frame_);
+  this->update_particles();
+  auto const &runs = this->batch_.flush();
+
+  ::vk::CommandBufferBeginInfo begin_info;
+  begin_info.setFlags(::vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+  [[maybe_unused]] auto result = cbuf.begin(&begin_info);
+  assert(result == ::vk::Result::eSuccess && "command buffer record failed!");
+
+  ::vk::ClearValue value{::std::array<float, 4>{1.f, 1.f, 1.f, 1.f}};
+  ::vk::RenderPassBeginInfo render_pass_begin;
+  render_pass_begin.setRenderPass(this->render_pass_)
+      .setRenderArea(
+          ::vk::Rect2D{::vk::Offset2D{0, 0}, this->required_info_.extent})
+      .setClearValues(value)
+      .setFramebuffer(fbuf);
+  cbuf.beginRenderPass(render_pass_begin, ::vk::SubpassContents::eInline);
+  cbuf.bindPipeline(::vk::PipelineBindPoint::eGraphics, this->pipeline_);
+
+  Screen screen{::glm::vec2{
+      static_cast<float>(this->required_info_.extent.width),
+      static_cast<float>(this->required_info_.extent.height)}};
+  cbuf.pushConstants(this->layout_, ::vk::ShaderStageFlagBits::eVertex, 0,
+                     sizeof(Screen), &screen);
+  this->batch_.bind(cbuf);
+  // one draw per texture however the sprites were submitted, the texture is
+  // the low half of the key
+  for (auto const &run : runs) {
+    cbuf.bindDescriptorSets(::vk::PipelineBindPoint::eGraphics, this->layout_,
+                            0, this->desc_sets_[run.key & 0xffff], {});
+    cbuf.drawIndexed(run.index_count, 1, run.first_index, 0, 0);
+  }
+
+  cbuf.endRenderPass();
+  cbuf.end();
+}
@@ -0,0 +1,54 @@
+#ifndef SPRITE_HPP_
+#define SPRITE_HPP_
+
+#include "renderer.hpp"
+#include "sprite_batch.hpp"
+#include "texture_stream.hpp"
+
+#include <chrono>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class SpriteApplication : public Renderer<SpriteApplication> {
+  using this_class = SpriteApplication;
+  using base_class = Renderer<this_class>;
+
+  friend base_class;
+
+private:
+  // a sprite moving on its own, bouncing off the window's edges
+  struct Particle {
+    Sprite sprite;
+    ::glm::vec2 velocity;
+    float spin;
+  };
+
+  auto app_init(QueueFamilyIndices &queue_indices) -> void;
+
+  auto app_destroy() -> void;
+
+  auto get_vertex_input_description() -> decltype(auto);
+
+  auto record_command(::vk::CommandBuffer &cbuf, ::vk::Framebuffer &fbuf)
+      -> void;
+
+  auto update_textures() -> void;
+
+  auto update_particles() -> void;
+
+  ::std::chrono::time_point<::std::chrono::steady_clock> last_time_{
+      ::std::chrono::steady_clock::now()};
+  ::std::optional<TextureStreamer> streamer_;
+  ::std::vector<TextureHandle> textures_;
+  ::vk::Sampler sampler_{nullptr};
+  SpriteBatch batch_;
+  ::std::vector<Particle> particles_;
+
+  // one set per texture, a sprite's key indexes them
+  ::std::vector<::vk::DescriptorSet> desc_sets_;
+  ::std::vector<::vk::ShaderModule> shader_modules_;
+};
+
+#endif // SPRITE_HPP_
@@ -0,0 +1,22 @@
+#version 450 core
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 1) in vec2 coord;
+layout(location = 2) flat in uint texture_index;
+
+layout(location = 0) out vec4 color;
+
+layout(set = 1, binding = 0) uniform sampler samplers[16];
+layout(set = 1, binding = 1) uniform texture2D textures[];
+
+// index into the bindless samplers, uniform across the draw
+layout(push_constant) uniform Material {
+    uint sampler_index;
+};
+
+void main() {
+    color = texture(sampler2D(textures[nonuniformEXT(texture_index)],
+                              samplers[sampler_index]),
+                    coord);
+}
@@ -1,8 +1,14 @@
 #include "texture.hpp"
 
+#include "atlas.hpp"
 #include "base_type.hpp"
+#include "bindless.hpp"
 #include "create.hpp"
+#include "gpu_culling.hpp"
+#include "image_cache.hpp"
 #include "scope_guard.hpp"
+#include "texture_stream.hpp"
+#include "vertex_layout.hpp"
 
 #include <stddef.h>
 #include <string.h>
@@ -10,6 +16,7 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
+#include <cmath>
 #include <limits>
 #include <tuple>
 #include <utility>
@@ -21,42 +28,47 @@ extern ::std::filesystem::path shader_path;
 
 namespace {
 
+::std::filesystem::path const kImageCacheDir{".cache/images"};
+
+int const kAtlasExtent{2048};
+int const kAtlasPadding{4};
+
 struct Vertex {
   ::glm::vec2 position;
   ::glm::vec2 texture;
 };
 
-// triangle
+// one quad, every instance places and textures its own copy
 ::std::array vertices{
-    // rin
-    Vertex{{.125f, -1.f}, {1.f, 0.f}},
-    Vertex{{.875f, -1.f}, {0.f, 0.f}},
-    Vertex{{.875f, 0.f}, {0.f, 1.f}},
-    Vertex{{.125f, 0.f}, {1.f, 1.f}},
-    // len
-    Vertex{{-.875f, -1.f}, {1.f, 0.f}},
-    Vertex{{-.125f, -1.f}, {0.f, 0.f}},
-    Vertex{{-.125f, 0.f}, {0.f, 1.f}},
-    Vertex{{-.875f, 0.f}, {1.f, 1.f}},
+    Vertex{{-.375f, -1.f}, {1.f, 0.f}},
+    Vertex{{.375f, -1.f}, {0.f, 0.f}},
+    Vertex{{.375f, 0.f}, {0.f, 1.f}},
+    Vertex{{-.375f, 0.f}, {1.f, 1.f}},
+};
+
+::std::array<uint16_t, 6> indices{0, 1, 2, 2, 3, 0};
+
+// bounding sphere of the quad
+::glm::vec4 const kQuadSphere{0.f, -.5f, 0.f, .625f};
+
+// shared by every instance, the models come from the instance buffer
+struct Camera {
+  alignas(16)::glm::mat4 view, project;
+};
+
+Camera const kCamera{
+    ::glm::translate(::glm::mat4(1.f), glm::vec3(0.f, 0.5f, -3.6f)),
+    ::glm::perspective(::glm::radians(30.f), 4.f / 3.f, .1f, 5.f),
 };
 
-::std::array<uint16_t, 12> indices{0, 1, 2, 2, 3, 0, 4, 5, 6, 6, 7, 4};
-
-::std::array ebos{
-    // rin
-    MVP{
-        ::glm::rotate(::glm::mat4(1.f), ::glm::radians(-20.f),
-                      ::glm::vec3(0.f, 1.f, 0.f)),
-        ::glm::translate(::glm::mat4(1.f), glm::vec3(0.f, 0.5f, -3.6f)),
-        ::glm::perspective(::glm::radians(30.f), 4.f / 3.f, .1f, 5.f),
-    },
-    // len
-    MVP{
-        ::glm::rotate(::glm::mat4(1.f), ::glm::radians(20.f),
-                      ::glm::vec3(0.f, 1.f, 0.f)),
-        ::glm::translate(::glm::mat4(1.f), glm::vec3(0.f, 0.5f, -3.6f)),
-        ::glm::perspective(::glm::radians(30.f), 4.f / 3.f, .1f, 5.f),
-    },
+// rin on the right and len on the left, turned towards each other
+::std::array const models{
+    ::glm::rotate(::glm::mat4(1.f), ::glm::radians(-20.f),
+                  ::glm::vec3(0.f, 1.f, 0.f)) *
+        ::glm::translate(::glm::mat4(1.f), ::glm::vec3(.5f, 0.f, 0.f)),
+    ::glm::rotate(::glm::mat4(1.f), ::glm::radians(20.f),
+                  ::glm::vec3(0.f, 1.f, 0.f)) *
+        ::glm::translate(::glm::mat4(1.f), ::glm::vec3(-.5f, 0.f, 0.f)),
 };
 
 auto create_render_pass(::vk::Device &device,
@@ -86,15 +98,11 @@ auto create_render_pass(::vk::Device &device,
   return render_pass;
 }
 
-auto create_pipeline_layout(
-    ::vk::Device &device, ::std::vector<::vk::DescriptorSetLayout> &set_layouts)
-    -> ::vk::PipelineLayout {
-  ::vk::PipelineLayoutCreateInfo info;
-  info.setSetLayouts(set_layouts);
-  ::vk::PipelineLayout layout = device.createPipelineLayout(info);
-  assert(layout && "pipeline layout create failed!");
-  return layout;
-}
+// index into the bindless sampler table, see bindless.frag, the texture
+// index comes with each instance
+struct Material {
+  uint32_t sampler_index;
+};
 
 } // namespace
 
@@ -104,54 +112,114 @@ auto TextureApplication::app_init(QueueFamilyIndices &queue_indices) -> void {
       create_frame_buffers(this->device_, this->swapchain_imageviews_,
                            this->render_pass_, this->required_info_);
 
+  auto [pages, regions] = create_atlas(
+      {
+          create_cached_image_data("images/KagamineRin.png", kImageCacheDir),
+          create_cached_image_data("images/KagamineLen.png", kImageCacheDir),
+      },
+      kAtlasExtent, kAtlasExtent, kAtlasPadding);
+
+  // pages show a placeholder until their mip chain is built and uploaded
+  this->streamer_.emplace(this->physical_, this->device_, queue_indices,
+                          this->graphics_, this->features_);
+  ::std::vector<::vk::ImageView> views;
+  for (auto const &page : pages) {
+    this->textures_.emplace_back(this->streamer_->request([page] {
+      return generate_mipmaps(page, get_atlas_mip_levels(kAtlasPadding));
+    }));
+    views.emplace_back(this->streamer_->get_view(this->textures_.back()));
+  }
+  this->sampler_ = create_texture_sampler(this->physical_, this->device_);
+
+  // the camera is pushed to the uniform ring every frame, the set only holds
+  // the ring and record_command passes the offset
+  ::std::vector uniforms{this->uniforms_.get_buffer()};
+  auto [layout0, sets0] = allocate_descriptor_set<::vk::Buffer>(
+      this->device_, this->layouts_, this->descriptors_, uniforms.begin(),
+      uniforms.end(), ::vk::DescriptorType::eUniformBufferDynamic,
+      ::vk::ShaderStageFlagBits::eVertex, sizeof(Camera));
+  this->desc_sets_.insert(this->desc_sets_.end(), sets0.begin(), sets0.end());
+  ::std::vector<::vk::DescriptorSetLayout> set_layouts{layout0};
+  ::std::vector<::vk::PushConstantRange> ranges;
+  char const *frag_shader{"main.frag.spv"};
+  if (this->features_.descriptor_indexing) {
+    // every page sits in one table, each instance picks its page by index
+    this->bindless_.emplace(this->physical_, this->device_);
+    this->sampler_index_ = this->bindless_->add_sampler(this->sampler_);
+    for (auto const &view : views) {
+      this->texture_indices_.emplace_back(this->bindless_->add_image(view));
+    }
+    set_layouts.emplace_back(this->bindless_->get_layout());
+    this->desc_sets_.emplace_back(this->bindless_->get_set());
+    ranges.emplace_back(::vk::ShaderStageFlagBits::eFragment, 0,
+                        sizeof(Material));
+    frag_shader = "bindless.frag.spv";
+  } else {
+    auto [layout1, sets1] = allocate_descriptor_set<::vk::ImageView>(
+        this->device_, this->layouts_, this->descriptors_, views.begin(),
+        views.end(), ::vk::DescriptorType::eCombinedImageSampler,
+        ::vk::ShaderStageFlagBits::eFragment, this->sampler_);
+    this->desc_sets_.insert(this->desc_sets_.end(), sets1.begin(),
+                            sets1.end());
+    set_layouts.emplace_back(layout1);
+    // binding i reads image_infos[i] in update_textures
+    if (this->features_.update_template) {
+      ::std::vector<::vk::DescriptorUpdateTemplateEntry> entries;
+      for (uint32_t i = 0; i < views.size(); ++i) {
+        entries.emplace_back(i, 0, 1,
+                             ::vk::DescriptorType::eCombinedImageSampler,
+                             i * sizeof(::vk::DescriptorImageInfo),
+                             sizeof(::vk::DescriptorImageInfo));
+      }
+      this->update_template_ =
+          create_update_template(this->device_, layout1, entries);
+    }
+    for (uint32_t i = 0; i < views.size(); ++i) {
+      this->texture_indices_.emplace_back(i);
+    }
+  }
+
+  // every quad is one instance of the same draw
+  ::std::vector<Instance> instances;
+  for (size_t i = 0; i < regions.size(); ++i) {
+    instances.push_back(
+        Instance{models[i],
+                 ::glm::vec4{regions[i].offset, regions[i].scale},
+                 this->texture_indices_[regions[i].page]});
+  }
+  this->instance_count_ = static_cast<uint32_t>(instances.size());
   ::std::vector buffers{
       wrap_buffer(this->physical_, this->device_, queue_indices, vertices,
                   ::vk::BufferUsageFlagBits::eVertexBuffer),
       wrap_buffer(this->physical_, this->device_, queue_indices, indices,
                   ::vk::BufferUsageFlagBits::eIndexBuffer),
-      wrap_buffer(this->physical_, this->device_, queue_indices, ebos.data(), 1,
-                  ::vk::BufferUsageFlagBits::eUniformBuffer),
-      wrap_buffer(this->physical_, this->device_, queue_indices, &ebos[1], 1,
-                  ::vk::BufferUsageFlagBits::eUniformBuffer),
+      wrap_buffer(this->physical_, this->device_, queue_indices,
+                  instances.data(), instances.size(),
+                  ::vk::BufferUsageFlagBits::eVertexBuffer),
   };
   ::std::tie(this->device_buffers_, this->device_memory_) =
       allocate_memory<::vk::Buffer>(this->physical_, this->device_,
                                     this->cmdpool_, this->graphics_, buffers,
                                     ::vk::MemoryPropertyFlagBits::eDeviceLocal);
-  auto [pool0, layout0, sets0] = allocate_descriptor_set<::vk::Buffer>(
-      this->device_, this->device_buffers_.begin() + 2,
-      this->device_buffers_.end(), ::vk::DescriptorType::eUniformBuffer,
-      ::vk::ShaderStageFlagBits::eVertex, sizeof(MVP));
-
-  ::std::vector images{
-      wrap_image(this->physical_, this->device_, queue_indices,
-                 create_image_data("images/KagamineRin.png"),
-                 ::vk::ImageUsageFlagBits::eSampled),
-      wrap_image(this->physical_, this->device_, queue_indices,
-                 create_image_data("images/KagamineLen.png"),
-                 ::vk::ImageUsageFlagBits::eSampled),
-  };
-  ::std::tie(this->texture_images_, this->texture_memory_) =
-      allocate_memory<::vk::Image>(this->physical_, this->device_,
-                                   this->cmdpool_, this->graphics_, images,
-                                   ::vk::MemoryPropertyFlagBits::eDeviceLocal);
-  this->texture_imageviews_ = create_image_views(
-      this->device_, this->texture_images_, ::vk::Format::eR8G8B8A8Srgb);
-  this->sampler_ = create_texture_sampler(this->physical_, this->device_);
-  auto [pool1, layout1, sets1] = allocate_descriptor_set<::vk::ImageView>(
-      this->device_, this->texture_imageviews_.begin(),
-      this->texture_imageviews_.end(),
-      ::vk::DescriptorType::eCombinedImageSampler,
-      ::vk::ShaderStageFlagBits::eFragment, this->sampler_);
-
-  this->desc_pools_ = {pool0, pool1};
-  this->set_layouts_ = {layout0, layout1};
-  this->desc_sets_.insert(this->desc_sets_.end(), sets0.begin(), sets0.end());
-  this->desc_sets_.insert(this->desc_sets_.end(), sets1.begin(), sets1.end());
-  this->layout_ = create_pipeline_layout(this->device_, this->set_layouts_);
+  if (this->features_.multi_draw_indirect) {
+    // each instance is an object the GPU culls and draws on its own
+    ::std::vector<DrawObject> objects;
+    for (uint32_t i = 0; i < this->instance_count_; ++i) {
+      objects.push_back(DrawObject{instances[i].model, kQuadSphere, 0,
+                                   static_cast<uint32_t>(indices.size()), 0,
+                                   i});
+    }
+    this->culler_.emplace(this->physical_, this->device_, queue_indices,
+                          this->cmdpool_, this->graphics_, this->layouts_,
+                          this->descriptors_, shader_path / "cull.comp.spv",
+                          objects, this->required_info_.image_count,
+                          this->features_);
+  }
+
+  this->layout_ = this->layouts_.get_pipeline_layout(set_layouts, ranges);
   this->shader_modules_ = {
       create_shader_module(this->device_, shader_path / "main.vert.spv"),
-      create_shader_module(this->device_, shader_path / "main.frag.spv"),
+      create_shader_module(this->device_, shader_path / frag_shader),
   };
   ::vk::PipelineShaderStageCreateInfo vert_stage;
   vert_stage.setStage(::vk::ShaderStageFlagBits::eVertex)
@@ -166,26 +234,23 @@ auto TextureApplication::app_init(QueueFamilyIndices &queue_indices) -> void {
 
 auto TextureApplication::app_destroy() -> void {
   this->device_.destroyPipeline(this->pipeline_);
-  this->device_.destroyPipelineLayout(this->layout_);
   for (auto &shader : this->shader_modules_) {
     this->device_.destroyShaderModule(shader);
   }
-  for (auto &setlayout : this->set_layouts_) {
-    this->device_.destroyDescriptorSetLayout(setlayout);
+  if (this->update_template_) {
+    this->device_.destroyDescriptorUpdateTemplate(this->update_template_);
   }
-  for (auto end = this->desc_pools_.size(), i = static_cast<decltype(end)>(0);
-       i < end; ++i) {
-    this->device_.freeDescriptorSets(this->desc_pools_[i], this->desc_sets_[i]);
-    this->device_.destroyDescriptorPool(this->desc_pools_[i]);
+  if (this->culler_) {
+    this->culler_->destroy();
+    this->culler_.reset();
   }
-  this->device_.destroySampler(this->sampler_);
-  this->device_.freeMemory(this->texture_memory_);
-  for (auto end = this->texture_images_.size(),
-            i = static_cast<decltype(end)>(0);
-       i < end; ++i) {
-    this->device_.destroyImageView(this->texture_imageviews_[i]);
-    this->device_.destroyImage(this->texture_images_[i]);
+  if (this->bindless_) {
+    this->bindless_->destroy();
+    this->bindless_.reset();
   }
+  this->device_.destroySampler(this->sampler_);
+  this->streamer_->destroy();
+  this->streamer_.reset();
   this->device_.freeMemory(this->device_memory_);
   for (auto &buffer : this->device_buffers_) {
     this->device_.destroyBuffer(buffer);
@@ -197,33 +262,79 @@ auto TextureApplication::app_destroy() -> void {
 }
 
 auto TextureApplication::get_vertex_input_description() -> decltype(auto) {
-  ::std::array<::vk::VertexInputAttributeDescription, 2> attr_descs;
-  attr_descs[0]
-      .setBinding(0)
-      .setLocation(0)
-      .setFormat(::vk::Format::eR32G32Sfloat)
-      .setOffset(offsetof(Vertex, position));
-  attr_descs[1]
-      .setBinding(0)
-      .setLocation(1)
-      .setFormat(::vk::Format::eR32G32Sfloat)
-      .setOffset(offsetof(Vertex, texture));
-
-  ::vk::VertexInputBindingDescription bind_desc;
-  bind_desc.setBinding(0)
-      .setInputRate(::vk::VertexInputRate::eVertex)
-      .setStride(sizeof(Vertex));
-
-  return ::std::make_pair(attr_descs, bind_desc);
+  auto [instance_attrs, instance_desc] = get_instance_input_description(1, 2);
+  auto [vertex_attrs, vertex_desc] =
+      get_vertex_layout<&Vertex::position, &Vertex::texture>();
+  ::std::array<::vk::VertexInputAttributeDescription,
+               ::std::tuple_size_v<decltype(vertex_attrs)> +
+                   ::std::tuple_size_v<decltype(instance_attrs)>>
+      attr_descs;
+  ::std::copy(vertex_attrs.begin(), vertex_attrs.end(), attr_descs.begin());
+  ::std::copy(instance_attrs.begin(), instance_attrs.end(),
+              attr_descs.begin() + vertex_attrs.size());
+  ::std::array bind_descs{vertex_desc, instance_desc};
+
+  return ::std::make_pair(attr_descs, bind_descs);
+}
+
+auto TextureApplication::update_textures() -> void {
+  // the previous frame's fence has been waited, the sets are not in use
+  auto residents = this->streamer_->update();
+  if (residents.empty()) {
+    return;
+  }
+  if (this->bindless_) {
+    for (auto handle : residents) {
+      auto index = ::std::find(this->textures_.begin(), this->textures_.end(),
+                               handle) -
+                   this->textures_.begin();
+      this->bindless_->set_image(this->texture_indices_[index],
+                                 this->streamer_->get_view(handle));
+    }
+    return;
+  }
+  // rewrite every page in one call, the rest keep their current view
+  ::std::vector<::vk::DescriptorImageInfo> image_infos;
+  for (auto handle : this->textures_) {
+    image_infos.emplace_back(this->sampler_, this->streamer_->get_view(handle),
+                             ::vk::ImageLayout::eShaderReadOnlyOptimal);
+  }
+  if (this->update_template_) {
+    update_descriptor_set(this->device_, this->desc_sets_[1],
+                          this->update_template_, image_infos.data());
+    return;
+  }
+  // 1.0 devices take the same writes batched into one call
+  ::std::vector<::vk::WriteDescriptorSet> writes;
+  for (uint32_t i = 0; i < image_infos.size(); ++i) {
+    writes.emplace_back(this->desc_sets_[1], i, 0, 1,
+                        ::vk::DescriptorType::eCombinedImageSampler,
+                        &image_infos[i]);
+  }
+  this->device_.updateDescriptorSets(writes, {});
 }
 
 auto TextureApplication::record_command(::vk::CommandBuffer &cbuf,
                                         ::vk::Framebuffer &fbuf) -> void {
+  this->update_textures();
+
   ::vk::CommandBufferBeginInfo begin_info;
   begin_info.setFlags(::vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
   [[maybe_unused]] auto result = cbuf.begin(&begin_info);
   assert(result == ::vk::Result::eSuccess && "command buffer record failed!");
 
+  // the scene sways around its resting angle
+  ::std::chrono::duration<float> time =
+      ::std::chrono::system_clock::now() - this->start_time_;
+  Camera camera = kCamera;
+  camera.view = ::glm::rotate(camera.view,
+                              ::glm::radians(10.f) * ::std::sin(time.count()),
+                              ::glm::vec3(0.f, 1.f, 0.f));
+  if (this->culler_) {
+    this->culler_->cull(cbuf, this->current_frame_,
+                        camera.project * camera.view);
+  }
+
   ::vk::ClearValue value{::std::array<float, 4>{1.f, 1.f, 1.f, 1.f}};
   ::vk::RenderPassBeginInfo render_pass_begin;
   render_pass_begin.setRenderPass(this->render_pass_)
@@ -234,12 +345,23 @@ auto TextureApplication::record_command(::vk::CommandBuffer &cbuf,
   cbuf.beginRenderPass(render_pass_begin, ::vk::SubpassContents::eInline);
   cbuf.bindPipeline(::vk::PipelineBindPoint::eGraphics, this->pipeline_);
 
-  cbuf.bindVertexBuffers(0, this->device_buffers_[0], {0});
+  cbuf.bindVertexBuffers(
+      0, {this->device_buffers_[0], this->device_buffers_[2]}, {0, 0});
   cbuf.bindIndexBuffer(this->device_buffers_[1], 0, ::vk::IndexType::eUint16);
+  uint32_t offset = this->uniforms_.push(camera);
   cbuf.bindDescriptorSets(::vk::PipelineBindPoint::eGraphics, this->layout_, 0,
-                          this->desc_sets_, {});
+                          this->desc_sets_, offset);
+  if (this->bindless_) {
+    Material material{this->sampler_index_};
+    cbuf.pushConstants(this->layout_, ::vk::ShaderStageFlagBits::eFragment, 0,
+                       sizeof(Material), &material);
+  }
 
-  cbuf.drawIndexed(indices.size(), 1, 0, 0, 0);
+  if (this->culler_) {
+    this->culler_->draw(cbuf, this->current_frame_);
+  } else {
+    cbuf.drawIndexed(indices.size(), this->instance_count_, 0, 0, 0);
+  }
 
   cbuf.endRenderPass();
   cbuf.end();
@@ -1,7 +1,13 @@
 #ifndef TEXTURE_HPP_
 #define TEXTURE_HPP_
 
+#include "bindless.hpp"
+#include "gpu_culling.hpp"
 #include "renderer.hpp"
+#include "texture_stream.hpp"
+
+#include <chrono>
+#include <optional>
 
 class TextureApplication : public Renderer<TextureApplication> {
   using this_class = TextureApplication;
@@ -19,16 +25,26 @@ private:
   auto record_command(::vk::CommandBuffer &cbuf, ::vk::Framebuffer &fbuf)
       -> void;
 
-  ::vk::DeviceMemory texture_memory_{nullptr};
+  auto update_textures() -> void;
+
+  ::std::chrono::time_point<::std::chrono::system_clock> start_time_{
+      ::std::chrono::system_clock::now()};
+  ::std::optional<TextureStreamer> streamer_;
+  ::std::vector<TextureHandle> textures_;
+  // bindless mode, when the device has descriptor indexing
+  ::std::optional<BindlessTable> bindless_;
+  ::std::vector<uint32_t> texture_indices_;
+  uint32_t sampler_index_{0};
+  // classic mode, rewrites the per-page combined image samplers
+  ::vk::DescriptorUpdateTemplate update_template_{nullptr};
+  uint32_t instance_count_{0};
+  // GPU culled indirect draws, when the device has multi draw indirect
+  ::std::optional<GpuCuller> culler_;
   ::vk::DeviceMemory device_memory_{nullptr};
   ::vk::Sampler sampler_{nullptr};
 
   ::std::vector<::vk::Buffer> device_buffers_;
-  ::std::vector<::vk::Image> texture_images_;
-  ::std::vector<::vk::ImageView> texture_imageviews_;
-  ::std::vector<::vk::DescriptorPool> desc_pools_;
   ::std::vector<::vk::DescriptorSet> desc_sets_;
-  ::std::vector<::vk::DescriptorSetLayout> set_layouts_;
   ::std::vector<::vk::ShaderModule> shader_modules_;
 };
 
@@ -4,6 +4,8 @@ target("VulkanTexture")
     add_deps("VulkanBase")
     add_files("main.vert"
               ,"main.frag"
+              ,"bindless.frag"
+              ,"cull.comp"
     )
     add_files("main.cpp", "texture.cpp")
     add_includedirs(path.join("$(projectdir)", "include"))
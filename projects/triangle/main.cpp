@@ -1,21 +1,37 @@
 #include <filesystem>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
+#include "descriptor_buffer.hpp"
 #include "renderer.hpp"
 #include "triangle.hpp"
 
 namespace fs = ::std::filesystem;
 
 ::fs::path shader_path;
+DescriptorBackend descriptor_backend{DescriptorBackend::kPush};
 
 auto main(int argc, char const *const argv[]) -> int {
   if (argc < 2) {
     ::std::cerr << "usage: " << argv[0] << " "
-                << "shader_path" << ::std::endl;
+                << "shader_path [pool|push|buffer]" << ::std::endl;
     return EXIT_FAILURE;
   }
   shader_path = ::fs::path{argv[1]};
+  if (argc > 2) {
+    ::std::string backend{argv[2]};
+    if (backend == "pool") {
+      descriptor_backend = DescriptorBackend::kPool;
+    } else if (backend == "push") {
+      descriptor_backend = DescriptorBackend::kPush;
+    } else if (backend == "buffer") {
+      descriptor_backend = DescriptorBackend::kBuffer;
+    } else {
+      ::std::cerr << "unknown descriptor backend: " << backend << ::std::endl;
+      return EXIT_FAILURE;
+    }
+  }
 
   try {
     TriangleApplication triangle;
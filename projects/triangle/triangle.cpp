@@ -2,7 +2,9 @@
 
 #include "base_type.hpp"
 #include "create.hpp"
+#include "descriptor_buffer.hpp"
 #include "scope_guard.hpp"
+#include "vertex_layout.hpp"
 
 #include <stddef.h>
 #include <string.h>
@@ -10,6 +12,7 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
+#include <iostream>
 #include <limits>
 #include <tuple>
 #include <utility>
@@ -17,19 +20,20 @@
 #include <vulkan/vulkan.hpp>
 
 extern ::std::filesystem::path shader_path;
+extern DescriptorBackend descriptor_backend;
 
 namespace {
 
 struct Vertex {
   ::glm::vec2 position;
-  ::glm::vec3 color;
+  Unorm8x4 color;
 };
 
 // triangle
 ::std::array vertices{
-    Vertex{{0.f, -0.5f}, {1.f, 0.f, 0.f}},
-    Vertex{{0.5f, 0.5f}, {0.f, 1.f, 0.f}},
-    Vertex{{-0.5f, 0.5f}, {0.f, 0.f, 1.f}},
+    Vertex{{0.f, -0.5f}, Unorm8x4{0xff00'00ffu}},
+    Vertex{{0.5f, 0.5f}, Unorm8x4{0xff00'ff00u}},
+    Vertex{{-0.5f, 0.5f}, Unorm8x4{0xffff'0000u}},
 };
 
 ::std::array<uint16_t, 3> indices{0, 1, 2};
@@ -70,18 +74,20 @@ auto create_render_pass(::vk::Device &device,
   return render_pass;
 }
 
-auto create_pipeline_layout(::vk::Device &device,
-                            ::vk::DescriptorSetLayout &set_layout)
-    -> ::vk::PipelineLayout {
-  ::vk::PushConstantRange range;
-  range.setOffset(0)
-      .setStageFlags(::vk::ShaderStageFlagBits::eVertex)
-      .setSize(sizeof(float));
-  ::vk::PipelineLayoutCreateInfo info;
-  info.setSetLayouts(set_layout).setPushConstantRanges(range);
-  ::vk::PipelineLayout layout = device.createPipelineLayout(info);
-  assert(layout && "pipeline layout create failed!");
-  return layout;
+// the backend asked for on the command line, pool sets when the device lacks
+// its extension
+auto select_backend(DeviceFeatures const &features) -> DescriptorBackend {
+  bool supported = descriptor_backend == DescriptorBackend::kPool ||
+                   (descriptor_backend == DescriptorBackend::kPush &&
+                    features.push_descriptor) ||
+                   (descriptor_backend == DescriptorBackend::kBuffer &&
+                    features.descriptor_buffer);
+  if (!supported) {
+    ::std::clog << "descriptor backend not supported, using pool sets"
+                << ::std::endl;
+    return DescriptorBackend::kPool;
+  }
+  return descriptor_backend;
 }
 
 } // namespace
@@ -96,25 +102,53 @@ auto TriangleApplication::app_init(QueueFamilyIndices &queue_indices) -> void {
                   ::vk::BufferUsageFlagBits::eVertexBuffer),
       wrap_buffer(this->physical_, this->device_, queue_indices, indices,
                   ::vk::BufferUsageFlagBits::eIndexBuffer),
-      wrap_buffer(this->physical_, this->device_, queue_indices, &ebo, 1,
-                  ::vk::BufferUsageFlagBits::eUniformBuffer),
   };
   ::std::tie(this->device_buffers_, this->device_memory_) =
       allocate_memory<::vk::Buffer>(this->physical_, this->device_,
                                     this->cmdpool_, this->graphics_, buffers,
                                     ::vk::MemoryPropertyFlagBits::eDeviceLocal);
 
-  ::std::tie(this->desc_pool_, this->set_layout_, this->desc_sets_) =
-      allocate_descriptor_set<::vk::Buffer>(
-          this->device_, --this->device_buffers_.end(),
-          this->device_buffers_.end(), ::vk::DescriptorType::eUniformBuffer,
-          ::vk::ShaderStageFlagBits::eVertex, sizeof(MVP));
+  // ebo is pushed to the uniform ring each frame, its binding is either held
+  // in a set with a dynamic offset, pushed inline or written to the
+  // descriptor buffer while recording
+  this->backend_ = select_backend(this->features_);
+  ::vk::PipelineCreateFlags pipeline_flags;
+  switch (this->backend_) {
+  case DescriptorBackend::kPool: {
+    ::std::vector uniforms{this->uniforms_.get_buffer()};
+    ::std::tie(this->set_layout_, this->desc_sets_) =
+        allocate_descriptor_set<::vk::Buffer>(
+            this->device_, this->layouts_, this->descriptors_,
+            uniforms.begin(), uniforms.end(),
+            ::vk::DescriptorType::eUniformBufferDynamic,
+            ::vk::ShaderStageFlagBits::eVertex, sizeof(MVP));
+    break;
+  }
+  case DescriptorBackend::kPush:
+    this->set_layout_ = this->layouts_.get_set_layout(
+        {{0, ::vk::DescriptorType::eUniformBuffer, 1,
+          ::vk::ShaderStageFlagBits::eVertex}},
+        ::vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR);
+    break;
+  case DescriptorBackend::kBuffer:
+    this->set_layout_ = this->layouts_.get_set_layout(
+        {{0, ::vk::DescriptorType::eUniformBuffer, 1,
+          ::vk::ShaderStageFlagBits::eVertex}},
+        ::vk::DescriptorSetLayoutCreateFlagBits::eDescriptorBufferEXT);
+    this->descriptor_buffer_ =
+        DescriptorBuffer{this->physical_, this->device_, queue_indices,
+                         this->required_info_.image_count};
+    pipeline_flags = ::vk::PipelineCreateFlagBits::eDescriptorBufferEXT;
+    break;
+  }
 
   this->shader_modules_ = {
       create_shader_module(this->device_, shader_path / "main.vert.spv"),
       create_shader_module(this->device_, shader_path / "main.frag.spv"),
   };
-  this->layout_ = create_pipeline_layout(this->device_, this->set_layout_);
+  this->layout_ = this->layouts_.get_pipeline_layout(
+      {this->set_layout_},
+      {{::vk::ShaderStageFlagBits::eVertex, 0, sizeof(float)}});
   ::vk::PipelineShaderStageCreateInfo vert_stage;
   vert_stage.setStage(::vk::ShaderStageFlagBits::eVertex)
       .setModule(this->shader_modules_[0])
@@ -123,18 +157,18 @@ auto TriangleApplication::app_init(QueueFamilyIndices &queue_indices) -> void {
   frag_stage.setStage(::vk::ShaderStageFlagBits::eFragment)
       .setModule(this->shader_modules_[1])
       .setPName("main");
-  this->pipeline_ = this->create_pipeline({vert_stage, frag_stage});
+  this->pipeline_ =
+      this->create_pipeline({vert_stage, frag_stage}, pipeline_flags);
 }
 
 auto TriangleApplication::app_destroy() -> void {
   this->device_.destroyPipeline(this->pipeline_);
-  this->device_.destroyPipelineLayout(this->layout_);
+  if (this->backend_ == DescriptorBackend::kBuffer) {
+    this->descriptor_buffer_.destroy();
+  }
   for (auto &shader : this->shader_modules_) {
     this->device_.destroyShaderModule(shader);
   }
-  this->device_.freeDescriptorSets(this->desc_pool_, this->desc_sets_);
-  this->device_.destroyDescriptorPool(this->desc_pool_);
-  this->device_.destroyDescriptorSetLayout(set_layout_);
   this->device_.freeMemory(this->device_memory_);
   for (auto &buffer : this->device_buffers_) {
     this->device_.destroyBuffer(buffer);
@@ -146,24 +180,7 @@ auto TriangleApplication::app_destroy() -> void {
 }
 
 auto TriangleApplication::get_vertex_input_description() -> decltype(auto) {
-  ::std::array<::vk::VertexInputAttributeDescription, 2> attr_descs;
-  attr_descs[0]
-      .setBinding(0)
-      .setLocation(0)
-      .setFormat(::vk::Format::eR32G32Sfloat)
-      .setOffset(offsetof(Vertex, position));
-  attr_descs[1]
-      .setBinding(0)
-      .setLocation(1)
-      .setFormat(::vk::Format::eR32G32B32Sfloat)
-      .setOffset(offsetof(Vertex, color));
-
-  ::vk::VertexInputBindingDescription bind_desc;
-  bind_desc.setBinding(0)
-      .setInputRate(::vk::VertexInputRate::eVertex)
-      .setStride(sizeof(Vertex));
-
-  return ::std::make_pair(attr_descs, bind_desc);
+  return get_vertex_layout<&Vertex::position, &Vertex::color>();
 }
 
 auto TriangleApplication::record_command(::vk::CommandBuffer &cbuf,
@@ -185,8 +202,34 @@ auto TriangleApplication::record_command(::vk::CommandBuffer &cbuf,
 
   cbuf.bindVertexBuffers(0, this->device_buffers_[0], {0});
   cbuf.bindIndexBuffer(this->device_buffers_[1], 0, ::vk::IndexType::eUint16);
-  cbuf.bindDescriptorSets(::vk::PipelineBindPoint::eGraphics, this->layout_, 0,
-                          this->desc_sets_, {});
+  uint32_t offset = this->uniforms_.push(ebo);
+  ::vk::DescriptorBufferInfo buffer_info{this->uniforms_.get_buffer(), offset,
+                                         sizeof(MVP)};
+  switch (this->backend_) {
+  case DescriptorBackend::kPool:
+    cbuf.bindDescriptorSets(::vk::PipelineBindPoint::eGraphics, this->layout_,
+                            0, this->desc_sets_, offset);
+    break;
+  case DescriptorBackend::kPush: {
+    ::vk::WriteDescriptorSet write_set;
+    write_set.setDstBinding(0)
+        .setDescriptorType(::vk::DescriptorType::eUniformBuffer)
+        .setBufferInfo(buffer_info);
+    cbuf.pushDescriptorSetKHR(::vk::PipelineBindPoint::eGraphics,
+                              this->layout_, 0, write_set);
+    break;
+  }
+  case DescriptorBackend::kBuffer: {
+    this->descriptor_buffer_.begin_frame(this->current_frame_);
+    auto set = this->descriptor_buffer_.allocate(this->set_layout_);
+    this->descriptor_buffer_.write(set, this->set_layout_, 0,
+                                   ::vk::DescriptorType::eUniformBuffer,
+                                   buffer_info);
+    this->descriptor_buffer_.bind(cbuf, ::vk::PipelineBindPoint::eGraphics,
+                                  this->layout_, 0, {set});
+    break;
+  }
+  }
 
   auto time = ::std::chrono::duration_cast<::std::chrono::milliseconds>(
                   this->start_time_ - ::std::chrono::system_clock::now())
@@ -1,6 +1,7 @@
 #ifndef TRIANGLE_HPP_
 #define TRIANGLE_HPP_
 
+#include "descriptor_buffer.hpp"
 #include "renderer.hpp"
 
 #include <chrono>
@@ -23,9 +24,10 @@ private:
 
   ::std::chrono::time_point<::std::chrono::system_clock> start_time_{
       ::std::chrono::system_clock::now()};
+  DescriptorBackend backend_{DescriptorBackend::kPool};
+  DescriptorBuffer descriptor_buffer_;
   ::vk::DeviceMemory device_memory_{nullptr};
   ::vk::DescriptorSetLayout set_layout_{nullptr};
-  ::vk::DescriptorPool desc_pool_{nullptr};
 
   ::std::vector<::vk::Buffer> device_buffers_;
   ::std::vector<::vk::ShaderModule> shader_modules_;
@@ -1,5 +1,8 @@
-add_subdirs("test"
+add_subdirs("bench"
+            ,"test"
             ,"triangle"
             ,"canvas"
             ,"texture"
+            ,"sprite"
+            ,"mesh"
 )
@@ -0,0 +1,111 @@
+#include "atlas.hpp"
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "stb/stb_rect_pack.h"
+
+namespace {
+
+auto blit(Image const &image, int padding, stbrp_rect const &rect,
+          int page_width, unsigned char *page) -> void {
+  int width = image.get_width();
+  int height = image.get_height();
+  size_t texel = image.get_texel_size();
+  unsigned char const *src = image.get_data();
+  for (int y = 0; y < rect.h; ++y) {
+    unsigned char const *row =
+        src + ::std::clamp(y - padding, 0, height - 1) * width * texel;
+    unsigned char *dest = page + ((rect.y + y) * page_width + rect.x) * texel;
+    // left gutter, the row, right gutter
+    for (int x = 0; x < padding; ++x) {
+      ::memcpy(dest + x * texel, row, texel);
+    }
+    ::memcpy(dest + padding * texel, row, width * texel);
+    for (int x = padding + width; x < rect.w; ++x) {
+      ::memcpy(dest + x * texel, row + (width - 1) * texel, texel);
+    }
+  }
+}
+
+} // namespace
+
+auto create_atlas(::std::vector<Image> const &images, int width, int height,
+                  int padding)
+    -> ::std::pair<::std::vector<Image>, ::std::vector<AtlasRegion>> {
+  ::vk::Format format = images.empty() ? ::vk::Format::eR8G8B8A8Srgb
+                                       : images.front().get_format();
+  // rects are packed in blocks of the coarsest mip texel the padding
+  // protects, so those mips never average two rects into one texel
+  int block = 1 << (get_atlas_mip_levels(padding) - 1);
+  int grid_width = width / block;
+  int grid_height = height / block;
+  ::std::vector<stbrp_rect> pending;
+  pending.reserve(images.size());
+  for (int i = 0, end = static_cast<int>(images.size()); i < end; ++i) {
+    stbrp_rect rect{};
+    rect.id = i;
+    rect.w = (images[i].get_width() + padding * 2 + block - 1) / block;
+    rect.h = (images[i].get_height() + padding * 2 + block - 1) / block;
+    assert(rect.w <= grid_width && rect.h <= grid_height &&
+           "image is larger than the atlas page!");
+    assert(images[i].get_format() == format &&
+           "atlas images must share one format!");
+    pending.emplace_back(rect);
+  }
+
+  ::std::vector<Image> pages;
+  ::std::vector<AtlasRegion> regions(images.size());
+  ::std::vector<stbrp_node> nodes(static_cast<size_t>(grid_width));
+  while (!pending.empty()) {
+    stbrp_context context;
+    stbrp_init_target(&context, grid_width, grid_height, nodes.data(),
+                      static_cast<int>(nodes.size()));
+    stbrp_pack_rects(&context, pending.data(),
+                     static_cast<int>(pending.size()));
+    auto unpacked = ::std::stable_partition(
+        pending.begin(), pending.end(),
+        [](stbrp_rect const &rect) { return rect.was_packed != 0; });
+    assert(unpacked != pending.begin() && "atlas packing made no progress!");
+    for (auto it = pending.begin(); it != unpacked; ++it) {
+      it->x *= block;
+      it->y *= block;
+      it->w *= block;
+      it->h *= block;
+    }
+
+    int page_width{0};
+    int page_height{0};
+    for (auto it = pending.begin(); it != unpacked; ++it) {
+      page_width = ::std::max(page_width, it->x + it->w);
+      page_height = ::std::max(page_height, it->y + it->h);
+    }
+    Image page{page_width, page_height, format};
+    unsigned char *texels = page.get_mutable_data();
+    ::memset(texels, 0, page.get_size());
+    for (auto it = pending.begin(); it != unpacked; ++it) {
+      blit(images[it->id], padding, *it, page_width, texels);
+      auto const &image = images[it->id];
+      auto extent = ::glm::vec2{page_width, page_height};
+      auto &region = regions[it->id];
+      region.page = static_cast<uint32_t>(pages.size());
+      region.offset = ::glm::vec2{it->x + padding, it->y + padding} / extent;
+      region.scale =
+          ::glm::vec2{image.get_width(), image.get_height()} / extent;
+    }
+    pages.emplace_back(::std::move(page));
+    pending.erase(pending.begin(), unpacked);
+  }
+  return ::std::make_pair(::std::move(pages), ::std::move(regions));
+}
+
+auto get_atlas_mip_levels(int padding) -> int {
+  int levels{1};
+  for (int size = padding; size > 1; size >>= 1) {
+    ++levels;
+  }
+  return levels;
+}
@@ -1,66 +1,329 @@
 #include "base_type.hpp"
+#include "pixel_convert.hpp"
 #include "scope_guard.hpp"
 
+#include <math.h>
+#include <stdint.h>
 #include <string.h>
 
+#include <algorithm>
+#include <array>
+
+#include <glm/gtc/packing.hpp>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 
 namespace {
 
-auto copy_image_data(void const *src, int width, int height)
-    -> unsigned char * {
-  size_t size = width * height * 4;
-  auto *data = new unsigned char[size];
-  ::memcpy(data, src, size);
+auto allocate_image_data(size_t size) -> ::std::shared_ptr<unsigned char> {
+  return ::std::shared_ptr<unsigned char>{
+      new unsigned char[size], ::std::default_delete<unsigned char[]>{}};
+}
+
+auto copy_image_data(void const *src, size_t size)
+    -> ::std::shared_ptr<unsigned char> {
+  auto data = allocate_image_data(size);
+  ::memcpy(data.get(), src, size);
   return data;
 }
 
+auto get_image_format(int channels, bool srgb) -> ::vk::Format {
+  if (srgb) {
+    return ::vk::Format::eR8G8B8A8Srgb;
+  }
+  switch (channels) {
+  case 1:
+    return ::vk::Format::eR8Unorm;
+  case 2:
+    return ::vk::Format::eR8G8Unorm;
+  default:
+    return ::vk::Format::eR8G8B8A8Unorm;
+  }
+}
+
+auto is_srgb(::vk::Format format) -> bool {
+  return format == ::vk::Format::eR8Srgb || format == ::vk::Format::eR8G8Srgb ||
+         format == ::vk::Format::eR8G8B8A8Srgb;
+}
+
+auto srgb_to_linear_table() -> ::std::array<float, 256> const & {
+  static ::std::array<float, 256> const kTable = [] {
+    ::std::array<float, 256> table{};
+    for (size_t i = 0; i < table.size(); ++i) {
+      float c = static_cast<float>(i) / 255.f;
+      table[i] = c <= .04045f ? c / 12.92f : ::powf((c + .055f) / 1.055f, 2.4f);
+    }
+    return table;
+  }();
+  return kTable;
+}
+
+auto linear_to_srgb(float c) -> unsigned char {
+  c = c <= .0031308f ? c * 12.92f : 1.055f * ::powf(c, 1.f / 2.4f) - .055f;
+  return static_cast<unsigned char>(::std::clamp(c, 0.f, 1.f) * 255.f + .5f);
+}
+
+// texel <-> linear float, sRGB alpha of RGBA8 is stored linear
+auto decode_texel(unsigned char const *texel, ::vk::Format format, int channels,
+                  float *out) -> void {
+  if (format == ::vk::Format::eR16G16B16A16Sfloat) {
+    auto const *halves = reinterpret_cast<uint16_t const *>(texel);
+    for (int c = 0; c < channels; ++c) {
+      out[c] = ::glm::unpackHalf1x16(halves[c]);
+    }
+    return;
+  }
+  bool srgb = is_srgb(format);
+  for (int c = 0; c < channels; ++c) {
+    out[c] = srgb && c < 3 ? srgb_to_linear_table()[texel[c]]
+                           : static_cast<float>(texel[c]) / 255.f;
+  }
+}
+
+auto encode_texel(float const *in, ::vk::Format format, int channels,
+                  unsigned char *texel) -> void {
+  if (format == ::vk::Format::eR16G16B16A16Sfloat) {
+    auto *halves = reinterpret_cast<uint16_t *>(texel);
+    for (int c = 0; c < channels; ++c) {
+      halves[c] = ::glm::packHalf1x16(in[c]);
+    }
+    return;
+  }
+  bool srgb = is_srgb(format);
+  for (int c = 0; c < channels; ++c) {
+    texel[c] = srgb && c < 3 ? linear_to_srgb(in[c])
+                             : static_cast<unsigned char>(
+                                   ::std::clamp(in[c], 0.f, 1.f) * 255.f + .5f);
+  }
+}
+
+// level of count texels <-> linear RGBA32F, missing channels are left as is
+auto decode_level(unsigned char const *src, size_t count, ::vk::Format format,
+                  float *dest) -> void {
+  if (format == ::vk::Format::eR8G8B8A8Srgb) {
+    get_pixel_kernels().srgb_to_linear(src, dest, count);
+    return;
+  }
+  int channels = get_format_channels(format);
+  size_t texel = get_format_size(format);
+  for (size_t i = 0; i < count; ++i) {
+    decode_texel(src + i * texel, format, channels, dest + i * 4);
+  }
+}
+
+auto encode_level(float const *src, size_t count, ::vk::Format format,
+                  unsigned char *dest) -> void {
+  if (format == ::vk::Format::eR8G8B8A8Srgb) {
+    get_pixel_kernels().linear_to_srgb(src, dest, count);
+    return;
+  }
+  int channels = get_format_channels(format);
+  size_t texel = get_format_size(format);
+  for (size_t i = 0; i < count; ++i) {
+    encode_texel(src + i * 4, format, channels, dest + i * texel);
+  }
+}
+
+auto downsample(float const *src, int width, int height, float *dest) -> void {
+  int dest_width = ::std::max(width >> 1, 1);
+  int dest_height = ::std::max(height >> 1, 1);
+  for (int y = 0; y < dest_height; ++y) {
+    ::std::array<int, 2> rows{::std::min(y * 2, height - 1),
+                              ::std::min(y * 2 + 1, height - 1)};
+    for (int x = 0; x < dest_width; ++x) {
+      ::std::array<int, 2> columns{::std::min(x * 2, width - 1),
+                                   ::std::min(x * 2 + 1, width - 1)};
+      float *sum = dest + (static_cast<size_t>(y) * dest_width + x) * 4;
+      ::std::fill(sum, sum + 4, 0.f);
+      for (int row : rows) {
+        for (int column : columns) {
+          float const *value =
+              src + (static_cast<size_t>(row) * width + column) * 4;
+          for (int c = 0; c < 4; ++c) {
+            sum[c] += value[c] * .25f;
+          }
+        }
+      }
+    }
+  }
+}
+
 } // namespace
 
-Image::Image(::std::vector<unsigned char> const &image) {
-  stbi_uc *pixels =
-      stbi_load_from_memory(image.data(), image.size(), &this->width_,
-                            &this->height_, nullptr, STBI_rgb_alpha);
+Image::Image(::std::vector<unsigned char> const &image, int channels,
+             bool srgb) {
+  if (stbi_is_hdr_from_memory(image.data(), image.size())) {
+    float *pixels =
+        stbi_loadf_from_memory(image.data(), image.size(), &this->width_,
+                               &this->height_, nullptr, STBI_rgb_alpha);
+    assert(pixels && "failed to load texture image!");
+    MAKE_SCOPE_GUARD { stbi_image_free(pixels); };
+    this->format_ = ::vk::Format::eR16G16B16A16Sfloat;
+    size_t count = static_cast<size_t>(this->width_) * this->height_ * 4;
+    auto data = allocate_image_data(count * sizeof(uint16_t));
+    auto *halves = reinterpret_cast<uint16_t *>(data.get());
+    for (size_t i = 0; i < count; ++i) {
+      halves[i] = ::glm::packHalf1x16(pixels[i]);
+    }
+    this->data_ = ::std::move(data);
+    return;
+  }
+
+  int native{0};
+  stbi_info_from_memory(image.data(), image.size(), nullptr, nullptr, &native);
+  int wanted = channels == STBI_default ? native : channels;
+  if (srgb && wanted < STBI_rgb) {
+    // R8 and R8G8 sRGB are optional formats, stb widens grey to RGBA8
+    wanted = STBI_rgb_alpha;
+  }
+  stbi_uc *pixels = stbi_load_from_memory(image.data(), image.size(),
+                                          &this->width_, &this->height_,
+                                          nullptr, wanted);
   assert(pixels && "failed to load texture image!");
+  if (wanted != STBI_rgb) {
+    // adopt the decoder's buffer instead of copying it
+    this->format_ = get_image_format(wanted, srgb);
+    this->data_ = ::std::shared_ptr<unsigned char const>{pixels,
+                                                         stbi_image_free};
+    return;
+  }
   MAKE_SCOPE_GUARD { stbi_image_free(pixels); };
-  this->data_ = copy_image_data(pixels, this->width_, this->height_);
+  // RGB8 is rarely a sampled optimal-tiling format, widen it to RGBA8
+  this->format_ = get_image_format(STBI_rgb_alpha, srgb);
+  auto data = allocate_image_data(this->get_size());
+  get_pixel_kernels().rgb_to_rgba(
+      pixels, data.get(), static_cast<size_t>(this->width_) * this->height_);
+  this->data_ = ::std::move(data);
+}
+
+Image::Image(unsigned char const *image, int width, int height,
+             ::vk::Format format, int levels)
+    : width_{width}, height_{height}, levels_{levels}, format_{format} {
+  assert(get_format_size(format) != 0 && "unsupported image format!");
+  this->data_ = copy_image_data(image, this->get_size());
+}
+
+Image::Image(int width, int height, ::vk::Format format, int levels)
+    : width_{width}, height_{height}, levels_{levels}, format_{format} {
+  assert(get_format_size(format) != 0 && "unsupported image format!");
+  this->data_ = allocate_image_data(this->get_size());
+}
+
+Image::Image(::std::shared_ptr<unsigned char const> data, int width,
+             int height, ::vk::Format format, int levels, ImageStorage storage)
+    : data_{::std::move(data)}, storage_{storage}, width_{width},
+      height_{height}, levels_{levels}, format_{format} {
+  assert(get_format_size(format) != 0 && "unsupported image format!");
+  assert(this->data_ && "image data must not be null!");
 }
 
-Image::Image(unsigned char const *image, int width, int height)
-    : width_{width}, height_{height} {
-  this->data_ = copy_image_data(image, this->width_, this->height_);
+auto Image::borrow(unsigned char const *data, int width, int height,
+                   ::vk::Format format, int levels) -> Image {
+  // aliasing an empty owner gives a pointer that never deletes
+  return Image{::std::shared_ptr<unsigned char const>{
+                   ::std::shared_ptr<void>{}, data},
+               width,
+               height,
+               format,
+               levels,
+               ImageStorage::kBorrowed};
 }
 
-Image::Image(Image const &other)
-    : width_{other.width_}, height_{other.height_} {
-  this->data_ = copy_image_data(other.data_, this->width_, this->height_);
+auto Image::get_mutable_data() -> unsigned char * {
+  if (!this->data_) {
+    return nullptr;
+  }
+  // only a sole owner may write, anything else is copied first
+  if (this->storage_ != ImageStorage::kOwned ||
+      this->data_.use_count() != 1) {
+    this->data_ = copy_image_data(this->data_.get(), this->get_size());
+    this->storage_ = ImageStorage::kOwned;
+  }
+  return const_cast<unsigned char *>(this->data_.get());
+}
+
+auto Image::get_channels() const -> int {
+  return get_format_channels(this->format_);
+}
+
+auto Image::get_texel_size() const -> size_t {
+  return get_format_size(this->format_);
+}
+
+auto Image::get_size() const -> size_t {
+  return image_size(this->width_, this->height_, this->levels_,
+                    this->get_texel_size());
 }
 
-Image::Image(Image &&other) noexcept
-    : data_{other.data_}, width_{other.width_}, height_{other.height_} {
-  other.data_ = nullptr;
+auto Image::get_level_offset(int level) const -> size_t {
+  return image_size(this->width_, this->height_, level,
+                    this->get_texel_size());
 }
 
-auto Image::operator=(Image const &other) -> Image & {
-  if (this == &other) {
-    return *this;
+auto get_format_channels(::vk::Format format) -> int {
+  switch (format) {
+  case ::vk::Format::eR8Unorm:
+  case ::vk::Format::eR8Srgb:
+    return 1;
+  case ::vk::Format::eR8G8Unorm:
+  case ::vk::Format::eR8G8Srgb:
+    return 2;
+  case ::vk::Format::eR8G8B8A8Unorm:
+  case ::vk::Format::eR8G8B8A8Srgb:
+  case ::vk::Format::eR16G16B16A16Sfloat:
+    return 4;
+  default:
+    return 0;
   }
-  this->width_ = other.width_;
-  this->height_ = other.height_;
-  this->data_ = copy_image_data(other.data_, this->width_, this->height_);
-  return *this;
 }
 
-auto Image::operator=(Image &&other) noexcept -> Image & {
-  ::memcpy(this, &other, sizeof(Image));
-  other.data_ = nullptr;
-  return *this;
+auto get_format_size(::vk::Format format) -> size_t {
+  return format == ::vk::Format::eR16G16B16A16Sfloat
+             ? 8
+             : static_cast<size_t>(get_format_channels(format));
+}
+
+auto image_size(int width, int height, int levels, size_t texel) -> size_t {
+  size_t size{0};
+  for (int i = 0; i < levels; ++i) {
+    size += static_cast<size_t>(::std::max(width >> i, 1)) *
+            ::std::max(height >> i, 1) * texel;
+  }
+  return size;
+}
+
+auto get_mip_levels(int width, int height) -> int {
+  int levels{1};
+  for (int size = ::std::max(width, height); size > 1; size >>= 1) {
+    ++levels;
+  }
+  return levels;
 }
 
-Image::~Image() {
-  if (this->data_ != nullptr) {
-    delete[] this->data_;
-    this->data_ = nullptr;
+auto generate_mipmaps(Image const &image, int levels) -> Image {
+  int width = image.get_width();
+  int height = image.get_height();
+  int full = get_mip_levels(width, height);
+  levels = levels > 0 ? ::std::min(levels, full) : full;
+  ::vk::Format format = image.get_format();
+  size_t texel = image.get_texel_size();
+  Image mipmaps{width, height, format, levels};
+  unsigned char *chain = mipmaps.get_mutable_data();
+  ::memcpy(chain, image.get_data(), image_size(width, height, 1, texel));
+  // decode once, every level is filtered from the previous linear one
+  ::std::vector<float> linear(static_cast<size_t>(width) * height * 4);
+  ::std::vector<float> next(linear.size());
+  decode_level(image.get_data(), static_cast<size_t>(width) * height, format,
+               linear.data());
+  for (int i = 1; i < levels; ++i) {
+    downsample(linear.data(), ::std::max(width >> (i - 1), 1),
+               ::std::max(height >> (i - 1), 1), next.data());
+    linear.swap(next);
+    encode_level(linear.data(),
+                 static_cast<size_t>(::std::max(width >> i, 1)) *
+                     ::std::max(height >> i, 1),
+                 format, chain + image_size(width, height, i, texel));
   }
+  return mipmaps;
 }
@@ -0,0 +1,118 @@
+#include "bindless.hpp"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <array>
+
+namespace {
+
+uint32_t const kSamplerBinding{0};
+
+uint32_t const kImageBinding{1};
+
+} // namespace
+
+BindlessTable::BindlessTable(::vk::PhysicalDevice &physical,
+                             ::vk::Device &device, uint32_t max_images)
+    : device_{device} {
+  ::vk::PhysicalDeviceDescriptorIndexingProperties indexing;
+  ::vk::PhysicalDeviceProperties2 properties;
+  properties.setPNext(&indexing);
+  physical.getProperties2(&properties);
+  this->max_images_ = ::std::min(
+      {max_images, indexing.maxDescriptorSetUpdateAfterBindSampledImages,
+       indexing.maxPerStageDescriptorUpdateAfterBindSampledImages});
+
+  ::vk::DescriptorBindingFlags flags =
+      ::vk::DescriptorBindingFlagBits::ePartiallyBound |
+      ::vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+  ::std::array<::vk::DescriptorBindingFlags, 2> binding_flags{flags, flags};
+  ::std::array<::vk::DescriptorSetLayoutBinding, 2> bindings{
+      ::vk::DescriptorSetLayoutBinding{kSamplerBinding,
+                                       ::vk::DescriptorType::eSampler,
+                                       kSamplerCount,
+                                       ::vk::ShaderStageFlagBits::eAll},
+      ::vk::DescriptorSetLayoutBinding{kImageBinding,
+                                       ::vk::DescriptorType::eSampledImage,
+                                       this->max_images_,
+                                       ::vk::ShaderStageFlagBits::eAll},
+  };
+  ::vk::DescriptorSetLayoutBindingFlagsCreateInfo flags_info;
+  flags_info.setBindingFlags(binding_flags);
+  ::vk::DescriptorSetLayoutCreateInfo layout_info;
+  layout_info
+      .setFlags(::vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool)
+      .setBindings(bindings)
+      .setPNext(&flags_info);
+  this->layout_ = this->device_.createDescriptorSetLayout(layout_info);
+  assert(this->layout_ && "bindless descriptor set layout create failed!");
+
+  ::std::array<::vk::DescriptorPoolSize, 2> sizes{
+      ::vk::DescriptorPoolSize{::vk::DescriptorType::eSampler, kSamplerCount},
+      ::vk::DescriptorPoolSize{::vk::DescriptorType::eSampledImage,
+                               this->max_images_},
+  };
+  ::vk::DescriptorPoolCreateInfo pool_info;
+  pool_info.setFlags(::vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind)
+      .setMaxSets(1)
+      .setPoolSizes(sizes);
+  this->pool_ = this->device_.createDescriptorPool(pool_info);
+  assert(this->pool_ && "bindless descriptor pool create failed!");
+
+  ::vk::DescriptorSetAllocateInfo alloc_info;
+  alloc_info.setDescriptorPool(this->pool_).setSetLayouts(this->layout_);
+  this->set_ = this->device_.allocateDescriptorSets(alloc_info).front();
+}
+
+auto BindlessTable::add_image(::vk::ImageView view) -> uint32_t {
+  uint32_t index{this->image_count_};
+  if (!this->free_images_.empty()) {
+    index = this->free_images_.back();
+    this->free_images_.pop_back();
+  } else {
+    assert(this->image_count_ < this->max_images_ &&
+           "bindless image table is full!");
+    ++this->image_count_;
+  }
+  this->set_image(index, view);
+  return index;
+}
+
+auto BindlessTable::set_image(uint32_t index, ::vk::ImageView view) -> void {
+  ::vk::DescriptorImageInfo image_info{
+      nullptr, view, ::vk::ImageLayout::eShaderReadOnlyOptimal};
+  ::vk::WriteDescriptorSet write_set;
+  write_set.setDstSet(this->set_)
+      .setDstBinding(kImageBinding)
+      .setDstArrayElement(index)
+      .setDescriptorType(::vk::DescriptorType::eSampledImage)
+      .setImageInfo(image_info);
+  this->device_.updateDescriptorSets(write_set, {});
+}
+
+auto BindlessTable::remove_image(uint32_t index) -> void {
+  // partially bound, a stale descriptor is fine as long as nobody reads it
+  this->free_images_.emplace_back(index);
+}
+
+auto BindlessTable::add_sampler(::vk::Sampler sampler) -> uint32_t {
+  assert(this->sampler_count_ < kSamplerCount &&
+         "bindless sampler table is full!");
+  ::vk::DescriptorImageInfo image_info{sampler, nullptr,
+                                       ::vk::ImageLayout::eUndefined};
+  ::vk::WriteDescriptorSet write_set;
+  write_set.setDstSet(this->set_)
+      .setDstBinding(kSamplerBinding)
+      .setDstArrayElement(this->sampler_count_)
+      .setDescriptorType(::vk::DescriptorType::eSampler)
+      .setImageInfo(image_info);
+  this->device_.updateDescriptorSets(write_set, {});
+  return this->sampler_count_++;
+}
+
+auto BindlessTable::destroy() -> void {
+  // destroying the pool frees the set
+  this->device_.destroyDescriptorPool(this->pool_);
+  this->device_.destroyDescriptorSetLayout(this->layout_);
+}
@@ -1,13 +1,18 @@
 #include "create.hpp"
 #include "scope_guard.hpp"
+#include "vertex_layout.hpp"
 
 #include <assert.h>
+#include <stddef.h>
+#include <string.h>
 
 #include <algorithm>
+#include <array>
 #include <fstream>
 #include <initializer_list>
 #include <iterator>
 #include <limits>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -20,6 +25,64 @@
 #include <iostream>
 #endif
 
+// extension entry points are not exported by the loader, every vulkan-hpp call
+// goes through this dispatcher, loaded in create_instance/create_logic_device
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+namespace {
+
+uint32_t const kMaxApiVersion{
+#if defined(VK_API_VERSION_1_3)
+    VK_API_VERSION_1_3
+#elif defined(VK_API_VERSION_1_2)
+    VK_API_VERSION_1_2
+#elif defined(VK_API_VERSION_1_1)
+    VK_API_VERSION_1_1
+#else
+    VK_API_VERSION_1_0
+#endif
+};
+
+auto has_device_extension(::vk::PhysicalDevice &physical, char const *name)
+    -> bool {
+  auto extensions = physical.enumerateDeviceExtensionProperties();
+  return ::std::any_of(extensions.begin(), extensions.end(),
+                       [name](::vk::ExtensionProperties const &extension) {
+                         return ::strcmp(extension.extensionName, name) == 0;
+                       });
+}
+
+#ifdef VK_EXT_host_image_copy
+// the host path needs the format to allow host transfers and the usage to keep
+// optimal device access, otherwise the staging copy is the faster one
+auto prefers_host_image_copy(::vk::PhysicalDevice &physical,
+                             ::vk::Format format, ::vk::ImageUsageFlags usage)
+    -> bool {
+  ::vk::FormatProperties3 format_properties3;
+  ::vk::FormatProperties2 format_properties;
+  format_properties.setPNext(&format_properties3);
+  physical.getFormatProperties2(format, &format_properties);
+  if (!(format_properties3.optimalTilingFeatures &
+        ::vk::FormatFeatureFlagBits2::eHostImageTransferEXT)) {
+    return false;
+  }
+
+  ::vk::PhysicalDeviceImageFormatInfo2 info;
+  info.setFormat(format)
+      .setType(::vk::ImageType::e2D)
+      .setTiling(::vk::ImageTiling::eOptimal)
+      .setUsage(usage | ::vk::ImageUsageFlagBits::eHostTransferEXT);
+  ::vk::HostImageCopyDevicePerformanceQueryEXT performance;
+  ::vk::ImageFormatProperties2 image_properties;
+  image_properties.setPNext(&performance);
+  return physical.getImageFormatProperties2(&info, &image_properties) ==
+             ::vk::Result::eSuccess &&
+         performance.optimalDeviceAccess;
+}
+#endif
+
+} // namespace
+
 auto create_instance(Window &window,
                      ::std::vector<char const *> const &app_extensions)
     -> ::vk::Instance {
@@ -40,18 +103,16 @@ auto create_instance(Window &window,
 #endif
   };
 
+  VULKAN_HPP_DEFAULT_DISPATCHER.init(
+      reinterpret_cast<PFN_vkGetInstanceProcAddr>(
+          SDL_Vulkan_GetVkGetInstanceProcAddr()));
+  // a 1.0 loader has no vkEnumerateInstanceVersion
+  uint32_t version{VK_API_VERSION_1_0};
+  if (VULKAN_HPP_DEFAULT_DISPATCHER.vkEnumerateInstanceVersion != nullptr) {
+    version = ::vk::enumerateInstanceVersion();
+  }
   ::vk::ApplicationInfo app_info;
-  app_info.setApplicationVersion(
-#if defined(VK_API_VERSION_1_3)
-      VK_API_VERSION_1_3
-#elif defined(VK_API_VERSION_1_2)
-      VK_API_VERSION_1_2
-#elif defined(VK_API_VERSION_1_1)
-      VK_API_VERSION_1_1
-#else
-      VK_API_VERSION_1_0
-#endif
-  );
+  app_info.setApiVersion(::std::min(version, kMaxApiVersion));
 
   ::vk::InstanceCreateInfo info;
   info.setPApplicationInfo(&app_info)
@@ -60,6 +121,7 @@ auto create_instance(Window &window,
 
   ::vk::Instance instance = vk::createInstance(info);
   assert(instance && "instance create failed!");
+  VULKAN_HPP_DEFAULT_DISPATCHER.init(instance);
   return instance;
 }
 
@@ -111,8 +173,107 @@ auto pickup_queue_family(::vk::PhysicalDevice &device,
   return indices;
 }
 
+auto query_device_features(::vk::PhysicalDevice &physical) -> DeviceFeatures {
+  DeviceFeatures features;
+  [[maybe_unused]] auto properties = physical.getProperties();
+  auto core_features = physical.getFeatures();
+  features.multi_draw_indirect = core_features.multiDrawIndirect &&
+                                 core_features.drawIndirectFirstInstance;
+
+#ifdef VK_API_VERSION_1_1
+  features.update_template = properties.apiVersion >= VK_API_VERSION_1_1;
+#endif
+
+#ifdef VK_API_VERSION_1_2
+  if (properties.apiVersion >= VK_API_VERSION_1_2) {
+    ::vk::PhysicalDeviceVulkan12Features vulkan12;
+    ::vk::PhysicalDeviceFeatures2 features2;
+    features2.setPNext(&vulkan12);
+    physical.getFeatures2(&features2);
+    features.timeline_semaphore = vulkan12.timelineSemaphore != VK_FALSE;
+    features.descriptor_indexing =
+        vulkan12.runtimeDescriptorArray &&
+        vulkan12.descriptorBindingPartiallyBound &&
+        vulkan12.descriptorBindingSampledImageUpdateAfterBind &&
+        vulkan12.shaderSampledImageArrayNonUniformIndexing;
+    features.draw_indirect_count = vulkan12.drawIndirectCount != VK_FALSE;
+  }
+#endif
+
+#ifdef VK_EXT_host_image_copy
+  // 1.3 core covers the extension's dependencies, textures are sampled in
+  // eShaderReadOnlyOptimal, so it has to be a valid copy destination
+  if (properties.apiVersion >= VK_API_VERSION_1_3 &&
+      has_device_extension(physical, VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME)) {
+    ::vk::PhysicalDeviceHostImageCopyFeaturesEXT host_image_copy;
+    ::vk::PhysicalDeviceFeatures2 features2;
+    features2.setPNext(&host_image_copy);
+    physical.getFeatures2(&features2);
+
+    ::vk::PhysicalDeviceHostImageCopyPropertiesEXT copy_properties;
+    ::vk::PhysicalDeviceProperties2 properties2;
+    properties2.setPNext(&copy_properties);
+    physical.getProperties2(&properties2);
+    ::std::vector<::vk::ImageLayout> layouts(
+        copy_properties.copyDstLayoutCount);
+    copy_properties.setPCopyDstLayouts(layouts.data());
+    physical.getProperties2(&properties2);
+
+    features.host_image_copy =
+        host_image_copy.hostImageCopy &&
+        ::std::find(layouts.begin(), layouts.end(),
+                    ::vk::ImageLayout::eShaderReadOnlyOptimal) !=
+            layouts.end();
+  }
+#endif
+
+#ifdef VK_EXT_descriptor_buffer
+  // descriptors are located by buffer device address, a 1.2 feature
+  if (properties.apiVersion >= VK_API_VERSION_1_2 &&
+      has_device_extension(physical,
+                           VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME)) {
+    ::vk::PhysicalDeviceDescriptorBufferFeaturesEXT descriptor_buffer;
+    ::vk::PhysicalDeviceVulkan12Features vulkan12;
+    descriptor_buffer.setPNext(&vulkan12);
+    ::vk::PhysicalDeviceFeatures2 features2;
+    features2.setPNext(&descriptor_buffer);
+    physical.getFeatures2(&features2);
+    features.descriptor_buffer =
+        descriptor_buffer.descriptorBuffer && vulkan12.bufferDeviceAddress;
+  }
+#endif
+
+#ifdef VK_KHR_push_descriptor
+  features.push_descriptor =
+      has_device_extension(physical, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+#endif
+
+#ifdef DEBUG
+  ::std::clog << "Device Features:" << ::std::endl;
+  ::std::clog << "\thost image copy: " << features.host_image_copy
+              << ::std::endl;
+  ::std::clog << "\ttimeline semaphore: " << features.timeline_semaphore
+              << ::std::endl;
+  ::std::clog << "\tdescriptor indexing: " << features.descriptor_indexing
+              << ::std::endl;
+  ::std::clog << "\tupdate template: " << features.update_template
+              << ::std::endl;
+  ::std::clog << "\tpush descriptor: " << features.push_descriptor
+              << ::std::endl;
+  ::std::clog << "\tdescriptor buffer: " << features.descriptor_buffer
+              << ::std::endl;
+  ::std::clog << "\tmulti draw indirect: " << features.multi_draw_indirect
+              << ::std::endl;
+  ::std::clog << "\tdraw indirect count: " << features.draw_indirect_count
+              << ::std::endl;
+  ::std::clog << ::std::endl;
+#endif
+  return features;
+}
+
 auto create_logic_device(::vk::PhysicalDevice &physical,
                          QueueFamilyIndices &queue_indices,
+                         DeviceFeatures const &features,
                          ::std::vector<char const *> const &app_extensions)
     -> ::vk::Device {
   ::std::vector<::vk::DeviceQueueCreateInfo> queue_infos;
@@ -130,6 +291,49 @@ auto create_logic_device(::vk::PhysicalDevice &physical,
   ::std::vector<char const *> extensions;
   extensions.insert(extensions.end(), app_extensions.begin(),
                     app_extensions.end());
+
+  // feature structs of enabled extensions, chained into the create info
+  void *next{nullptr};
+#ifdef VK_API_VERSION_1_2
+  // promoted 1.2 features must all be enabled through this one struct
+  ::vk::PhysicalDeviceVulkan12Features vulkan12;
+  vulkan12.setTimelineSemaphore(features.timeline_semaphore);
+  if (features.descriptor_indexing) {
+    vulkan12.setRuntimeDescriptorArray(VK_TRUE)
+        .setDescriptorBindingPartiallyBound(VK_TRUE)
+        .setDescriptorBindingSampledImageUpdateAfterBind(VK_TRUE)
+        .setShaderSampledImageArrayNonUniformIndexing(VK_TRUE);
+  }
+  vulkan12.setBufferDeviceAddress(features.descriptor_buffer);
+  vulkan12.setDrawIndirectCount(features.draw_indirect_count);
+  if (features.timeline_semaphore || features.descriptor_indexing ||
+      features.descriptor_buffer || features.draw_indirect_count) {
+    vulkan12.setPNext(next);
+    next = &vulkan12;
+  }
+#endif
+#ifdef VK_EXT_host_image_copy
+  ::vk::PhysicalDeviceHostImageCopyFeaturesEXT host_image_copy;
+  if (features.host_image_copy) {
+    host_image_copy.setHostImageCopy(VK_TRUE).setPNext(next);
+    next = &host_image_copy;
+    extensions.emplace_back(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME);
+  }
+#endif
+#ifdef VK_EXT_descriptor_buffer
+  ::vk::PhysicalDeviceDescriptorBufferFeaturesEXT descriptor_buffer;
+  if (features.descriptor_buffer) {
+    descriptor_buffer.setDescriptorBuffer(VK_TRUE).setPNext(next);
+    next = &descriptor_buffer;
+    extensions.emplace_back(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME);
+  }
+#endif
+#ifdef VK_KHR_push_descriptor
+  if (features.push_descriptor) {
+    extensions.emplace_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+  }
+#endif
+
 #ifdef DEBUG
   ::std::clog << "Enabled Device Extensions:" << ::std::endl;
   for (auto const &ext : extensions) {
@@ -138,12 +342,20 @@ auto create_logic_device(::vk::PhysicalDevice &physical,
   ::std::clog << ::std::endl;
 #endif
 
+  ::vk::PhysicalDeviceFeatures core_features;
+  core_features.setMultiDrawIndirect(features.multi_draw_indirect)
+      .setDrawIndirectFirstInstance(features.multi_draw_indirect);
+
   ::vk::DeviceCreateInfo info;
 
-  info.setQueueCreateInfos(queue_infos).setPEnabledExtensionNames(extensions);
+  info.setQueueCreateInfos(queue_infos)
+      .setPEnabledExtensionNames(extensions)
+      .setPEnabledFeatures(&core_features)
+      .setPNext(next);
 
   ::vk::Device device = physical.createDevice(info);
   assert(device && "logic device create failed!");
+  VULKAN_HPP_DEFAULT_DISPATCHER.init(device);
   return device;
 }
 
@@ -225,7 +437,9 @@ auto query_swapchain_required_info(SDL_Window *window,
 }
 
 auto create_image_view(::vk::Device &device, ::vk::Image &image,
-                       ::vk::Format const &format) -> ::vk::ImageView {
+                       ::vk::Format const &format, uint32_t levels,
+                       ::vk::ImageAspectFlags aspect, uint32_t base_level)
+    -> ::vk::ImageView {
   ::vk::ImageViewCreateInfo info;
   info.setViewType(::vk::ImageViewType::e2D)
       .setFormat(format)
@@ -233,8 +447,8 @@ auto create_image_view(::vk::Device &device, ::vk::Image &image,
           ::vk::ComponentSwizzle::eIdentity, ::vk::ComponentSwizzle::eIdentity,
           ::vk::ComponentSwizzle::eIdentity, ::vk::ComponentSwizzle::eIdentity})
       .setImage(image)
-      .setSubresourceRange(::vk::ImageSubresourceRange{
-          ::vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+      .setSubresourceRange(
+          ::vk::ImageSubresourceRange{aspect, base_level, levels, 0, 1});
 
   ::vk::ImageView view = device.createImageView(info);
   assert(view && "image view create failed!");
@@ -243,12 +457,12 @@ auto create_image_view(::vk::Device &device, ::vk::Image &image,
 
 auto create_image_views(::vk::Device &device,
                         ::std::vector<::vk::Image> &images,
-                        ::vk::Format const &format)
+                        ::vk::Format const &format, uint32_t levels)
     -> ::std::vector<::vk::ImageView> {
   ::std::vector<::vk::ImageView> views;
   views.reserve(images.size());
   for (auto &image : images) {
-    views.emplace_back(create_image_view(device, image, format));
+    views.emplace_back(create_image_view(device, image, format, levels));
   }
   return views;
 }
@@ -256,22 +470,95 @@ auto create_image_views(::vk::Device &device,
 auto create_frame_buffers(::vk::Device &device,
                           ::std::vector<::vk::ImageView> &views,
                           ::vk::RenderPass &render_pass,
-                          SwapchainRequiredInfo &required_info)
+                          SwapchainRequiredInfo &required_info,
+                          ::std::vector<::vk::ImageView> const &depth_views)
     -> ::std::vector<::vk::Framebuffer> {
+  assert((depth_views.empty() || depth_views.size() == views.size()) &&
+         "frame buffers create failed!");
   ::std::vector<::vk::Framebuffer> buffers;
   ::vk::FramebufferCreateInfo info;
   info.setRenderPass(render_pass)
       .setLayers(1)
       .setWidth(required_info.extent.width)
       .setHeight(required_info.extent.height);
-  for (auto &view : views) {
-    info.setAttachments(view);
+  for (size_t i = 0; i < views.size(); ++i) {
+    ::std::vector attachments{views[i]};
+    if (!depth_views.empty()) {
+      attachments.push_back(depth_views[i]);
+    }
+    info.setAttachments(attachments);
     buffers.emplace_back(device.createFramebuffer(info));
     assert(buffers.back() && "frame buffers create failed!");
   }
   return buffers;
 }
 
+auto pickup_depth_format(::vk::PhysicalDevice &physical,
+                         ::vk::ImageUsageFlags usage) -> ::vk::Format {
+  ::vk::FormatFeatureFlags required{
+      ::vk::FormatFeatureFlagBits::eDepthStencilAttachment};
+  if (usage & ::vk::ImageUsageFlagBits::eSampled) {
+    required |= ::vk::FormatFeatureFlagBits::eSampledImage;
+  }
+  // D16 is required to be a sampled depth attachment, the search always ends
+  // there
+  for (auto format : {::vk::Format::eD32Sfloat, ::vk::Format::eD32SfloatS8Uint,
+                      ::vk::Format::eD24UnormS8Uint,
+                      ::vk::Format::eX8D24UnormPack32,
+                      ::vk::Format::eD16Unorm}) {
+    auto properties = physical.getFormatProperties(format);
+    if ((properties.optimalTilingFeatures & required) == required) {
+      return format;
+    }
+  }
+  assert(false && "pickup depth format failed!");
+  return ::vk::Format::eUndefined;
+}
+
+auto create_depth_image(::vk::PhysicalDevice &physical, ::vk::Device &device,
+                        ::vk::Format format, ::vk::Extent2D const &extent,
+                        ::vk::ImageUsageFlags usage)
+    -> ::std::tuple<::vk::Image, ::vk::DeviceMemory, ::vk::ImageView> {
+  bool transient = !usage;
+  if (transient) {
+    usage = ::vk::ImageUsageFlagBits::eTransientAttachment;
+  }
+  auto image = create_image(
+      device, extent.width, extent.height,
+      ::vk::ImageUsageFlagBits::eDepthStencilAttachment | usage, 1, format);
+
+  // lazily allocated types are device local as well, prefer them
+  auto requirement = device.getImageMemoryRequirements(image);
+  auto property = physical.getMemoryProperties();
+  ::vk::MemoryPropertyFlags flag{::vk::MemoryPropertyFlagBits::eDeviceLocal};
+  for (decltype(property.memoryTypeCount) i = 0;
+       transient && i < property.memoryTypeCount; ++i) {
+    if (((requirement.memoryTypeBits & (1 << i)) != 0u) &&
+        (property.memoryTypes[i].propertyFlags &
+         ::vk::MemoryPropertyFlagBits::eLazilyAllocated)) {
+      flag = ::vk::MemoryPropertyFlagBits::eLazilyAllocated;
+      break;
+    }
+  }
+  auto memory = allocate_memory(physical, device, image, flag);
+  auto view = create_image_view(device, image, format, 1,
+                                ::vk::ImageAspectFlagBits::eDepth);
+  return ::std::make_tuple(image, memory, view);
+}
+
+auto get_depth_attachment(::vk::Format format) -> ::vk::AttachmentDescription {
+  ::vk::AttachmentDescription att_desc;
+  att_desc.setSamples(::vk::SampleCountFlagBits::e1)
+      .setLoadOp(::vk::AttachmentLoadOp::eClear)
+      .setStoreOp(::vk::AttachmentStoreOp::eDontCare)
+      .setStencilLoadOp(::vk::AttachmentLoadOp::eDontCare)
+      .setStencilStoreOp(::vk::AttachmentStoreOp::eDontCare)
+      .setFormat(format)
+      .setInitialLayout(::vk::ImageLayout::eUndefined)
+      .setFinalLayout(::vk::ImageLayout::eDepthStencilAttachmentOptimal);
+  return att_desc;
+}
+
 auto create_command_pool(::vk::Device &device,
                          QueueFamilyIndices &queue_indices)
     -> ::vk::CommandPool {
@@ -309,13 +596,14 @@ auto create_buffer(::vk::Device &device, QueueFamilyIndices &indices,
 }
 
 auto create_image(::vk::Device &device, uint32_t width, uint32_t height,
-                  ::vk::ImageUsageFlags flag) -> ::vk::Image {
+                  ::vk::ImageUsageFlags flag, uint32_t levels,
+                  ::vk::Format format) -> ::vk::Image {
   ::vk::ImageCreateInfo info;
   info.setImageType(::vk::ImageType::e2D)
       .setExtent(::vk::Extent3D{width, height, 1})
-      .setMipLevels(1)
+      .setMipLevels(levels)
       .setArrayLayers(1)
-      .setFormat(::vk::Format::eR8G8B8A8Srgb)
+      .setFormat(format)
       .setTiling(::vk::ImageTiling::eOptimal)
       .setInitialLayout(::vk::ImageLayout::eUndefined)
       .setUsage(flag)
@@ -343,24 +631,13 @@ auto create_shader_module(::vk::Device &device,
   return shader_module;
 }
 
-auto create_image_data(::std::filesystem::path const &filename) -> Image {
+auto create_image_data(::std::filesystem::path const &filename, int channels,
+                       bool srgb) -> Image {
   ::std::ifstream ifs{filename, ::std::ios::binary | ::std::ios::in};
   ::std::vector<unsigned char> content{(::std::istreambuf_iterator<char>(ifs)),
                                        ::std::istreambuf_iterator<char>()};
   ifs.close();
-  return Image{content};
-}
-
-auto create_descriptor_pool(::vk::Device &device, size_t max_size,
-                            ::vk::DescriptorType type) -> ::vk::DescriptorPool {
-  ::vk::DescriptorPoolSize size{type, static_cast<uint32_t>(max_size)};
-  ::vk::DescriptorPoolCreateInfo info;
-  info.setPoolSizes(size)
-      .setMaxSets(::std::numeric_limits<uint16_t>::max())
-      .setFlags(::vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
-  auto pool = device.createDescriptorPool(info);
-  assert(pool && "descriptor pool create failed!");
-  return pool;
+  return Image{content, channels, srgb};
 }
 
 auto create_texture_sampler(::vk::PhysicalDevice &physical,
@@ -381,7 +658,7 @@ auto create_texture_sampler(::vk::PhysicalDevice &physical,
       .setMipmapMode(::vk::SamplerMipmapMode::eLinear)
       .setMipLodBias(.0f)
       .setMinLod(.0f)
-      .setMaxLod(.0f);
+      .setMaxLod(VK_LOD_CLAMP_NONE);
 
   ::vk::Sampler sampler = device.createSampler(info);
   assert(sampler && "sampler create failed!");
@@ -413,10 +690,7 @@ auto create_fences(::vk::Device &device, size_t size)
 auto copy_data(::vk::Device &device, ::vk::DeviceMemory &memory, size_t offset,
                size_t size, void const *data) -> void {
   void *buffer = device.mapMemory(memory, offset, size);
-  MAKE_SCOPE_GUARD {
-    device.unmapMemory(memory);
-    device.waitIdle();
-  };
+  MAKE_SCOPE_GUARD { device.unmapMemory(memory); };
   ::memcpy(buffer, data, size);
 }
 
@@ -437,14 +711,14 @@ auto copy_buffer(::vk::Device &device, ::vk::CommandPool &pool,
   device.waitIdle();
 }
 
-auto copy_image(::vk::Device &device, ::vk::CommandPool &pool,
-                ::vk::Queue &queue, ::vk::Buffer const &src,
-                ::vk::Image const &dest, uint32_t width, uint32_t height)
+auto record_copy_image(::vk::CommandBuffer &cmd_buffer, ::vk::Buffer const &src,
+                       ::vk::Image const &dest, uint32_t width,
+                       uint32_t height, uint32_t levels, ::vk::Format format)
     -> void {
   ::vk::ImageSubresourceRange range;
   range.setAspectMask(::vk::ImageAspectFlagBits::eColor)
       .setBaseMipLevel(0)
-      .setLevelCount(1)
+      .setLevelCount(levels)
       .setBaseArrayLayer(0)
       .setLayerCount(1);
   ::vk::ImageMemoryBarrier barrier;
@@ -453,43 +727,64 @@ auto copy_image(::vk::Device &device, ::vk::CommandPool &pool,
       .setImage(dest)
       .setSubresourceRange(range);
 
-  auto transfer_cmd_buffers = allocate_command_buffers(device, pool, 1);
-  ::vk::CommandBufferBeginInfo begin_info;
-  begin_info.setFlags(::vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-  MAKE_SCOPE_GUARD { device.freeCommandBuffers(pool, transfer_cmd_buffers); };
-  transfer_cmd_buffers.front().begin(begin_info);
-
   barrier.setOldLayout(::vk::ImageLayout::eUndefined)
       .setNewLayout(::vk::ImageLayout::eTransferDstOptimal)
       .setSrcAccessMask(::vk::AccessFlagBits::eNone)
       .setDstAccessMask(::vk::AccessFlagBits::eTransferWrite);
-  transfer_cmd_buffers.front().pipelineBarrier(
-      ::vk::PipelineStageFlagBits::eTopOfPipe,
-      ::vk::PipelineStageFlagBits::eTransfer,
-      ::vk::DependencyFlagBits::eByRegion, 0, nullptr, 0, nullptr, 1, &barrier);
-  ::vk::ImageSubresourceLayers layer;
-  layer.setAspectMask(::vk::ImageAspectFlagBits::eColor)
-      .setMipLevel(0)
-      .setBaseArrayLayer(0)
-      .setLayerCount(1);
-  ::vk::BufferImageCopy region;
-  region.setBufferOffset(0)
-      .setBufferRowLength(0)
-      .setBufferImageHeight(0)
-      .setImageSubresource(layer)
-      .setImageOffset(::vk::Offset3D{0, 0, 0})
-      .setImageExtent(::vk::Extent3D{width, height, 1});
-  transfer_cmd_buffers.front().copyBufferToImage(
-      src, dest, ::vk::ImageLayout::eTransferDstOptimal, region);
+  cmd_buffer.pipelineBarrier(::vk::PipelineStageFlagBits::eTopOfPipe,
+                             ::vk::PipelineStageFlagBits::eTransfer,
+                             ::vk::DependencyFlagBits::eByRegion, 0, nullptr,
+                             0, nullptr, 1, &barrier);
+  // mip levels are tightly packed one after another in the staging buffer
+  // parentheses, braces would make one region with bufferOffset = levels
+  ::std::vector<::vk::BufferImageCopy> regions(levels);
+  ::vk::DeviceSize texel = get_format_size(format);
+  ::vk::DeviceSize offset{0};
+  for (uint32_t i = 0; i < levels; ++i) {
+    uint32_t level_width = ::std::max(width >> i, 1u);
+    uint32_t level_height = ::std::max(height >> i, 1u);
+    assert(offset == image_size(static_cast<int>(width),
+                                static_cast<int>(height), static_cast<int>(i),
+                                texel) &&
+           "mip level offset mismatch!");
+    ::vk::ImageSubresourceLayers layer;
+    layer.setAspectMask(::vk::ImageAspectFlagBits::eColor)
+        .setMipLevel(i)
+        .setBaseArrayLayer(0)
+        .setLayerCount(1);
+    regions[i]
+        .setBufferOffset(offset)
+        .setBufferRowLength(0)
+        .setBufferImageHeight(0)
+        .setImageSubresource(layer)
+        .setImageOffset(::vk::Offset3D{0, 0, 0})
+        .setImageExtent(::vk::Extent3D{level_width, level_height, 1});
+    offset += texel * level_width * level_height;
+  }
+  assert(regions.size() == levels && "mip level region count mismatch!");
+  cmd_buffer.copyBufferToImage(
+      src, dest, ::vk::ImageLayout::eTransferDstOptimal, regions);
   barrier.setOldLayout(::vk::ImageLayout::eTransferDstOptimal)
-      .setNewLayout(::vk::ImageLayout::eReadOnlyOptimal)
+      .setNewLayout(::vk::ImageLayout::eShaderReadOnlyOptimal)
       .setSrcAccessMask(::vk::AccessFlagBits::eTransferWrite)
       .setDstAccessMask(::vk::AccessFlagBits::eShaderRead);
-  transfer_cmd_buffers.front().pipelineBarrier(
-      ::vk::PipelineStageFlagBits::eTransfer,
-      ::vk::PipelineStageFlagBits::eFragmentShader,
-      ::vk::DependencyFlagBits::eByRegion, 0, nullptr, 0, nullptr, 1, &barrier);
+  cmd_buffer.pipelineBarrier(::vk::PipelineStageFlagBits::eTransfer,
+                             ::vk::PipelineStageFlagBits::eFragmentShader,
+                             ::vk::DependencyFlagBits::eByRegion, 0, nullptr,
+                             0, nullptr, 1, &barrier);
+}
 
+auto copy_image(::vk::Device &device, ::vk::CommandPool &pool,
+                ::vk::Queue &queue, ::vk::Buffer const &src,
+                ::vk::Image const &dest, uint32_t width, uint32_t height,
+                uint32_t levels, ::vk::Format format) -> void {
+  auto transfer_cmd_buffers = allocate_command_buffers(device, pool, 1);
+  ::vk::CommandBufferBeginInfo begin_info;
+  begin_info.setFlags(::vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+  MAKE_SCOPE_GUARD { device.freeCommandBuffers(pool, transfer_cmd_buffers); };
+  transfer_cmd_buffers.front().begin(begin_info);
+  record_copy_image(transfer_cmd_buffers.front(), src, dest, width, height,
+                    levels, format);
   transfer_cmd_buffers.front().end();
   ::vk::SubmitInfo submit_info;
   submit_info.setCommandBuffers(transfer_cmd_buffers);
@@ -497,11 +792,72 @@ auto copy_image(::vk::Device &device, ::vk::CommandPool &pool,
   device.waitIdle();
 }
 
+auto copy_image([[maybe_unused]] ::vk::Device &device,
+                [[maybe_unused]] Image const &src,
+                [[maybe_unused]] ::vk::Image const &dest) -> void {
+#ifdef VK_EXT_host_image_copy
+  auto levels = static_cast<uint32_t>(src.get_levels());
+  ::vk::ImageSubresourceRange range;
+  range.setAspectMask(::vk::ImageAspectFlagBits::eColor)
+      .setBaseMipLevel(0)
+      .setLevelCount(levels)
+      .setBaseArrayLayer(0)
+      .setLayerCount(1);
+  // the image is written in the layout it is sampled in, one host transition
+  ::vk::HostImageLayoutTransitionInfoEXT transition;
+  transition.setImage(dest)
+      .setOldLayout(::vk::ImageLayout::eUndefined)
+      .setNewLayout(::vk::ImageLayout::eShaderReadOnlyOptimal)
+      .setSubresourceRange(range);
+  device.transitionImageLayoutEXT(transition);
+
+  ::std::vector<::vk::MemoryToImageCopyEXT> regions(levels);
+  for (uint32_t i = 0; i < levels; ++i) {
+    ::vk::ImageSubresourceLayers layer;
+    layer.setAspectMask(::vk::ImageAspectFlagBits::eColor)
+        .setMipLevel(i)
+        .setBaseArrayLayer(0)
+        .setLayerCount(1);
+    regions[i]
+        .setPHostPointer(src.get_data() +
+                         src.get_level_offset(static_cast<int>(i)))
+        .setMemoryRowLength(0)
+        .setMemoryImageHeight(0)
+        .setImageSubresource(layer)
+        .setImageOffset(::vk::Offset3D{0, 0, 0})
+        .setImageExtent(::vk::Extent3D{
+            static_cast<uint32_t>(::std::max(src.get_width() >> i, 1)),
+            static_cast<uint32_t>(::std::max(src.get_height() >> i, 1)), 1});
+  }
+  ::vk::CopyMemoryToImageInfoEXT info;
+  info.setDstImage(dest)
+      .setDstImageLayout(::vk::ImageLayout::eShaderReadOnlyOptimal)
+      .setRegions(regions);
+  assert(regions.size() == levels && "mip level region count mismatch!");
+  device.copyMemoryToImageEXT(info);
+#else
+  assert(false && "host image copy is not supported by the vulkan headers!");
+#endif
+}
+
 auto wrap_image(::vk::PhysicalDevice &physical, ::vk::Device &device,
                 QueueFamilyIndices &indices, Image const &image,
-                ::vk::ImageUsageFlags flag)
-    -> ::std::tuple<::vk::Buffer, ::vk::DeviceMemory, ::vk::Image, uint32_t,
-                    uint32_t> {
+                ::vk::ImageUsageFlags flag,
+                [[maybe_unused]] DeviceFeatures const &features)
+    -> ::std::tuple<::vk::Buffer, ::vk::DeviceMemory, ::vk::Image, Image> {
+#ifdef VK_EXT_host_image_copy
+  if (features.host_image_copy &&
+      prefers_host_image_copy(physical, image.get_format(), flag)) {
+    ::vk::Image device_buffer =
+        create_image(device, image.get_width(), image.get_height(),
+                     ::vk::ImageUsageFlagBits::eHostTransferEXT | flag,
+                     image.get_levels(), image.get_format());
+    return ::std::make_tuple(::vk::Buffer{nullptr},
+                             ::vk::DeviceMemory{nullptr}, device_buffer,
+                             image);
+  }
+#endif
+
   ::vk::DeviceSize size = image.get_size();
   ::vk::Buffer host_buffer = create_buffer(
       device, indices, size, ::vk::BufferUsageFlagBits::eTransferSrc);
@@ -512,7 +868,34 @@ auto wrap_image(::vk::PhysicalDevice &physical, ::vk::Device &device,
   copy_data(device, host_memory, 0, size, image.get_data());
   ::vk::Image device_buffer =
       create_image(device, image.get_width(), image.get_height(),
-                   ::vk::ImageUsageFlagBits::eTransferDst | flag);
-  return ::std::make_tuple(host_buffer, host_memory, device_buffer,
-                           image.get_width(), image.get_height());
+                   ::vk::ImageUsageFlagBits::eTransferDst | flag,
+                   image.get_levels(), image.get_format());
+  return ::std::make_tuple(host_buffer, host_memory, device_buffer, image);
+}
+
+auto get_instance_input_description(uint32_t binding, uint32_t first_location)
+    -> ::std::pair<::std::array<::vk::VertexInputAttributeDescription, 6>,
+                   ::vk::VertexInputBindingDescription> {
+  return get_vertex_layout<&Instance::model, &Instance::region,
+                           &Instance::texture_index>(
+      binding, first_location, ::vk::VertexInputRate::eInstance);
+}
+
+auto create_update_template(
+    ::vk::Device &device, ::vk::DescriptorSetLayout layout,
+    ::std::vector<::vk::DescriptorUpdateTemplateEntry> const &entries)
+    -> ::vk::DescriptorUpdateTemplate {
+  ::vk::DescriptorUpdateTemplateCreateInfo info;
+  info.setDescriptorUpdateEntries(entries)
+      .setTemplateType(::vk::DescriptorUpdateTemplateType::eDescriptorSet)
+      .setDescriptorSetLayout(layout);
+  auto update_template = device.createDescriptorUpdateTemplate(info);
+  assert(update_template && "descriptor update template create failed!");
+  return update_template;
+}
+
+auto update_descriptor_set(::vk::Device &device, ::vk::DescriptorSet set,
+                           ::vk::DescriptorUpdateTemplate update_template,
+                           void const *data) -> void {
+  device.updateDescriptorSetWithTemplate(set, update_template, data);
 }
@@ -0,0 +1,394 @@
+#include "culling.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||            \
+    defined(_M_IX86)
+#define CULLING_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define CULLING_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CULLING_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CULLING_TARGET(isa)
+#endif
+
+namespace {
+
+// counts smaller than this are not worth waking threads for
+size_t const kParallelMin{1 << 16};
+
+// tests [begin, end), writes the visible indices to out and returns how many
+using SphereKernel = auto (*)(Frustum const &frustum,
+                              SphereBounds const &bounds, size_t begin,
+                              size_t end, uint32_t *out) -> size_t;
+using BoxKernel = auto (*)(Frustum const &frustum, BoxBounds const &bounds,
+                           size_t begin, size_t end, uint32_t *out) -> size_t;
+
+struct CullKernels {
+  SphereKernel spheres;
+  BoxKernel boxes;
+};
+
+// branchless append of the set lanes of mask
+auto append(int mask, int lanes, size_t first, uint32_t *out) -> size_t {
+  size_t count{0};
+  for (int lane = 0; lane < lanes; ++lane) {
+    out[count] = static_cast<uint32_t>(first + lane);
+    count += (mask >> lane) & 1;
+  }
+  return count;
+}
+
+auto cull_spheres_scalar(Frustum const &frustum, SphereBounds const &bounds,
+                         size_t begin, size_t end, uint32_t *out) -> size_t {
+  size_t count{0};
+  for (size_t i = begin; i < end; ++i) {
+    int inside{1};
+    for (auto const &plane : frustum.planes) {
+      float distance = (plane.x * bounds.x[i] + plane.y * bounds.y[i]) +
+                       (plane.z * bounds.z[i] + plane.w);
+      inside &= static_cast<int>(distance >= -bounds.radius[i]);
+    }
+    count += append(inside, 1, i, out + count);
+  }
+  return count;
+}
+
+// only the corner furthest along the plane's normal is tested
+auto cull_boxes_scalar(Frustum const &frustum, BoxBounds const &bounds,
+                       size_t begin, size_t end, uint32_t *out) -> size_t {
+  size_t count{0};
+  for (size_t i = begin; i < end; ++i) {
+    int inside{1};
+    for (auto const &plane : frustum.planes) {
+      float distance{plane.w};
+      for (int axis = 0; axis < 3; ++axis) {
+        auto const &corner =
+            plane[axis] > 0.f ? bounds.max[axis] : bounds.min[axis];
+        distance += plane[axis] * corner[i];
+      }
+      inside &= static_cast<int>(distance >= 0.f);
+    }
+    count += append(inside, 1, i, out + count);
+  }
+  return count;
+}
+
+CullKernels const kScalarKernels{cull_spheres_scalar, cull_boxes_scalar};
+
+// the corner arrays the box kernels read for every plane and axis
+auto select_corners(Frustum const &frustum, BoxBounds const &bounds,
+                    float const *(&corners)[6][3]) -> void {
+  for (size_t p = 0; p < 6; ++p) {
+    for (int axis = 0; axis < 3; ++axis) {
+      corners[p][axis] = frustum.planes[p][axis] > 0.f
+                             ? bounds.max[axis].data()
+                             : bounds.min[axis].data();
+    }
+  }
+}
+
+#ifdef CULLING_X86
+
+CULLING_TARGET("sse2")
+auto cull_spheres_sse2(Frustum const &frustum, SphereBounds const &bounds,
+                       size_t begin, size_t end, uint32_t *out) -> size_t {
+  __m128 planes[6][4];
+  for (size_t p = 0; p < 6; ++p) {
+    for (int c = 0; c < 4; ++c) {
+      planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+    }
+  }
+  size_t count{0};
+  size_t i{begin};
+  for (; i + 4 <= end; i += 4) {
+    __m128 x = _mm_loadu_ps(bounds.x.data() + i);
+    __m128 y = _mm_loadu_ps(bounds.y.data() + i);
+    __m128 z = _mm_loadu_ps(bounds.z.data() + i);
+    __m128 radius =
+        _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(bounds.radius.data() + i));
+    __m128 inside = _mm_cmpeq_ps(x, x);
+    for (auto const &plane : planes) {
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(plane[0], x), _mm_mul_ps(plane[1], y)),
+          _mm_add_ps(_mm_mul_ps(plane[2], z), plane[3]));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, radius));
+    }
+    count += append(_mm_movemask_ps(inside), 4, i, out + count);
+  }
+  return count + cull_spheres_scalar(frustum, bounds, i, end, out + count);
+}
+
+CULLING_TARGET("sse2")
+auto cull_boxes_sse2(Frustum const &frustum, BoxBounds const &bounds,
+                     size_t begin, size_t end, uint32_t *out) -> size_t {
+  __m128 planes[6][4];
+  float const *corners[6][3];
+  select_corners(frustum, bounds, corners);
+  for (size_t p = 0; p < 6; ++p) {
+    for (int c = 0; c < 4; ++c) {
+      planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+    }
+  }
+  size_t count{0};
+  size_t i{begin};
+  for (; i + 4 <= end; i += 4) {
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (size_t p = 0; p < 6; ++p) {
+      __m128 distance = planes[p][3];
+      for (int axis = 0; axis < 3; ++axis) {
+        distance = _mm_add_ps(
+            distance,
+            _mm_mul_ps(planes[p][axis], _mm_loadu_ps(corners[p][axis] + i)));
+      }
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+    }
+    count += append(_mm_movemask_ps(inside), 4, i, out + count);
+  }
+  return count + cull_boxes_scalar(frustum, bounds, i, end, out + count);
+}
+
+CullKernels const kSse2Kernels{cull_spheres_sse2, cull_boxes_sse2};
+
+CULLING_TARGET("avx")
+auto cull_spheres_avx(Frustum const &frustum, SphereBounds const &bounds,
+                      size_t begin, size_t end, uint32_t *out) -> size_t {
+  __m256 planes[6][4];
+  for (size_t p = 0; p < 6; ++p) {
+    for (int c = 0; c < 4; ++c) {
+      planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+    }
+  }
+  size_t count{0};
+  size_t i{begin};
+  for (; i + 8 <= end; i += 8) {
+    __m256 x = _mm256_loadu_ps(bounds.x.data() + i);
+    __m256 y = _mm256_loadu_ps(bounds.y.data() + i);
+    __m256 z = _mm256_loadu_ps(bounds.z.data() + i);
+    __m256 radius = _mm256_sub_ps(_mm256_setzero_ps(),
+                                  _mm256_loadu_ps(bounds.radius.data() + i));
+    __m256 inside = _mm256_cmp_ps(x, x, _CMP_EQ_OQ);
+    for (auto const &plane : planes) {
+      __m256 distance = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(plane[0], x), _mm256_mul_ps(plane[1], y)),
+          _mm256_add_ps(_mm256_mul_ps(plane[2], z), plane[3]));
+      inside =
+          _mm256_and_ps(inside, _mm256_cmp_ps(distance, radius, _CMP_GE_OQ));
+    }
+    count += append(_mm256_movemask_ps(inside), 8, i, out + count);
+  }
+  return count + cull_spheres_sse2(frustum, bounds, i, end, out + count);
+}
+
+CULLING_TARGET("avx")
+auto cull_boxes_avx(Frustum const &frustum, BoxBounds const &bounds,
+                    size_t begin, size_t end, uint32_t *out) -> size_t {
+  __m256 planes[6][4];
+  float const *corners[6][3];
+  select_corners(frustum, bounds, corners);
+  for (size_t p = 0; p < 6; ++p) {
+    for (int c = 0; c < 4; ++c) {
+      planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+    }
+  }
+  size_t count{0};
+  size_t i{begin};
+  for (; i + 8 <= end; i += 8) {
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (size_t p = 0; p < 6; ++p) {
+      __m256 distance = planes[p][3];
+      for (int axis = 0; axis < 3; ++axis) {
+        distance = _mm256_add_ps(
+            distance, _mm256_mul_ps(planes[p][axis],
+                                    _mm256_loadu_ps(corners[p][axis] + i)));
+      }
+      inside = _mm256_and_ps(
+          inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+    count += append(_mm256_movemask_ps(inside), 8, i, out + count);
+  }
+  return count + cull_boxes_sse2(frustum, bounds, i, end, out + count);
+}
+
+CullKernels const kAvxKernels{cull_spheres_avx, cull_boxes_avx};
+
+auto detect_kernels() -> CullKernels const & {
+#ifdef _MSC_VER
+  ::std::array<int, 4> info{};
+  __cpuid(info.data(), 1);
+  bool sse2 = (info[3] & (1 << 26)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0 && (info[2] & (1 << 27)) != 0 &&
+             (_xgetbv(0) & 0x6) == 0x6;
+#else
+  __builtin_cpu_init();
+  bool sse2 = __builtin_cpu_supports("sse2");
+  bool avx = __builtin_cpu_supports("avx");
+#endif
+  if (avx) {
+    return kAvxKernels;
+  }
+  return sse2 ? kSse2Kernels : kScalarKernels;
+}
+
+#elif defined(CULLING_NEON)
+
+auto cull_spheres_neon(Frustum const &frustum, SphereBounds const &bounds,
+                       size_t begin, size_t end, uint32_t *out) -> size_t {
+  size_t count{0};
+  size_t i{begin};
+  for (; i + 4 <= end; i += 4) {
+    float32x4_t x = vld1q_f32(bounds.x.data() + i);
+    float32x4_t y = vld1q_f32(bounds.y.data() + i);
+    float32x4_t z = vld1q_f32(bounds.z.data() + i);
+    float32x4_t radius = vnegq_f32(vld1q_f32(bounds.radius.data() + i));
+    uint32x4_t inside = vdupq_n_u32(0xffff'ffff);
+    for (auto const &plane : frustum.planes) {
+      float32x4_t distance = vdupq_n_f32(plane.w);
+      distance = vmlaq_n_f32(distance, x, plane.x);
+      distance = vmlaq_n_f32(distance, y, plane.y);
+      distance = vmlaq_n_f32(distance, z, plane.z);
+      inside = vandq_u32(inside, vcgeq_f32(distance, radius));
+    }
+    int mask = static_cast<int>(vgetq_lane_u32(inside, 0) & 1) |
+               static_cast<int>(vgetq_lane_u32(inside, 1) & 2) |
+               static_cast<int>(vgetq_lane_u32(inside, 2) & 4) |
+               static_cast<int>(vgetq_lane_u32(inside, 3) & 8);
+    count += append(mask, 4, i, out + count);
+  }
+  return count + cull_spheres_scalar(frustum, bounds, i, end, out + count);
+}
+
+auto cull_boxes_neon(Frustum const &frustum, BoxBounds const &bounds,
+                     size_t begin, size_t end, uint32_t *out) -> size_t {
+  float const *corners[6][3];
+  select_corners(frustum, bounds, corners);
+  size_t count{0};
+  size_t i{begin};
+  for (; i + 4 <= end; i += 4) {
+    uint32x4_t inside = vdupq_n_u32(0xffff'ffff);
+    for (size_t p = 0; p < 6; ++p) {
+      auto const &plane = frustum.planes[p];
+      float32x4_t distance = vdupq_n_f32(plane.w);
+      for (int axis = 0; axis < 3; ++axis) {
+        distance = vmlaq_n_f32(distance, vld1q_f32(corners[p][axis] + i),
+                               plane[axis]);
+      }
+      inside = vandq_u32(inside, vcgeq_f32(distance, vdupq_n_f32(0.f)));
+    }
+    int mask = static_cast<int>(vgetq_lane_u32(inside, 0) & 1) |
+               static_cast<int>(vgetq_lane_u32(inside, 1) & 2) |
+               static_cast<int>(vgetq_lane_u32(inside, 2) & 4) |
+               static_cast<int>(vgetq_lane_u32(inside, 3) & 8);
+    count += append(mask, 4, i, out + count);
+  }
+  return count + cull_boxes_scalar(frustum, bounds, i, end, out + count);
+}
+
+CullKernels const kNeonKernels{cull_spheres_neon, cull_boxes_neon};
+
+auto detect_kernels() -> CullKernels const & { return kNeonKernels; }
+
+#else
+
+auto detect_kernels() -> CullKernels const & { return kScalarKernels; }
+
+#endif
+
+auto get_kernels() -> CullKernels const & {
+  static CullKernels const &kKernels = detect_kernels();
+  return kKernels;
+}
+
+// every chunk writes its indices where its volumes start, there is room for
+// all of them, then the chunks are packed in order
+template <typename Bounds, typename Kernel>
+auto cull(Kernel kernel, Frustum const &frustum, Bounds const &bounds,
+          ::std::vector<uint32_t> &visible, unsigned thread_count) -> void {
+  size_t count = bounds.size();
+  visible.resize(count);
+  if (thread_count < 2 || count < kParallelMin) {
+    visible.resize(kernel(frustum, bounds, 0, count, visible.data()));
+    return;
+  }
+  size_t chunk = (count + thread_count - 1) / thread_count;
+  chunk = (chunk + 7) / 8 * 8;
+  ::std::vector<size_t> counts((count + chunk - 1) / chunk);
+  ::std::vector<::std::thread> threads;
+  for (size_t k = 1; k < counts.size(); ++k) {
+    threads.emplace_back([&, k] {
+      size_t first = k * chunk;
+      counts[k] = kernel(frustum, bounds, first,
+                         ::std::min(first + chunk, count),
+                         visible.data() + first);
+    });
+  }
+  counts[0] = kernel(frustum, bounds, 0, chunk, visible.data());
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  size_t size{counts[0]};
+  for (size_t k = 1; k < counts.size(); ++k) {
+    auto first = visible.begin() + static_cast<ptrdiff_t>(k * chunk);
+    ::std::copy(first, first + static_cast<ptrdiff_t>(counts[k]),
+                visible.begin() + static_cast<ptrdiff_t>(size));
+    size += counts[k];
+  }
+  visible.resize(size);
+}
+
+} // namespace
+
+auto extract_frustum(::glm::mat4 const &view_project) -> Frustum {
+  auto row = [&view_project](int i) {
+    return ::glm::vec4{view_project[0][i], view_project[1][i],
+                       view_project[2][i], view_project[3][i]};
+  };
+  // -w <= z also holds for a [0, 1] depth range, only culls less
+  Frustum frustum{{
+      row(3) + row(0),
+      row(3) - row(0),
+      row(3) + row(1),
+      row(3) - row(1),
+      row(3) + row(2),
+      row(3) - row(2),
+  }};
+  for (auto &plane : frustum.planes) {
+    plane /= ::glm::length(::glm::vec3{plane});
+  }
+  return frustum;
+}
+
+auto SphereBounds::push(::glm::vec4 const &sphere) -> void {
+  this->x.push_back(sphere.x);
+  this->y.push_back(sphere.y);
+  this->z.push_back(sphere.z);
+  this->radius.push_back(sphere.w);
+}
+
+auto BoxBounds::push(::glm::vec3 const &min, ::glm::vec3 const &max) -> void {
+  for (int axis = 0; axis < 3; ++axis) {
+    this->min[axis].push_back(min[axis]);
+    this->max[axis].push_back(max[axis]);
+  }
+}
+
+auto cull_spheres(Frustum const &frustum, SphereBounds const &bounds,
+                  ::std::vector<uint32_t> &visible, unsigned thread_count)
+    -> void {
+  cull(get_kernels().spheres, frustum, bounds, visible, thread_count);
+}
+
+auto cull_boxes(Frustum const &frustum, BoxBounds const &bounds,
+                ::std::vector<uint32_t> &visible, unsigned thread_count)
+    -> void {
+  cull(get_kernels().boxes, frustum, bounds, visible, thread_count);
+}
@@ -0,0 +1,174 @@
+#include "depth_pyramid.hpp"
+
+#include <assert.h>
+
+namespace {
+
+uint32_t const kWorkgroupSize{8};
+
+// push constants of depth_reduce.comp
+struct ReduceConstants {
+  int32_t width;
+  int32_t height;
+};
+
+auto halve(uint32_t extent) -> uint32_t { return (extent + 1) / 2; }
+
+} // namespace
+
+DepthPyramid::DepthPyramid(::vk::PhysicalDevice &physical,
+                           ::vk::Device &device, LayoutCache &layouts,
+                           DescriptorAllocator &descriptors,
+                           ::std::filesystem::path const &shader,
+                           ::std::vector<::vk::ImageView> const &depth_views,
+                           ::vk::Extent2D const &extent)
+    : device_{device}, depth_count_{depth_views.size()} {
+  ::vk::Extent2D level{halve(extent.width), halve(extent.height)};
+  this->extents_.push_back(level);
+  while (level.width > 1 || level.height > 1) {
+    level = ::vk::Extent2D{halve(level.width), halve(level.height)};
+    this->extents_.push_back(level);
+  }
+  auto levels = static_cast<uint32_t>(this->extents_.size());
+
+  ::vk::Format format{::vk::Format::eR32Sfloat};
+  this->image_ = create_image(this->device_, this->extents_[0].width,
+                              this->extents_[0].height,
+                              ::vk::ImageUsageFlagBits::eStorage |
+                                  ::vk::ImageUsageFlagBits::eSampled,
+                              levels, format);
+  this->memory_ =
+      allocate_memory(physical, this->device_, this->image_,
+                      ::vk::MemoryPropertyFlagBits::eDeviceLocal);
+  this->view_ = create_image_view(this->device_, this->image_, format, levels);
+  for (uint32_t i = 0; i < levels; ++i) {
+    this->level_views_.push_back(
+        create_image_view(this->device_, this->image_, format, 1,
+                          ::vk::ImageAspectFlagBits::eColor, i));
+  }
+
+  // texelFetch ignores filtering, the sampler only has to exist
+  ::vk::SamplerCreateInfo sampler_info;
+  sampler_info.setMagFilter(::vk::Filter::eNearest)
+      .setMinFilter(::vk::Filter::eNearest)
+      .setMipmapMode(::vk::SamplerMipmapMode::eNearest)
+      .setAddressModeU(::vk::SamplerAddressMode::eClampToEdge)
+      .setAddressModeV(::vk::SamplerAddressMode::eClampToEdge)
+      .setAddressModeW(::vk::SamplerAddressMode::eClampToEdge)
+      .setMaxLod(VK_LOD_CLAMP_NONE);
+  this->sampler_ = this->device_.createSampler(sampler_info);
+  assert(this->sampler_ && "sampler create failed!");
+
+  ::std::vector<::vk::DescriptorSetLayoutBinding> bindings{
+      {0, ::vk::DescriptorType::eCombinedImageSampler, 1,
+       ::vk::ShaderStageFlagBits::eCompute},
+      {1, ::vk::DescriptorType::eStorageImage, 1,
+       ::vk::ShaderStageFlagBits::eCompute},
+  };
+  auto set_layout = layouts.get_set_layout(bindings);
+  this->layout_ = layouts.get_pipeline_layout(
+      {set_layout}, {::vk::PushConstantRange{
+                        ::vk::ShaderStageFlagBits::eCompute, 0,
+                        sizeof(ReduceConstants)}});
+  auto set_count = static_cast<uint32_t>(this->depth_count_) + levels - 1;
+  this->sets_ = descriptors.allocate(set_layout, set_count);
+  // sources first, then targets, so that the writes can point into them
+  ::std::vector<::vk::DescriptorImageInfo> image_infos;
+  image_infos.reserve(set_count * 2);
+  for (auto const &view : depth_views) {
+    image_infos.emplace_back(this->sampler_, view,
+                             ::vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+  }
+  for (uint32_t i = 1; i < levels; ++i) {
+    image_infos.emplace_back(this->sampler_, this->level_views_[i - 1],
+                             ::vk::ImageLayout::eGeneral);
+  }
+  for (uint32_t i = 0; i < set_count; ++i) {
+    size_t target = i < this->depth_count_ ? 0 : i - this->depth_count_ + 1;
+    image_infos.emplace_back(nullptr, this->level_views_[target],
+                             ::vk::ImageLayout::eGeneral);
+  }
+  ::std::vector<::vk::WriteDescriptorSet> writes;
+  for (uint32_t i = 0; i < set_count; ++i) {
+    writes.emplace_back(this->sets_[i], 0, 0, 1,
+                        ::vk::DescriptorType::eCombinedImageSampler,
+                        &image_infos[i]);
+    writes.emplace_back(this->sets_[i], 1, 0, 1,
+                        ::vk::DescriptorType::eStorageImage,
+                        &image_infos[set_count + i]);
+  }
+  this->device_.updateDescriptorSets(writes, {});
+
+  auto module = create_shader_module(this->device_, shader);
+  ::vk::ComputePipelineCreateInfo info;
+  info.setStage(::vk::PipelineShaderStageCreateInfo{
+                    {}, ::vk::ShaderStageFlagBits::eCompute, module, "main"})
+      .setLayout(this->layout_);
+  auto result = this->device_.createComputePipeline(nullptr, info);
+  assert(result.result == ::vk::Result::eSuccess &&
+         "compute pipeline create failed!");
+  this->pipeline_ = result.value;
+  this->device_.destroyShaderModule(module);
+}
+
+auto DepthPyramid::build(::vk::CommandBuffer &cbuf, size_t depth_index)
+    -> void {
+  assert(depth_index < this->depth_count_ && "depth pyramid build failed!");
+  auto levels = static_cast<uint32_t>(this->extents_.size());
+  // every level is rewritten, the previous frame's content may be dropped
+  // once the shaders that read it are done
+  ::vk::ImageMemoryBarrier discard;
+  discard.setImage(this->image_)
+      .setOldLayout(::vk::ImageLayout::eUndefined)
+      .setNewLayout(::vk::ImageLayout::eGeneral)
+      .setDstAccessMask(::vk::AccessFlagBits::eShaderWrite)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setSubresourceRange(::vk::ImageSubresourceRange{
+          ::vk::ImageAspectFlagBits::eColor, 0, levels, 0, 1});
+  cbuf.pipelineBarrier(::vk::PipelineStageFlagBits::eComputeShader,
+                       ::vk::PipelineStageFlagBits::eComputeShader, {}, {},
+                       {}, discard);
+
+  cbuf.bindPipeline(::vk::PipelineBindPoint::eCompute, this->pipeline_);
+  for (uint32_t i = 0; i < levels; ++i) {
+    auto set = i == 0 ? this->sets_[depth_index]
+                      : this->sets_[this->depth_count_ + i - 1];
+    auto const &extent = this->extents_[i];
+    ReduceConstants constants{static_cast<int32_t>(extent.width),
+                              static_cast<int32_t>(extent.height)};
+    cbuf.bindDescriptorSets(::vk::PipelineBindPoint::eCompute, this->layout_,
+                            0, set, {});
+    cbuf.pushConstants(this->layout_, ::vk::ShaderStageFlagBits::eCompute, 0,
+                       sizeof(ReduceConstants), &constants);
+    cbuf.dispatch((extent.width + kWorkgroupSize - 1) / kWorkgroupSize,
+                  (extent.height + kWorkgroupSize - 1) / kWorkgroupSize, 1);
+
+    // the next level, or the culling after the last one, reads this one
+    ::vk::ImageMemoryBarrier written;
+    written.setImage(this->image_)
+        .setOldLayout(::vk::ImageLayout::eGeneral)
+        .setNewLayout(::vk::ImageLayout::eGeneral)
+        .setSrcAccessMask(::vk::AccessFlagBits::eShaderWrite)
+        .setDstAccessMask(::vk::AccessFlagBits::eShaderRead)
+        .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setSubresourceRange(::vk::ImageSubresourceRange{
+            ::vk::ImageAspectFlagBits::eColor, i, 1, 0, 1});
+    cbuf.pipelineBarrier(::vk::PipelineStageFlagBits::eComputeShader,
+                         ::vk::PipelineStageFlagBits::eComputeShader, {}, {},
+                         {}, written);
+  }
+}
+
+auto DepthPyramid::destroy() -> void {
+  // the layout belongs to the LayoutCache and the sets to their allocator
+  this->device_.destroyPipeline(this->pipeline_);
+  this->device_.destroySampler(this->sampler_);
+  for (auto &view : this->level_views_) {
+    this->device_.destroyImageView(view);
+  }
+  this->device_.destroyImageView(this->view_);
+  this->device_.destroyImage(this->image_);
+  this->device_.freeMemory(this->memory_);
+}
@@ -0,0 +1,102 @@
+#include "descriptor_allocator.hpp"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace {
+
+// the largest pool, past it the allocator only adds more pools of this size
+uint32_t const kMaxSetsPerPool{4096};
+
+// descriptors reserved per set, by type
+::std::array<::std::pair<::vk::DescriptorType, uint32_t>, 7> const
+    kDescriptorsPerSet{{
+        {::vk::DescriptorType::eUniformBuffer, 2},
+        {::vk::DescriptorType::eUniformBufferDynamic, 1},
+        {::vk::DescriptorType::eStorageBuffer, 2},
+        {::vk::DescriptorType::eCombinedImageSampler, 4},
+        {::vk::DescriptorType::eSampledImage, 2},
+        {::vk::DescriptorType::eSampler, 1},
+        {::vk::DescriptorType::eStorageImage, 1},
+    }};
+
+auto create_pool(::vk::Device &device, uint32_t max_sets)
+    -> ::vk::DescriptorPool {
+  ::std::vector<::vk::DescriptorPoolSize> sizes;
+  for (auto [type, count] : kDescriptorsPerSet) {
+    sizes.emplace_back(type, count * max_sets);
+  }
+  ::vk::DescriptorPoolCreateInfo info;
+  info.setPoolSizes(sizes).setMaxSets(max_sets);
+  auto pool = device.createDescriptorPool(info);
+  assert(pool && "descriptor pool create failed!");
+  return pool;
+}
+
+} // namespace
+
+DescriptorAllocator::DescriptorAllocator(::vk::Device &device,
+                                         uint32_t sets_per_pool)
+    : device_{device}, sets_per_pool_{sets_per_pool} {}
+
+auto DescriptorAllocator::allocate(::vk::DescriptorSetLayout layout)
+    -> ::vk::DescriptorSet {
+  return this->allocate(layout, 1).front();
+}
+
+auto DescriptorAllocator::allocate(::vk::DescriptorSetLayout layout,
+                                   uint32_t count)
+    -> ::std::vector<::vk::DescriptorSet> {
+  if (!this->current_) {
+    this->current_ = this->next_pool();
+  }
+  ::std::vector<::vk::DescriptorSetLayout> layouts(count, layout);
+  ::std::vector<::vk::DescriptorSet> sets(count);
+  ::vk::DescriptorSetAllocateInfo info;
+  info.setDescriptorPool(this->current_).setSetLayouts(layouts);
+  auto result = this->device_.allocateDescriptorSets(&info, sets.data());
+  if (result == ::vk::Result::eErrorOutOfPoolMemory ||
+      result == ::vk::Result::eErrorFragmentedPool) {
+    // retire the pool until reset and try once more in a fresh one
+    this->full_pools_.emplace_back(this->current_);
+    this->current_ = this->next_pool();
+    info.setDescriptorPool(this->current_);
+    result = this->device_.allocateDescriptorSets(&info, sets.data());
+  }
+  assert(result == ::vk::Result::eSuccess && "descriptor set allocate failed!");
+  return sets;
+}
+
+auto DescriptorAllocator::reset() -> void {
+  if (this->current_) {
+    this->full_pools_.emplace_back(this->current_);
+    this->current_ = nullptr;
+  }
+  for (auto &pool : this->full_pools_) {
+    this->device_.resetDescriptorPool(pool);
+    this->free_pools_.emplace_back(pool);
+  }
+  this->full_pools_.clear();
+}
+
+auto DescriptorAllocator::destroy() -> void {
+  this->reset();
+  for (auto &pool : this->free_pools_) {
+    this->device_.destroyDescriptorPool(pool);
+  }
+  this->free_pools_.clear();
+}
+
+auto DescriptorAllocator::next_pool() -> ::vk::DescriptorPool {
+  if (!this->free_pools_.empty()) {
+    auto pool = this->free_pools_.back();
+    this->free_pools_.pop_back();
+    return pool;
+  }
+  auto pool = create_pool(this->device_, this->sets_per_pool_);
+  this->sets_per_pool_ = ::std::min(this->sets_per_pool_ * 2, kMaxSetsPerPool);
+  return pool;
+}
@@ -0,0 +1,151 @@
+#include "descriptor_buffer.hpp"
+
+#include <assert.h>
+
+namespace {
+
+::vk::BufferUsageFlags const kDescriptorBufferUsage{
+    ::vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT |
+    ::vk::BufferUsageFlagBits::eSamplerDescriptorBufferEXT |
+    ::vk::BufferUsageFlagBits::eShaderDeviceAddress};
+
+auto align_up(::vk::DeviceSize value, ::vk::DeviceSize alignment)
+    -> ::vk::DeviceSize {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+DescriptorBuffer::DescriptorBuffer(::vk::PhysicalDevice &physical,
+                                   ::vk::Device &device,
+                                   QueueFamilyIndices &indices,
+                                   uint32_t frame_count,
+                                   ::vk::DeviceSize frame_size)
+    : device_{device} {
+  ::vk::PhysicalDeviceProperties2 properties;
+  properties.setPNext(&this->properties_);
+  physical.getProperties2(&properties);
+  this->properties_.setPNext(nullptr);
+
+  this->frame_size_ =
+      align_up(frame_size, this->properties_.descriptorBufferOffsetAlignment);
+  this->buffer_ = create_buffer(this->device_, indices,
+                                this->frame_size_ * frame_count,
+                                kDescriptorBufferUsage);
+  this->memory_ =
+      allocate_memory(physical, this->device_, this->buffer_,
+                      ::vk::MemoryPropertyFlagBits::eHostVisible |
+                          ::vk::MemoryPropertyFlagBits::eHostCoherent,
+                      ::vk::MemoryAllocateFlagBits::eDeviceAddress);
+  this->address_ = this->device_.getBufferAddress(
+      ::vk::BufferDeviceAddressInfo{this->buffer_});
+  this->mapped_ = static_cast<unsigned char *>(
+      this->device_.mapMemory(this->memory_, 0, VK_WHOLE_SIZE));
+  assert(this->mapped_ && "descriptor buffer map failed!");
+}
+
+auto DescriptorBuffer::begin_frame(size_t frame) -> void {
+  this->begin_ = this->frame_size_ * frame;
+  this->head_ = this->begin_;
+}
+
+auto DescriptorBuffer::allocate(::vk::DescriptorSetLayout layout)
+    -> ::vk::DeviceSize {
+  ::vk::DeviceSize set = this->head_;
+  ::vk::DeviceSize size = this->device_.getDescriptorSetLayoutSizeEXT(layout);
+  assert(set + size <= this->begin_ + this->frame_size_ &&
+         "descriptor buffer frame is full!");
+  this->head_ =
+      align_up(set + size, this->properties_.descriptorBufferOffsetAlignment);
+  return set;
+}
+
+auto DescriptorBuffer::write(::vk::DeviceSize set,
+                             ::vk::DescriptorSetLayout layout, uint32_t binding,
+                             ::vk::DescriptorType type,
+                             ::vk::DescriptorBufferInfo const &info) -> void {
+  ::vk::DeviceAddress address = this->device_.getBufferAddress(
+      ::vk::BufferDeviceAddressInfo{info.buffer});
+  ::vk::DescriptorAddressInfoEXT address_info{address + info.offset,
+                                              info.range};
+  ::vk::DescriptorGetInfoEXT get_info;
+  get_info.setType(type);
+  switch (type) {
+  case ::vk::DescriptorType::eUniformBuffer:
+    get_info.data.setPUniformBuffer(&address_info);
+    this->write_descriptor(set, layout, binding, get_info,
+                           this->properties_.uniformBufferDescriptorSize);
+    break;
+  case ::vk::DescriptorType::eStorageBuffer:
+    get_info.data.setPStorageBuffer(&address_info);
+    this->write_descriptor(set, layout, binding, get_info,
+                           this->properties_.storageBufferDescriptorSize);
+    break;
+  default:
+    assert(false && "descriptor buffer type not supported!");
+  }
+}
+
+auto DescriptorBuffer::write(::vk::DeviceSize set,
+                             ::vk::DescriptorSetLayout layout, uint32_t binding,
+                             ::vk::DescriptorType type,
+                             ::vk::DescriptorImageInfo const &info) -> void {
+  ::vk::DescriptorGetInfoEXT get_info;
+  get_info.setType(type);
+  switch (type) {
+  case ::vk::DescriptorType::eCombinedImageSampler:
+    get_info.data.setPCombinedImageSampler(&info);
+    this->write_descriptor(
+        set, layout, binding, get_info,
+        this->properties_.combinedImageSamplerDescriptorSize);
+    break;
+  case ::vk::DescriptorType::eSampledImage:
+    get_info.data.setPSampledImage(&info);
+    this->write_descriptor(set, layout, binding, get_info,
+                           this->properties_.sampledImageDescriptorSize);
+    break;
+  case ::vk::DescriptorType::eStorageImage:
+    get_info.data.setPStorageImage(&info);
+    this->write_descriptor(set, layout, binding, get_info,
+                           this->properties_.storageImageDescriptorSize);
+    break;
+  case ::vk::DescriptorType::eSampler:
+    get_info.data.setPSampler(&info.sampler);
+    this->write_descriptor(set, layout, binding, get_info,
+                           this->properties_.samplerDescriptorSize);
+    break;
+  default:
+    assert(false && "descriptor buffer type not supported!");
+  }
+}
+
+auto DescriptorBuffer::bind(::vk::CommandBuffer &cbuf,
+                            ::vk::PipelineBindPoint bind_point,
+                            ::vk::PipelineLayout layout, uint32_t first_set,
+                            ::std::vector<::vk::DeviceSize> const &sets) const
+    -> void {
+  cbuf.bindDescriptorBuffersEXT(
+      ::vk::DescriptorBufferBindingInfoEXT{this->address_,
+                                           kDescriptorBufferUsage});
+  // every set lives in buffer 0, the only one bound
+  ::std::vector<uint32_t> buffer_indices(sets.size(), 0);
+  cbuf.setDescriptorBufferOffsetsEXT(bind_point, layout, first_set,
+                                     buffer_indices, sets);
+}
+
+auto DescriptorBuffer::destroy() -> void {
+  this->device_.unmapMemory(this->memory_);
+  this->device_.destroyBuffer(this->buffer_);
+  this->device_.freeMemory(this->memory_);
+}
+
+auto DescriptorBuffer::write_descriptor(::vk::DeviceSize set,
+                                        ::vk::DescriptorSetLayout layout,
+                                        uint32_t binding,
+                                        ::vk::DescriptorGetInfoEXT const &info,
+                                        size_t size) -> void {
+  ::vk::DeviceSize offset =
+      set + this->device_.getDescriptorSetLayoutBindingOffsetEXT(layout,
+                                                                 binding);
+  this->device_.getDescriptorEXT(info, size, this->mapped_ + offset);
+}
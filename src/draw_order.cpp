@@ -0,0 +1,11 @@
+#include "draw_order.hpp"
+
+#include <string.h>
+
+auto get_opaque_sort_key(uint32_t state, float depth) -> uint64_t {
+  // non-negative floats order like their bits, NaN fails the test too
+  float clamped = depth > 0.f ? depth : 0.f;
+  uint32_t bits{0};
+  ::memcpy(&bits, &clamped, sizeof(bits));
+  return static_cast<uint64_t>(state) << 32 | bits;
+}
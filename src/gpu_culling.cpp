@@ -0,0 +1,163 @@
+#include "gpu_culling.hpp"
+
+#include "culling.hpp"
+
+#include <assert.h>
+
+#include <array>
+#include <tuple>
+
+namespace {
+
+uint32_t const kWorkgroupSize{64};
+
+// push constants of cull.comp
+struct CullConstants {
+  ::std::array<::glm::vec4, 6> planes;
+  uint32_t object_count;
+};
+
+auto align_up(::vk::DeviceSize value, ::vk::DeviceSize alignment)
+    -> ::vk::DeviceSize {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+GpuCuller::GpuCuller(::vk::PhysicalDevice &physical, ::vk::Device &device,
+                     QueueFamilyIndices &indices, ::vk::CommandPool &pool,
+                     ::vk::Queue &queue, LayoutCache &layouts,
+                     DescriptorAllocator &descriptors,
+                     ::std::filesystem::path const &shader,
+                     ::std::vector<DrawObject> const &objects,
+                     uint32_t frame_count, DeviceFeatures const &features)
+    : device_{device}, draw_count_{features.draw_indirect_count},
+      object_count_{static_cast<uint32_t>(objects.size())} {
+  assert(features.multi_draw_indirect &&
+         "gpu culling needs multi draw indirect!");
+  auto alignment =
+      physical.getProperties().limits.minStorageBufferOffsetAlignment;
+  this->draw_region_ = align_up(
+      sizeof(::vk::DrawIndexedIndirectCommand) * this->object_count_,
+      alignment);
+  this->count_region_ = align_up(sizeof(uint32_t), alignment);
+
+  ::std::vector object_buffers{
+      wrap_buffer(physical, this->device_, indices, objects.data(),
+                  objects.size(), ::vk::BufferUsageFlagBits::eStorageBuffer),
+  };
+  ::std::tie(this->buffers_, this->object_memory_) =
+      allocate_memory<::vk::Buffer>(physical, this->device_, pool, queue,
+                                    object_buffers,
+                                    ::vk::MemoryPropertyFlagBits::eDeviceLocal);
+  // written by the compute pass, read as indirect arguments
+  ::vk::BufferUsageFlags usage{::vk::BufferUsageFlagBits::eStorageBuffer |
+                               ::vk::BufferUsageFlagBits::eIndirectBuffer |
+                               ::vk::BufferUsageFlagBits::eTransferDst};
+  ::std::vector draw_buffers{
+      create_buffer(this->device_, indices, this->draw_region_ * frame_count,
+                    usage),
+      create_buffer(this->device_, indices, this->count_region_ * frame_count,
+                    usage),
+  };
+  this->draw_memory_ =
+      allocate_memory(physical, this->device_, draw_buffers,
+                      ::vk::MemoryPropertyFlagBits::eDeviceLocal);
+  this->buffers_.insert(this->buffers_.end(), draw_buffers.begin(),
+                        draw_buffers.end());
+
+  ::std::vector<::vk::DescriptorSetLayoutBinding> bindings;
+  for (uint32_t i = 0; i < 3; ++i) {
+    bindings.emplace_back(i, ::vk::DescriptorType::eStorageBuffer, 1,
+                          ::vk::ShaderStageFlagBits::eCompute);
+  }
+  auto set_layout = layouts.get_set_layout(bindings);
+  this->layout_ = layouts.get_pipeline_layout(
+      {set_layout}, {::vk::PushConstantRange{
+                        ::vk::ShaderStageFlagBits::eCompute, 0,
+                        sizeof(CullConstants)}});
+  this->sets_ = descriptors.allocate(set_layout, frame_count);
+  ::std::vector<::vk::DescriptorBufferInfo> buffer_infos;
+  buffer_infos.reserve(bindings.size() * frame_count);
+  ::std::vector<::vk::WriteDescriptorSet> writes;
+  for (uint32_t i = 0; i < frame_count; ++i) {
+    buffer_infos.emplace_back(this->buffers_[0], 0, VK_WHOLE_SIZE);
+    buffer_infos.emplace_back(this->buffers_[1], this->draw_region_ * i,
+                              this->draw_region_);
+    buffer_infos.emplace_back(this->buffers_[2], this->count_region_ * i,
+                              sizeof(uint32_t));
+    for (uint32_t binding = 0; binding < bindings.size(); ++binding) {
+      writes.emplace_back(this->sets_[i], binding, 0, 1,
+                          ::vk::DescriptorType::eStorageBuffer, nullptr,
+                          &buffer_infos[i * bindings.size() + binding]);
+    }
+  }
+  this->device_.updateDescriptorSets(writes, {});
+
+  auto module = create_shader_module(this->device_, shader);
+  ::vk::ComputePipelineCreateInfo info;
+  info.setStage(::vk::PipelineShaderStageCreateInfo{
+                    {}, ::vk::ShaderStageFlagBits::eCompute, module, "main"})
+      .setLayout(this->layout_);
+  auto result = this->device_.createComputePipeline(nullptr, info);
+  assert(result.result == ::vk::Result::eSuccess &&
+         "compute pipeline create failed!");
+  this->pipeline_ = result.value;
+  this->device_.destroyShaderModule(module);
+}
+
+auto GpuCuller::cull(::vk::CommandBuffer &cbuf, size_t frame,
+                     ::glm::mat4 const &view_project) -> void {
+  cbuf.fillBuffer(this->buffers_[2], this->count_region_ * frame,
+                  sizeof(uint32_t), 0);
+  if (!this->draw_count_) {
+    // every slot is drawn, the ones culling leaves empty draw nothing
+    cbuf.fillBuffer(this->buffers_[1], this->draw_region_ * frame,
+                    this->draw_region_, 0);
+  }
+  ::vk::MemoryBarrier clear_barrier{::vk::AccessFlagBits::eTransferWrite,
+                                    ::vk::AccessFlagBits::eShaderRead |
+                                        ::vk::AccessFlagBits::eShaderWrite};
+  cbuf.pipelineBarrier(::vk::PipelineStageFlagBits::eTransfer,
+                       ::vk::PipelineStageFlagBits::eComputeShader, {},
+                       clear_barrier, {}, {});
+
+  CullConstants constants{extract_frustum(view_project).planes,
+                          this->object_count_};
+  cbuf.bindPipeline(::vk::PipelineBindPoint::eCompute, this->pipeline_);
+  cbuf.bindDescriptorSets(::vk::PipelineBindPoint::eCompute, this->layout_, 0,
+                          this->sets_[frame], {});
+  cbuf.pushConstants(this->layout_, ::vk::ShaderStageFlagBits::eCompute, 0,
+                     sizeof(CullConstants), &constants);
+  cbuf.dispatch((this->object_count_ + kWorkgroupSize - 1) / kWorkgroupSize,
+                1, 1);
+
+  ::vk::MemoryBarrier draw_barrier{::vk::AccessFlagBits::eShaderWrite,
+                                   ::vk::AccessFlagBits::eIndirectCommandRead};
+  cbuf.pipelineBarrier(::vk::PipelineStageFlagBits::eComputeShader,
+                       ::vk::PipelineStageFlagBits::eDrawIndirect, {},
+                       draw_barrier, {}, {});
+}
+
+auto GpuCuller::draw(::vk::CommandBuffer &cbuf, size_t frame) const -> void {
+  if (this->draw_count_) {
+    cbuf.drawIndexedIndirectCount(
+        this->buffers_[1], this->draw_region_ * frame, this->buffers_[2],
+        this->count_region_ * frame, this->object_count_,
+        sizeof(::vk::DrawIndexedIndirectCommand));
+  } else {
+    cbuf.drawIndexedIndirect(this->buffers_[1], this->draw_region_ * frame,
+                             this->object_count_,
+                             sizeof(::vk::DrawIndexedIndirectCommand));
+  }
+}
+
+auto GpuCuller::destroy() -> void {
+  // the layout belongs to the LayoutCache and the sets to their allocator
+  this->device_.destroyPipeline(this->pipeline_);
+  for (auto &buffer : this->buffers_) {
+    this->device_.destroyBuffer(buffer);
+  }
+  this->device_.freeMemory(this->object_memory_);
+  this->device_.freeMemory(this->draw_memory_);
+}
@@ -0,0 +1,291 @@
+#include "image_cache.hpp"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <array>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <vulkan/vulkan.hpp>
+
+namespace fs = ::std::filesystem;
+
+namespace {
+
+uint32_t const kCacheMagic{0x4349'4b56}; // "VKIC"
+
+uint32_t const kCacheVersion{3};
+
+// larger extents than any device supports, keeps the size math from overflow
+uint32_t const kMaxExtent{1u << 16};
+
+struct CacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_hash;
+  int64_t source_mtime;
+  uint64_t source_size;
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levels;
+  uint64_t data_size;
+  uint64_t reserved;
+};
+static_assert(sizeof(CacheHeader) == 64, "cache header must keep its layout");
+
+class MappedFile final {
+public:
+  explicit MappedFile(fs::path const &filename);
+  MappedFile(MappedFile const &) = delete;
+  MappedFile &operator=(MappedFile const &) = delete;
+  ~MappedFile();
+
+  auto get_data() const -> unsigned char const * {
+    return static_cast<unsigned char const *>(this->data_);
+  }
+  auto get_size() const -> size_t { return this->size_; }
+
+private:
+  void *data_{nullptr};
+  size_t size_{0};
+#ifdef _WIN32
+  HANDLE mapping_{nullptr};
+#endif
+};
+
+#ifdef _WIN32
+MappedFile::MappedFile(fs::path const &filename) {
+  HANDLE file = ::CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  LARGE_INTEGER size;
+  if (::GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    this->mapping_ =
+        ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  }
+  ::CloseHandle(file);
+  if (this->mapping_ == nullptr) {
+    return;
+  }
+  this->data_ = ::MapViewOfFile(this->mapping_, FILE_MAP_READ, 0, 0, 0);
+  this->size_ = this->data_ != nullptr ? static_cast<size_t>(size.QuadPart) : 0;
+}
+
+MappedFile::~MappedFile() {
+  if (this->data_ != nullptr) {
+    ::UnmapViewOfFile(this->data_);
+  }
+  if (this->mapping_ != nullptr) {
+    ::CloseHandle(this->mapping_);
+  }
+}
+#else
+MappedFile::MappedFile(fs::path const &filename) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st {};
+  if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+    void *data = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                        MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      ::madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+      this->data_ = data;
+      this->size_ = static_cast<size_t>(st.st_size);
+    }
+  }
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (this->data_ != nullptr) {
+    ::munmap(this->data_, this->size_);
+  }
+}
+#endif
+
+// FNV-1a, 64 bits
+auto hash_bytes(void const *data, size_t size,
+                uint64_t seed = 0xcbf2'9ce4'8422'2325ull) -> uint64_t {
+  auto const *bytes = static_cast<unsigned char const *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    seed = (seed ^ bytes[i]) * 0x0000'0100'0000'01b3ull;
+  }
+  return seed;
+}
+
+// one entry per source and requested decoding
+auto get_cache_entry(fs::path const &filename, fs::path const &cache_dir,
+                     int channels, bool srgb) -> fs::path {
+  ::std::error_code ec;
+  auto key = fs::absolute(filename, ec).lexically_normal().generic_string();
+  auto hash = hash_bytes(key.data(), key.size());
+  ::std::array<int, 2> request{channels, srgb ? 1 : 0};
+  hash = hash_bytes(request.data(), sizeof(request), hash);
+  char name[24];
+  ::snprintf(name, sizeof(name), "%016llx.vkic",
+             static_cast<unsigned long long>(hash));
+  return cache_dir / name;
+}
+
+auto get_valid_header(MappedFile const &cache) -> CacheHeader const * {
+  if (cache.get_size() < sizeof(CacheHeader)) {
+    return nullptr;
+  }
+  auto const *header = reinterpret_cast<CacheHeader const *>(cache.get_data());
+  if (header->magic != kCacheMagic || header->version != kCacheVersion ||
+      header->data_size != cache.get_size() - sizeof(CacheHeader)) {
+    return nullptr;
+  }
+  // a truncated or tampered entry must not reach the Image it describes
+  auto texel = get_format_size(static_cast<::vk::Format>(header->format));
+  if (texel == 0 || header->width == 0 || header->height == 0 ||
+      header->width > kMaxExtent || header->height > kMaxExtent) {
+    return nullptr;
+  }
+  auto width = static_cast<int>(header->width);
+  auto height = static_cast<int>(header->height);
+  if (header->levels == 0 ||
+      header->levels > static_cast<uint32_t>(get_mip_levels(width, height)) ||
+      header->data_size != image_size(width, height,
+                                      static_cast<int>(header->levels),
+                                      texel)) {
+    return nullptr;
+  }
+  return header;
+}
+
+// texels stay in the mapping, the Image keeps the file mapped
+auto make_image(::std::shared_ptr<MappedFile const> const &cache,
+                CacheHeader const &header) -> Image {
+  ::std::shared_ptr<unsigned char const> data{
+      cache, cache->get_data() + sizeof(CacheHeader)};
+  Image image{::std::move(data),
+              static_cast<int>(header.width),
+              static_cast<int>(header.height),
+              static_cast<::vk::Format>(header.format),
+              static_cast<int>(header.levels),
+              ImageStorage::kMapped};
+  assert(image.get_size() == header.data_size && "corrupted image cache!");
+  return image;
+}
+
+auto write_cache(fs::path const &entry, CacheHeader const &header,
+                 Image const &image) -> void {
+  ::std::error_code ec;
+  fs::create_directories(entry.parent_path(), ec);
+  fs::path temp = entry;
+  temp += ".tmp";
+  {
+    ::std::ofstream ofs{temp, ::std::ios::binary | ::std::ios::trunc};
+    ofs.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<char const *>(image.get_data()),
+              static_cast<::std::streamsize>(image.get_size()));
+    if (!ofs) {
+      ofs.close();
+      fs::remove(temp, ec);
+      return;
+    }
+  }
+  // rename is atomic, a concurrent reader never sees a half written entry
+  fs::rename(temp, entry, ec);
+  if (ec) {
+    fs::remove(temp, ec);
+  }
+}
+
+auto touch_cache(fs::path const &entry, CacheHeader header, int64_t mtime)
+    -> void {
+  header.source_mtime = mtime;
+  ::std::fstream stream{entry, ::std::ios::binary | ::std::ios::in |
+                                   ::std::ios::out};
+  stream.write(reinterpret_cast<char const *>(&header), sizeof(header));
+}
+
+} // namespace
+
+auto create_cached_image_data(fs::path const &filename,
+                              fs::path const &cache_dir, int channels,
+                              bool srgb) -> Image {
+  ::std::error_code ec;
+  int64_t mtime = fs::last_write_time(filename, ec).time_since_epoch().count();
+  uint64_t source_size = fs::file_size(filename, ec);
+  fs::path entry = get_cache_entry(filename, cache_dir, channels, srgb);
+
+  // hot path: the source is untouched, the entry is used without reading it
+  {
+    auto cache = ::std::make_shared<MappedFile const>(entry);
+    auto const *header = get_valid_header(*cache);
+    if (header != nullptr && header->source_mtime == mtime &&
+        header->source_size == source_size) {
+      return make_image(cache, *header);
+    }
+  }
+
+  ::std::ifstream ifs{filename, ::std::ios::binary | ::std::ios::in};
+  ::std::vector<unsigned char> content{(::std::istreambuf_iterator<char>(ifs)),
+                                       ::std::istreambuf_iterator<char>()};
+  ifs.close();
+  uint64_t hash = hash_bytes(content.data(), content.size());
+
+  // source was touched but not modified, keep the texels and refresh mtime,
+  // they are copied out so the entry is not mapped while it is rewritten
+  Image image;
+  CacheHeader header{};
+  {
+    MappedFile cache{entry};
+    auto const *valid = get_valid_header(cache);
+    if (valid != nullptr && valid->source_hash == hash &&
+        valid->source_size == content.size()) {
+      image = Image{cache.get_data() + sizeof(CacheHeader),
+                    static_cast<int>(valid->width),
+                    static_cast<int>(valid->height),
+                    static_cast<::vk::Format>(valid->format),
+                    static_cast<int>(valid->levels)};
+      assert(image.get_size() == valid->data_size && "corrupted image cache!");
+      header = *valid;
+    }
+  }
+  if (header.magic == kCacheMagic) {
+    touch_cache(entry, header, mtime);
+    return image;
+  }
+
+  image = generate_mipmaps(Image{content, channels, srgb});
+  header.magic = kCacheMagic;
+  header.version = kCacheVersion;
+  header.source_hash = hash;
+  header.source_mtime = mtime;
+  header.source_size = content.size();
+  header.format = static_cast<uint32_t>(image.get_format());
+  header.width = static_cast<uint32_t>(image.get_width());
+  header.height = static_cast<uint32_t>(image.get_height());
+  header.levels = static_cast<uint32_t>(image.get_levels());
+  header.data_size = image.get_size();
+  write_cache(entry, header, image);
+  return image;
+}
@@ -0,0 +1,185 @@
+#include "layout_cache.hpp"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace {
+
+auto hash_combine(size_t &seed, size_t value) -> void {
+  seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+template <typename T> auto hash_handle(T handle) -> size_t {
+  using CType = typename T::CType;
+  return ::std::hash<CType>{}(static_cast<CType>(handle));
+}
+
+template <typename T> auto hash_flags(::vk::Flags<T> flags) -> size_t {
+  return ::std::hash<VkFlags>{}(static_cast<VkFlags>(flags));
+}
+
+} // namespace
+
+LayoutCache::LayoutCache(::vk::Device &device) : device_{device} {}
+
+auto LayoutCache::get_set_layout(
+    ::std::vector<::vk::DescriptorSetLayoutBinding> const &bindings,
+    ::vk::DescriptorSetLayoutCreateFlags flags,
+    ::std::vector<::vk::DescriptorBindingFlags> const &binding_flags)
+    -> ::vk::DescriptorSetLayout {
+  assert((binding_flags.empty() || binding_flags.size() == bindings.size()) &&
+         "one binding flag per binding!");
+  SetLayoutKey key{flags, {}};
+  for (size_t i = 0; i < bindings.size(); ++i) {
+    auto const &binding = bindings[i];
+    ::std::vector<::vk::Sampler> samplers;
+    if (binding.pImmutableSamplers != nullptr) {
+      samplers.assign(binding.pImmutableSamplers,
+                      binding.pImmutableSamplers + binding.descriptorCount);
+    }
+    key.bindings.push_back(Binding{
+        binding.binding, binding.descriptorType, binding.descriptorCount,
+        binding.stageFlags,
+        binding_flags.empty() ? ::vk::DescriptorBindingFlags{}
+                              : binding_flags[i],
+        ::std::move(samplers)});
+  }
+  ::std::sort(key.bindings.begin(), key.bindings.end(),
+              [](auto const &lhs, auto const &rhs) {
+                return lhs.binding < rhs.binding;
+              });
+  if (auto iter = this->set_layouts_.find(key);
+      iter != this->set_layouts_.end()) {
+    return iter->second;
+  }
+
+  ::vk::DescriptorSetLayoutBindingFlagsCreateInfo flags_info;
+  flags_info.setBindingFlags(binding_flags);
+  ::vk::DescriptorSetLayoutCreateInfo info;
+  info.setFlags(flags).setBindings(bindings);
+  if (!binding_flags.empty()) {
+    info.setPNext(&flags_info);
+  }
+  auto layout = this->device_.createDescriptorSetLayout(info);
+  assert(layout && "descriptor set layout create failed!");
+  this->set_layouts_.emplace(::std::move(key), layout);
+  return layout;
+}
+
+auto LayoutCache::get_pipeline_layout(
+    ::std::vector<::vk::DescriptorSetLayout> const &set_layouts,
+    ::std::vector<::vk::PushConstantRange> const &ranges)
+    -> ::vk::PipelineLayout {
+  PipelineLayoutKey key{set_layouts, ranges};
+  if (auto iter = this->pipeline_layouts_.find(key);
+      iter != this->pipeline_layouts_.end()) {
+    return iter->second;
+  }
+
+  ::vk::PipelineLayoutCreateInfo info;
+  info.setSetLayouts(set_layouts).setPushConstantRanges(ranges);
+  auto layout = this->device_.createPipelineLayout(info);
+  assert(layout && "pipeline layout create failed!");
+  this->pipeline_layouts_.emplace(::std::move(key), layout);
+  return layout;
+}
+
+auto LayoutCache::evict_sampler(::vk::Sampler sampler) -> void {
+  ::std::vector<::vk::DescriptorSetLayout> evicted;
+  for (auto iter = this->set_layouts_.begin();
+       iter != this->set_layouts_.end();) {
+    auto uses_sampler = ::std::any_of(
+        iter->first.bindings.begin(), iter->first.bindings.end(),
+        [sampler](Binding const &binding) {
+          return ::std::find(binding.immutable_samplers.begin(),
+                             binding.immutable_samplers.end(),
+                             sampler) != binding.immutable_samplers.end();
+        });
+    if (uses_sampler) {
+      evicted.push_back(iter->second);
+      iter = this->set_layouts_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  for (auto iter = this->pipeline_layouts_.begin();
+       iter != this->pipeline_layouts_.end();) {
+    auto const &set_layouts = iter->first.set_layouts;
+    auto uses_evicted = ::std::any_of(
+        set_layouts.begin(), set_layouts.end(),
+        [&evicted](::vk::DescriptorSetLayout layout) {
+          return ::std::find(evicted.begin(), evicted.end(), layout) !=
+                 evicted.end();
+        });
+    if (uses_evicted) {
+      this->device_.destroyPipelineLayout(iter->second);
+      iter = this->pipeline_layouts_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  for (auto layout : evicted) {
+    this->device_.destroyDescriptorSetLayout(layout);
+  }
+}
+
+auto LayoutCache::destroy() -> void {
+  for (auto &[key, layout] : this->pipeline_layouts_) {
+    this->device_.destroyPipelineLayout(layout);
+  }
+  this->pipeline_layouts_.clear();
+  for (auto &[key, layout] : this->set_layouts_) {
+    this->device_.destroyDescriptorSetLayout(layout);
+  }
+  this->set_layouts_.clear();
+}
+
+auto LayoutCache::Binding::operator==(Binding const &rhs) const -> bool {
+  return this->binding == rhs.binding && this->type == rhs.type &&
+         this->count == rhs.count && this->stage == rhs.stage &&
+         this->flags == rhs.flags &&
+         this->immutable_samplers == rhs.immutable_samplers;
+}
+
+auto LayoutCache::SetLayoutKey::operator==(SetLayoutKey const &rhs) const
+    -> bool {
+  return this->flags == rhs.flags && this->bindings == rhs.bindings;
+}
+
+auto LayoutCache::PipelineLayoutKey::operator==(
+    PipelineLayoutKey const &rhs) const -> bool {
+  return this->set_layouts == rhs.set_layouts && this->ranges == rhs.ranges;
+}
+
+auto LayoutCache::KeyHash::operator()(SetLayoutKey const &key) const
+    -> size_t {
+  size_t seed = hash_flags(key.flags);
+  for (auto const &binding : key.bindings) {
+    hash_combine(seed, binding.binding);
+    hash_combine(seed, static_cast<size_t>(binding.type));
+    hash_combine(seed, binding.count);
+    hash_combine(seed, hash_flags(binding.stage));
+    hash_combine(seed, hash_flags(binding.flags));
+    for (auto sampler : binding.immutable_samplers) {
+      hash_combine(seed, hash_handle(sampler));
+    }
+  }
+  return seed;
+}
+
+auto LayoutCache::KeyHash::operator()(PipelineLayoutKey const &key) const
+    -> size_t {
+  size_t seed{0};
+  for (auto set_layout : key.set_layouts) {
+    hash_combine(seed, hash_handle(set_layout));
+  }
+  for (auto const &range : key.ranges) {
+    hash_combine(seed, hash_flags(range.stageFlags));
+    hash_combine(seed, range.offset);
+    hash_combine(seed, range.size);
+  }
+  return seed;
+}
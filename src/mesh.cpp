@@ -0,0 +1,498 @@
+#include "mesh.hpp"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+uint32_t const kNone{::std::numeric_limits<uint32_t>::max()};
+
+// one OBJ face corner, 0 based, kNone where the file leaves it out
+using Corner = ::std::array<uint32_t, 3>;
+
+struct CornerHash {
+  auto operator()(Corner const &corner) const -> size_t {
+    size_t seed{0};
+    for (auto index : corner) {
+      seed ^= ::std::hash<uint32_t>{}(index) + 0x9e3779b9 + (seed << 6) +
+              (seed >> 2);
+    }
+    return seed;
+  }
+};
+
+auto skip_space(char const *cursor) -> char const * {
+  while (*cursor == ' ' || *cursor == '\t') {
+    ++cursor;
+  }
+  return cursor;
+}
+
+// OBJ indices are 1 based, negative ones count back from the last element
+auto parse_index(char const *&cursor, size_t count) -> uint32_t {
+  char *end{nullptr};
+  long index = ::strtol(cursor, &end, 10);
+  if (end == cursor) {
+    return kNone;
+  }
+  cursor = end;
+  long resolved = index < 0 ? static_cast<long>(count) + index : index - 1;
+  assert(resolved >= 0 && static_cast<size_t>(resolved) < count &&
+         "obj index out of range!");
+  return static_cast<uint32_t>(resolved);
+}
+
+auto parse_corner(char const *&cursor, size_t position_count,
+                  size_t texcoord_count, size_t normal_count) -> Corner {
+  Corner corner{kNone, kNone, kNone};
+  corner[0] = parse_index(cursor, position_count);
+  if (*cursor == '/') {
+    ++cursor;
+    corner[1] = parse_index(cursor, texcoord_count);
+    if (*cursor == '/') {
+      ++cursor;
+      corner[2] = parse_index(cursor, normal_count);
+    }
+  }
+  return corner;
+}
+
+auto parse_floats(char const *cursor, float *values, int count) -> void {
+  for (int i = 0; i < count; ++i) {
+    char *end{nullptr};
+    values[i] = ::strtof(cursor, &end);
+    cursor = end;
+  }
+}
+
+auto get_triangle_normal(::std::vector<MeshVertex> const &vertices,
+                         uint32_t const *triangle) -> ::glm::vec3 {
+  auto const &a = vertices[triangle[0]].position;
+  auto const &b = vertices[triangle[1]].position;
+  auto const &c = vertices[triangle[2]].position;
+  // length is twice the area, larger triangles weigh more
+  return ::glm::cross(b - a, c - a);
+}
+
+// cache misses of every triangle through a FIFO cache
+auto simulate_cache(::std::vector<uint32_t> const &indices,
+                    size_t vertex_count, uint32_t cache_size)
+    -> ::std::vector<uint8_t> {
+  ::std::vector<uint32_t> stamps(vertex_count, 0);
+  uint32_t time{cache_size + 1};
+  ::std::vector<uint8_t> misses(indices.size() / 3, 0);
+  for (size_t i = 0; i < indices.size(); ++i) {
+    auto vertex = indices[i];
+    if (time - stamps[vertex] > cache_size) {
+      stamps[vertex] = time++;
+      ++misses[i / 3];
+    }
+  }
+  return misses;
+}
+
+} // namespace
+
+auto load_obj(::std::filesystem::path const &filename) -> Mesh {
+  ::std::ifstream ifs{filename, ::std::ios::in};
+  assert(ifs && "obj open failed!");
+
+  ::std::vector<::glm::vec3> positions;
+  ::std::vector<::glm::vec2> texcoords;
+  ::std::vector<::glm::vec3> normals;
+  Mesh mesh;
+  // the position of every vertex, smooth normals are summed per position
+  ::std::vector<uint32_t> vertex_positions;
+  bool missing_normals{false};
+  ::std::unordered_map<Corner, uint32_t, CornerHash> vertices;
+  ::std::vector<uint32_t> polygon;
+
+  ::std::string line;
+  while (::std::getline(ifs, line)) {
+    char const *cursor = skip_space(line.c_str());
+    if (cursor[0] == 'v' && cursor[1] == ' ') {
+      ::glm::vec3 position{0.f};
+      parse_floats(cursor + 2, &position.x, 3);
+      positions.push_back(position);
+    } else if (cursor[0] == 'v' && cursor[1] == 't') {
+      ::glm::vec2 texcoord{0.f};
+      parse_floats(cursor + 2, &texcoord.x, 2);
+      texcoords.emplace_back(texcoord.x, 1.f - texcoord.y);
+    } else if (cursor[0] == 'v' && cursor[1] == 'n') {
+      ::glm::vec3 normal{0.f};
+      parse_floats(cursor + 2, &normal.x, 3);
+      normals.push_back(normal);
+    } else if (cursor[0] == 'f' && cursor[1] == ' ') {
+      polygon.clear();
+      cursor = skip_space(cursor + 1);
+      while (*cursor != '\0' && *cursor != '\r') {
+        auto corner = parse_corner(cursor, positions.size(), texcoords.size(),
+                                   normals.size());
+        if (corner[0] == kNone) {
+          assert(*cursor == '#' && "obj face parse failed!");
+          break;
+        }
+        auto [iter, inserted] = vertices.emplace(
+            corner, static_cast<uint32_t>(mesh.vertices.size()));
+        if (inserted) {
+          MeshVertex vertex{positions[corner[0]], ::glm::vec3{0.f},
+                            ::glm::vec2{0.f}};
+          if (corner[1] != kNone) {
+            vertex.texcoord = texcoords[corner[1]];
+          }
+          if (corner[2] != kNone) {
+            vertex.normal = normals[corner[2]];
+          } else {
+            missing_normals = true;
+          }
+          mesh.vertices.push_back(vertex);
+          vertex_positions.push_back(corner[0]);
+        }
+        polygon.push_back(iter->second);
+        cursor = skip_space(cursor);
+      }
+      for (size_t i = 2; i < polygon.size(); ++i) {
+        mesh.indices.insert(mesh.indices.end(),
+                            {polygon[0], polygon[i - 1], polygon[i]});
+      }
+    }
+  }
+
+  if (missing_normals) {
+    ::std::vector<::glm::vec3> smooth(positions.size(), ::glm::vec3{0.f});
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+      auto normal = get_triangle_normal(mesh.vertices, &mesh.indices[i]);
+      for (size_t k = 0; k < 3; ++k) {
+        smooth[vertex_positions[mesh.indices[i + k]]] += normal;
+      }
+    }
+    for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+      auto &vertex = mesh.vertices[i];
+      auto const &normal = smooth[vertex_positions[i]];
+      if (vertex.normal == ::glm::vec3{0.f} && ::glm::dot(normal, normal) > 0) {
+        vertex.normal = ::glm::normalize(normal);
+      }
+    }
+  }
+  return mesh;
+}
+
+auto load_mesh(::std::filesystem::path const &filename) -> Mesh {
+  Mesh mesh = load_obj(filename);
+  optimize_mesh(mesh);
+  return mesh;
+}
+
+auto deduplicate_vertices(Mesh &mesh) -> void {
+  auto const &vertices = mesh.vertices;
+  auto hash = [&vertices](uint32_t index) {
+    return ::std::hash<::std::string_view>{}(::std::string_view{
+        reinterpret_cast<char const *>(&vertices[index]), sizeof(MeshVertex)});
+  };
+  auto equal = [&vertices](uint32_t lhs, uint32_t rhs) {
+    return ::memcmp(&vertices[lhs], &vertices[rhs], sizeof(MeshVertex)) == 0;
+  };
+  // keyed by the first vertex of every distinct value
+  ::std::unordered_map<uint32_t, uint32_t, decltype(hash), decltype(equal)>
+      unique(vertices.size(), hash, equal);
+  ::std::vector<uint32_t> remap(vertices.size());
+  ::std::vector<MeshVertex> merged;
+  for (uint32_t i = 0; i < vertices.size(); ++i) {
+    auto [iter, inserted] =
+        unique.emplace(i, static_cast<uint32_t>(merged.size()));
+    if (inserted) {
+      merged.push_back(vertices[i]);
+    }
+    remap[i] = iter->second;
+  }
+  for (auto &index : mesh.indices) {
+    index = remap[index];
+  }
+  mesh.vertices = ::std::move(merged);
+}
+
+auto optimize_vertex_cache(::std::vector<uint32_t> &indices,
+                           size_t vertex_count, uint32_t cache_size) -> void {
+  // triangles around every vertex, and how many of them are not emitted yet
+  ::std::vector<uint32_t> live(vertex_count, 0);
+  for (auto index : indices) {
+    ++live[index];
+  }
+  ::std::vector<uint32_t> offsets(vertex_count + 1, 0);
+  ::std::partial_sum(live.begin(), live.end(), offsets.begin() + 1);
+  ::std::vector<uint32_t> adjacency(indices.size());
+  {
+    ::std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i) {
+      adjacency[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+
+  ::std::vector<uint32_t> stamps(vertex_count, 0);
+  uint32_t time{cache_size + 1};
+  ::std::vector<uint8_t> emitted(indices.size() / 3, 0);
+  ::std::vector<uint32_t> dead_ends;
+  ::std::vector<uint32_t> candidates;
+  ::std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  size_t scan{0};
+  auto next_unemitted = [&] {
+    for (; scan < vertex_count; ++scan) {
+      if (live[scan] > 0) {
+        return static_cast<uint32_t>(scan);
+      }
+    }
+    return kNone;
+  };
+
+  uint32_t fan = next_unemitted();
+  while (fan != kNone) {
+    // emit the whole fan, its vertices become candidates for the next one
+    candidates.clear();
+    for (uint32_t k = offsets[fan]; k < offsets[fan + 1]; ++k) {
+      uint32_t triangle = adjacency[k];
+      if (emitted[triangle] != 0) {
+        continue;
+      }
+      emitted[triangle] = 1;
+      for (size_t c = 0; c < 3; ++c) {
+        uint32_t vertex = indices[triangle * 3 + c];
+        result.push_back(vertex);
+        dead_ends.push_back(vertex);
+        candidates.push_back(vertex);
+        --live[vertex];
+        if (time - stamps[vertex] > cache_size) {
+          stamps[vertex] = time++;
+        }
+      }
+    }
+
+    // the candidate whose fan still fits in the cache and entered it
+    // earliest, so that its remaining triangles reuse it before eviction
+    fan = kNone;
+    uint32_t best_priority{0};
+    for (auto vertex : candidates) {
+      if (live[vertex] == 0) {
+        continue;
+      }
+      uint32_t priority{1};
+      uint32_t age = time - stamps[vertex];
+      if (age + 2 * live[vertex] <= cache_size) {
+        priority += age;
+      }
+      if (priority > best_priority) {
+        fan = vertex;
+        best_priority = priority;
+      }
+    }
+    while (fan == kNone && !dead_ends.empty()) {
+      uint32_t vertex = dead_ends.back();
+      dead_ends.pop_back();
+      if (live[vertex] > 0) {
+        fan = vertex;
+      }
+    }
+    if (fan == kNone) {
+      fan = next_unemitted();
+    }
+  }
+  indices = ::std::move(result);
+}
+
+auto optimize_overdraw(::std::vector<uint32_t> &indices,
+                       ::std::vector<MeshVertex> const &vertices,
+                       float threshold) -> void {
+  size_t triangle_count = indices.size() / 3;
+  if (triangle_count < 2) {
+    return;
+  }
+  uint32_t const cache_size{16};
+  auto misses = simulate_cache(indices, vertices.size(), cache_size);
+
+  // a triangle missing all three vertices starts over, splitting there costs
+  // nothing. Runs are split further while a cluster, drawn with a cold
+  // cache, misses at most threshold times the average of its run.
+  ::std::vector<size_t> clusters;
+  ::std::vector<uint32_t> stamps(vertices.size(), 0);
+  uint32_t time{cache_size + 1};
+  size_t run{0};
+  while (run < triangle_count) {
+    size_t run_end{run + 1};
+    size_t run_misses = misses[run];
+    while (run_end < triangle_count && misses[run_end] < 3) {
+      run_misses += misses[run_end++];
+    }
+    float limit = threshold * static_cast<float>(run_misses) /
+                  static_cast<float>(run_end - run);
+    size_t start{run};
+    size_t cluster_misses{0};
+    time += cache_size + 1;
+    for (size_t t = run; t < run_end; ++t) {
+      if (t == start) {
+        clusters.push_back(start);
+      }
+      for (size_t c = 0; c < 3; ++c) {
+        uint32_t vertex = indices[t * 3 + c];
+        if (time - stamps[vertex] > cache_size) {
+          stamps[vertex] = time++;
+          ++cluster_misses;
+        }
+      }
+      if (static_cast<float>(cluster_misses) <=
+          limit * static_cast<float>(t + 1 - start)) {
+        start = t + 1;
+        cluster_misses = 0;
+        time += cache_size + 1;
+      }
+    }
+    run = run_end;
+  }
+  clusters.push_back(triangle_count);
+
+  // area weighted centroids and normals
+  ::glm::vec3 mesh_centroid{0.f};
+  float mesh_area{0.f};
+  size_t cluster_count = clusters.size() - 1;
+  ::std::vector<float> keys(cluster_count);
+  ::std::vector<::glm::vec3> centroids(cluster_count, ::glm::vec3{0.f});
+  ::std::vector<::glm::vec3> normals(cluster_count, ::glm::vec3{0.f});
+  for (size_t c = 0; c < cluster_count; ++c) {
+    float area{0.f};
+    for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+      auto const *triangle = &indices[t * 3];
+      auto normal = get_triangle_normal(vertices, triangle);
+      float weight = ::glm::length(normal);
+      auto center = (vertices[triangle[0]].position +
+                     vertices[triangle[1]].position +
+                     vertices[triangle[2]].position) /
+                    3.f;
+      centroids[c] += center * weight;
+      normals[c] += normal;
+      area += weight;
+    }
+    mesh_centroid += centroids[c];
+    mesh_area += area;
+    if (area > 0.f) {
+      centroids[c] /= area;
+    }
+  }
+  if (mesh_area > 0.f) {
+    mesh_centroid /= mesh_area;
+  }
+  for (size_t c = 0; c < cluster_count; ++c) {
+    float length = ::glm::length(normals[c]);
+    keys[c] = length > 0.f ? ::glm::dot(centroids[c] - mesh_centroid,
+                                        normals[c] / length)
+                           : 0.f;
+  }
+
+  // outward facing clusters first, they occlude the rest
+  ::std::vector<uint32_t> order(cluster_count);
+  ::std::iota(order.begin(), order.end(), 0);
+  ::std::stable_sort(order.begin(), order.end(),
+                     [&keys](uint32_t lhs, uint32_t rhs) {
+                       return keys[lhs] > keys[rhs];
+                     });
+  ::std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  for (auto c : order) {
+    result.insert(result.end(),
+                  indices.begin() + static_cast<ptrdiff_t>(clusters[c] * 3),
+                  indices.begin() +
+                      static_cast<ptrdiff_t>(clusters[c + 1] * 3));
+  }
+  indices = ::std::move(result);
+}
+
+auto optimize_vertex_fetch(Mesh &mesh) -> void {
+  ::std::vector<uint32_t> remap(mesh.vertices.size(), kNone);
+  ::std::vector<MeshVertex> ordered;
+  ordered.reserve(mesh.vertices.size());
+  for (auto &index : mesh.indices) {
+    if (remap[index] == kNone) {
+      remap[index] = static_cast<uint32_t>(ordered.size());
+      ordered.push_back(mesh.vertices[index]);
+    }
+    index = remap[index];
+  }
+  mesh.vertices = ::std::move(ordered);
+}
+
+auto optimize_mesh(Mesh &mesh) -> void {
+  deduplicate_vertices(mesh);
+  optimize_vertex_cache(mesh.indices, mesh.vertices.size());
+  optimize_overdraw(mesh.indices, mesh.vertices);
+  optimize_vertex_fetch(mesh);
+}
+
+auto get_acmr(::std::vector<uint32_t> const &indices, size_t vertex_count,
+              uint32_t cache_size) -> float {
+  if (indices.size() < 3) {
+    return 0.f;
+  }
+  auto misses = simulate_cache(indices, vertex_count, cache_size);
+  size_t total{0};
+  for (auto miss : misses) {
+    total += miss;
+  }
+  return static_cast<float>(total) / static_cast<float>(misses.size());
+}
+
+auto pack_vertex(MeshVertex const &vertex) -> PackedMeshVertex {
+  return PackedMeshVertex{
+      vertex.position,
+      Unorm1010102{::glm::vec4{vertex.normal * .5f + .5f, 0.f}},
+      Half2{vertex.texcoord},
+  };
+}
+
+auto get_index_type(Mesh const &mesh) -> ::vk::IndexType {
+  return mesh.vertices.size() <= 0x10000 ? ::vk::IndexType::eUint16
+                                         : ::vk::IndexType::eUint32;
+}
+
+auto wrap_mesh(::vk::PhysicalDevice &physical, ::vk::Device &device,
+               QueueFamilyIndices &indices, Mesh const &mesh)
+    -> ::std::vector<::std::tuple<::vk::Buffer, ::vk::DeviceMemory,
+                                  ::vk::Buffer, ::vk::DeviceSize>> {
+  // wrap_buffer stages right away, the converted copies may go out of scope
+  ::std::vector<PackedMeshVertex> packed;
+  packed.reserve(mesh.vertices.size());
+  ::std::transform(mesh.vertices.begin(), mesh.vertices.end(),
+                   ::std::back_inserter(packed), pack_vertex);
+  ::std::vector buffers{
+      wrap_buffer(physical, device, indices, packed.data(), packed.size(),
+                  ::vk::BufferUsageFlagBits::eVertexBuffer),
+  };
+  if (get_index_type(mesh) == ::vk::IndexType::eUint16) {
+    ::std::vector<uint16_t> narrow(mesh.indices.begin(), mesh.indices.end());
+    buffers.push_back(wrap_buffer(physical, device, indices, narrow.data(),
+                                  narrow.size(),
+                                  ::vk::BufferUsageFlagBits::eIndexBuffer));
+  } else {
+    buffers.push_back(wrap_buffer(physical, device, indices,
+                                  mesh.indices.data(), mesh.indices.size(),
+                                  ::vk::BufferUsageFlagBits::eIndexBuffer));
+  }
+  return buffers;
+}
+
+auto get_mesh_input_description()
+    -> ::std::pair<::std::array<::vk::VertexInputAttributeDescription, 3>,
+                   ::vk::VertexInputBindingDescription> {
+  return get_vertex_layout<&PackedMeshVertex::position,
+                           &PackedMeshVertex::normal,
+                           &PackedMeshVertex::texcoord>();
+}
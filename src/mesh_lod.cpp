@@ -0,0 +1,549 @@
+#include "mesh_lod.hpp"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+uint32_t const kNone{::std::numeric_limits<uint32_t>::max()};
+
+// open edges pull the collapse cost up by this much, so that the outline
+// survives longer than the surface inside it
+float const kBorderWeight{10.f};
+
+// The sum of squared distances to a set of planes, weighted by their area,
+// as the symmetric matrix [a b; b^T c].
+struct Quadric {
+  float a00, a11, a22, a01, a02, a12;
+  float b0, b1, b2;
+  float c;
+  float weight;
+};
+
+auto make_quadric(::glm::vec3 const &normal, float distance, float weight)
+    -> Quadric {
+  auto n = normal * weight;
+  return Quadric{n.x * normal.x,   n.y * normal.y,   n.z * normal.z,
+                 n.x * normal.y,   n.x * normal.z,   n.y * normal.z,
+                 n.x * distance,   n.y * distance,   n.z * distance,
+                 weight * distance * distance, weight};
+}
+
+auto operator+=(Quadric &lhs, Quadric const &rhs) -> Quadric & {
+  lhs.a00 += rhs.a00;
+  lhs.a11 += rhs.a11;
+  lhs.a22 += rhs.a22;
+  lhs.a01 += rhs.a01;
+  lhs.a02 += rhs.a02;
+  lhs.a12 += rhs.a12;
+  lhs.b0 += rhs.b0;
+  lhs.b1 += rhs.b1;
+  lhs.b2 += rhs.b2;
+  lhs.c += rhs.c;
+  lhs.weight += rhs.weight;
+  return lhs;
+}
+
+// mean squared distance of p to the planes
+auto get_error(Quadric const &q, ::glm::vec3 const &p) -> float {
+  float rx = q.a00 * p.x + q.a01 * p.y + q.a02 * p.z + 2.f * q.b0;
+  float ry = q.a01 * p.x + q.a11 * p.y + q.a12 * p.z + 2.f * q.b1;
+  float rz = q.a02 * p.x + q.a12 * p.y + q.a22 * p.z + 2.f * q.b2;
+  float error = rx * p.x + ry * p.y + rz * p.z + q.c;
+  return q.weight > 0.f ? ::std::fabs(error) / q.weight : 0.f;
+}
+
+enum class VertexKind : uint8_t {
+  // inside the surface, collapses onto any neighbour
+  eManifold,
+  // on one open edge loop, collapses along it
+  eBorder,
+  // on a UV seam or where the surface is not a manifold
+  eLocked,
+};
+
+// positions, seams are never collapsed so each has one vertex to remap
+struct Collapse {
+  uint32_t from;
+  uint32_t to;
+  float error;
+};
+
+// The first vertex of every position, so that vertices split by a seam
+// still count as one point of the surface.
+auto get_position_remap(::std::vector<MeshVertex> const &vertices)
+    -> ::std::vector<uint32_t> {
+  struct PositionHash {
+    auto operator()(::glm::vec3 const &position) const -> size_t {
+      size_t seed{0};
+      for (int i = 0; i < 3; ++i) {
+        seed ^= ::std::hash<float>{}(position[i]) + 0x9e3779b9 +
+                (seed << 6) + (seed >> 2);
+      }
+      return seed;
+    }
+  };
+  ::std::unordered_map<::glm::vec3, uint32_t, PositionHash> firsts;
+  firsts.reserve(vertices.size());
+  ::std::vector<uint32_t> remap(vertices.size());
+  for (uint32_t v = 0; v < vertices.size(); ++v) {
+    remap[v] = firsts.emplace(vertices[v].position, v).first->second;
+  }
+  return remap;
+}
+
+// one triangle around a position, the corners after and before it in
+// winding order, as positions and as vertices
+struct Neighbour {
+  uint32_t next;
+  uint32_t prev;
+  uint32_t next_vertex;
+  uint32_t prev_vertex;
+};
+
+// the neighbours of every position, all of a position's are adjacent
+struct Adjacency {
+  ::std::vector<uint32_t> offsets;
+  ::std::vector<Neighbour> neighbours;
+
+  auto begin(uint32_t position) const -> Neighbour const * {
+    return neighbours.data() + offsets[position];
+  }
+  auto end(uint32_t position) const -> Neighbour const * {
+    return neighbours.data() + offsets[position + 1];
+  }
+};
+
+auto build_adjacency(::std::vector<uint32_t> const &indices,
+                     ::std::vector<uint32_t> const &positions,
+                     Adjacency &adjacency) -> void {
+  auto &offsets = adjacency.offsets;
+  offsets.assign(positions.size() + 1, 0);
+  for (auto index : indices) {
+    ++offsets[positions[index]];
+  }
+  ::std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  // filled back to front, every offset ends up at its first neighbour
+  adjacency.neighbours.resize(indices.size());
+  for (size_t i = indices.size(); i-- > 0;) {
+    size_t first = i - i % 3;
+    auto next = indices[first + (i + 1) % 3];
+    auto prev = indices[first + (i + 2) % 3];
+    adjacency.neighbours[--offsets[positions[indices[i]]]] =
+        Neighbour{positions[next], positions[prev], next, prev};
+  }
+}
+
+// is the edge to a neighbour open, i.e. only one triangle runs along it
+auto is_open_edge(Neighbour const *begin, Neighbour const *end, uint32_t to)
+    -> bool {
+  bool leaving{false};
+  bool arriving{false};
+  for (auto const *neighbour = begin; neighbour != end; ++neighbour) {
+    leaving = leaving || neighbour->next == to;
+    arriving = arriving || neighbour->prev == to;
+  }
+  return leaving != arriving;
+}
+
+// The kind of every position in use, and the vertex there.
+auto classify_positions(::std::vector<uint32_t> const &indices,
+                        ::std::vector<uint32_t> const &positions,
+                        Adjacency const &adjacency,
+                        ::std::vector<VertexKind> &kinds,
+                        ::std::vector<uint32_t> &wedges) -> void {
+  size_t vertex_count = positions.size();
+  kinds.assign(vertex_count, VertexKind::eManifold);
+  wedges.assign(vertex_count, kNone);
+  for (auto index : indices) {
+    auto &wedge = wedges[positions[index]];
+    if (wedge == kNone) {
+      wedge = index;
+    } else if (wedge != index) {
+      kinds[positions[index]] = VertexKind::eLocked;
+    }
+  }
+  for (uint32_t p = 0; p < vertex_count; ++p) {
+    if (wedges[p] == kNone || kinds[p] == VertexKind::eLocked) {
+      continue;
+    }
+    uint32_t openings{0};
+    for (auto const *neighbour = adjacency.begin(p);
+         neighbour != adjacency.end(p); ++neighbour) {
+      openings += is_open_edge(adjacency.begin(p), adjacency.end(p),
+                               neighbour->next);
+    }
+    if (openings > 1) {
+      kinds[p] = VertexKind::eLocked;
+    } else if (openings == 1) {
+      kinds[p] = VertexKind::eBorder;
+    }
+  }
+}
+
+// would moving from onto to turn one of from's other triangles over
+auto is_flipping(::std::vector<::glm::vec3> const &points,
+                 Adjacency const &adjacency, uint32_t from, uint32_t to)
+    -> bool {
+  auto source = points[from];
+  auto target = points[to];
+  for (auto const *neighbour = adjacency.begin(from);
+       neighbour != adjacency.end(from); ++neighbour) {
+    if (neighbour->next == to || neighbour->prev == to) {
+      // collapses with the edge
+      continue;
+    }
+    auto p1 = points[neighbour->next];
+    auto p2 = points[neighbour->prev];
+    auto before = ::glm::cross(p1 - source, p2 - p1);
+    auto after = ::glm::cross(p1 - target, p2 - p1);
+    if (::glm::dot(before, after) <= 0.f) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+auto simplify_mesh(::std::vector<uint32_t> const &indices,
+                   ::std::vector<MeshVertex> const &vertices,
+                   size_t target_index_count, float target_error)
+    -> SimplifyResult {
+  assert(indices.size() % 3 == 0 && "simplify_mesh failed!");
+  size_t vertex_count = vertices.size();
+  SimplifyResult result{indices, 0.f};
+  if (indices.size() <= target_index_count || vertex_count == 0) {
+    return result;
+  }
+
+  // errors are measured in a unit cube so that target_error is relative
+  ::glm::vec3 lower{::std::numeric_limits<float>::max()};
+  ::glm::vec3 upper{::std::numeric_limits<float>::lowest()};
+  for (auto const &vertex : vertices) {
+    lower = ::glm::min(lower, vertex.position);
+    upper = ::glm::max(upper, vertex.position);
+  }
+  float extent = ::std::max({upper.x - lower.x, upper.y - lower.y,
+                             upper.z - lower.z, 1e-20f});
+  ::std::vector<::glm::vec3> points(vertex_count);
+  for (size_t v = 0; v < vertex_count; ++v) {
+    points[v] = (vertices[v].position - lower) / extent;
+  }
+  auto positions = get_position_remap(vertices);
+
+  // planes of the triangles around every position, and for open edges a
+  // plane through the edge upright on its triangle
+  auto &work = result.indices;
+  Adjacency adjacency;
+  build_adjacency(work, positions, adjacency);
+  ::std::vector<Quadric> quadrics(vertex_count, Quadric{});
+  for (size_t i = 0; i < work.size(); i += 3) {
+    ::std::array<uint32_t, 3> corners{positions[work[i]],
+                                      positions[work[i + 1]],
+                                      positions[work[i + 2]]};
+    auto normal = ::glm::cross(points[corners[1]] - points[corners[0]],
+                               points[corners[2]] - points[corners[0]]);
+    float area = ::glm::length(normal);
+    if (area > 0.f) {
+      normal /= area;
+      auto quadric = make_quadric(
+          normal, -::glm::dot(normal, points[corners[0]]), area * .5f);
+      for (auto corner : corners) {
+        quadrics[corner] += quadric;
+      }
+    }
+    for (size_t e = 0; e < 3; ++e) {
+      auto from = corners[e];
+      auto to = corners[(e + 1) % 3];
+      if (!is_open_edge(adjacency.begin(from), adjacency.end(from), to)) {
+        continue;
+      }
+      auto edge = points[to] - points[from];
+      float length = ::glm::length(edge);
+      auto upright = ::glm::cross(edge, normal);
+      float upright_length = ::glm::length(upright);
+      if (length == 0.f || upright_length == 0.f) {
+        continue;
+      }
+      upright /= upright_length;
+      auto quadric =
+          make_quadric(upright, -::glm::dot(upright, points[from]),
+                       length * length * kBorderWeight);
+      quadrics[from] += quadric;
+      quadrics[to] += quadric;
+    }
+  }
+
+  float error_limit = target_error * target_error;
+  float max_error{0.f};
+  ::std::vector<VertexKind> kinds;
+  ::std::vector<uint32_t> wedges;
+  ::std::vector<Collapse> collapses;
+  ::std::vector<uint32_t> remap(vertex_count);
+  ::std::vector<uint8_t> locked(vertex_count);
+  // every pass collapses an independent set of edges, cheapest first, then
+  // rebuilds the adjacency
+  while (work.size() > target_index_count) {
+    classify_positions(work, positions, adjacency, kinds, wedges);
+
+    // the cheapest collapse of every position that turns no triangle over,
+    // border positions only move along an open edge
+    collapses.clear();
+    for (uint32_t from = 0; from < vertex_count; ++from) {
+      auto kind = kinds[from];
+      if (wedges[from] == kNone || kind == VertexKind::eLocked) {
+        continue;
+      }
+      Collapse cheapest{from, kNone, error_limit};
+      for (auto const *neighbour = adjacency.begin(from);
+           neighbour != adjacency.end(from); ++neighbour) {
+        for (auto to : {neighbour->next, neighbour->prev}) {
+          if (kind == VertexKind::eBorder &&
+              !is_open_edge(adjacency.begin(from), adjacency.end(from), to)) {
+            continue;
+          }
+          auto quadric = quadrics[from];
+          quadric += quadrics[to];
+          float error = get_error(quadric, points[to]);
+          if ((error < cheapest.error ||
+               (error == cheapest.error && cheapest.to == kNone)) &&
+              !is_flipping(points, adjacency, from, to)) {
+            cheapest = Collapse{from, to, error};
+          }
+        }
+      }
+      if (cheapest.to != kNone) {
+        collapses.push_back(cheapest);
+      }
+    }
+    if (collapses.empty()) {
+      break;
+    }
+    ::std::sort(collapses.begin(), collapses.end(),
+                [](Collapse const &lhs, Collapse const &rhs) {
+                  return lhs.error < rhs.error;
+                });
+
+    // A collapse removes about two triangles. Past half again the error
+    // that would reach the goal, the next pass may find cheaper ones.
+    size_t goal = (work.size() - target_index_count) / 3;
+    float pass_limit =
+        collapses[::std::min(goal / 2, collapses.size() - 1)].error * 1.5f;
+    ::std::iota(remap.begin(), remap.end(), 0);
+    ::std::fill(locked.begin(), locked.end(), 0);
+    size_t removed{0};
+    for (auto const &collapse : collapses) {
+      if (removed >= goal || (removed > 0 && collapse.error > pass_limit)) {
+        break;
+      }
+      auto from = collapse.from;
+      auto to = collapse.to;
+      if (locked[from] || locked[to]) {
+        continue;
+      }
+      // the ring keeps its positions until the pass ends
+      locked[from] = 1;
+      uint32_t target{kNone};
+      for (auto const *neighbour = adjacency.begin(from);
+           neighbour != adjacency.end(from); ++neighbour) {
+        locked[neighbour->next] = 1;
+        locked[neighbour->prev] = 1;
+        if (neighbour->next == to) {
+          target = neighbour->next_vertex;
+        } else if (neighbour->prev == to) {
+          target = neighbour->prev_vertex;
+        } else {
+          continue;
+        }
+        ++removed;
+      }
+      remap[wedges[from]] = target;
+      quadrics[to] += quadrics[from];
+      max_error = ::std::max(max_error, collapse.error);
+    }
+    if (removed == 0) {
+      break;
+    }
+
+    size_t kept{0};
+    for (size_t i = 0; i < work.size(); i += 3) {
+      ::std::array<uint32_t, 3> triangle{remap[work[i]], remap[work[i + 1]],
+                                         remap[work[i + 2]]};
+      if (positions[triangle[0]] == positions[triangle[1]] ||
+          positions[triangle[1]] == positions[triangle[2]] ||
+          positions[triangle[2]] == positions[triangle[0]]) {
+        continue;
+      }
+      ::std::copy(triangle.begin(), triangle.end(), work.begin() + kept);
+      kept += 3;
+    }
+    work.resize(kept);
+    build_adjacency(work, positions, adjacency);
+  }
+  result.error = ::std::sqrt(max_error) * extent;
+  return result;
+}
+
+auto build_lods(Mesh &mesh, size_t max_count, float ratio)
+    -> ::std::vector<MeshLod> {
+  assert(ratio > 0.f && ratio < 1.f && "build_lods failed!");
+  ::std::vector<MeshLod> lods{
+      MeshLod{0, static_cast<uint32_t>(mesh.indices.size()), 0.f}};
+  ::std::vector<uint32_t> source = mesh.indices;
+  float error{0.f};
+  while (lods.size() < max_count) {
+    auto target = static_cast<size_t>(static_cast<float>(source.size()) *
+                                      ratio) /
+                  3 * 3;
+    auto simplified = simplify_mesh(source, mesh.vertices, target, 1.f);
+    if (simplified.indices.empty() ||
+        simplified.indices.size() * 10 > source.size() * 9) {
+      break;
+    }
+    // each level simplifies the one before, so the errors add up
+    error += simplified.error;
+    optimize_vertex_cache(simplified.indices, mesh.vertices.size());
+    lods.push_back(MeshLod{static_cast<uint32_t>(mesh.indices.size()),
+                           static_cast<uint32_t>(simplified.indices.size()),
+                           error});
+    mesh.indices.insert(mesh.indices.end(), simplified.indices.begin(),
+                        simplified.indices.end());
+    source = ::std::move(simplified.indices);
+  }
+  return lods;
+}
+
+auto get_lod_scale(float fovy, float viewport_height) -> float {
+  return viewport_height / (2.f * ::std::tan(fovy * .5f));
+}
+
+auto select_lod(::std::vector<MeshLod> const &lods, float pixel_scale,
+                float max_pixels) -> size_t {
+  size_t selected{0};
+  for (size_t l = 1; l < lods.size(); ++l) {
+    if (lods[l].error * pixel_scale > max_pixels) {
+      break;
+    }
+    selected = l;
+  }
+  return selected;
+}
+
+auto build_meshlets(uint32_t const *indices, size_t index_count,
+                    ::std::vector<MeshVertex> const &vertices,
+                    size_t max_vertices, size_t max_triangles) -> Meshlets {
+  assert(max_vertices >= 3 && max_vertices < 0xff && max_triangles > 0 &&
+         "build_meshlets failed!");
+  Meshlets result;
+  ::std::vector<uint8_t> slots(vertices.size(), 0xff);
+  Meshlet current{0, 0, 0, 0};
+  auto finish = [&]() {
+    if (current.triangle_count == 0) {
+      return;
+    }
+    auto const *locals = &result.vertices[current.vertex_offset];
+    for (uint32_t v = 0; v < current.vertex_count; ++v) {
+      slots[locals[v]] = 0xff;
+    }
+
+    // the box center is close enough to the smallest sphere
+    ::glm::vec3 lower{::std::numeric_limits<float>::max()};
+    ::glm::vec3 upper{::std::numeric_limits<float>::lowest()};
+    for (uint32_t v = 0; v < current.vertex_count; ++v) {
+      lower = ::glm::min(lower, vertices[locals[v]].position);
+      upper = ::glm::max(upper, vertices[locals[v]].position);
+    }
+    MeshletBounds bounds{(lower + upper) * .5f, 0.f, ::glm::vec3{0.f}, 1.f};
+    for (uint32_t v = 0; v < current.vertex_count; ++v) {
+      bounds.radius =
+          ::std::max(bounds.radius, ::glm::length(vertices[locals[v]].position -
+                                                  bounds.center));
+    }
+
+    // the cone axis averages the unit normals, the cutoff is the sine of
+    // the widest angle between them, so that the test above only passes
+    // when the eye is behind every triangle
+    ::std::vector<::glm::vec3> normals;
+    normals.reserve(current.triangle_count);
+    for (uint32_t t = 0; t < current.triangle_count; ++t) {
+      auto const *triangle =
+          &result.triangles[(current.triangle_offset + t) * 3];
+      auto const &p0 = vertices[locals[triangle[0]]].position;
+      auto normal = ::glm::cross(vertices[locals[triangle[1]]].position - p0,
+                                 vertices[locals[triangle[2]]].position - p0);
+      float length = ::glm::length(normal);
+      if (length > 0.f) {
+        normals.push_back(normal / length);
+        bounds.cone_axis += normals.back();
+      }
+    }
+    float axis_length = ::glm::length(bounds.cone_axis);
+    if (axis_length > 0.f) {
+      bounds.cone_axis /= axis_length;
+      float min_dot{1.f};
+      for (auto const &normal : normals) {
+        min_dot = ::std::min(min_dot, ::glm::dot(normal, bounds.cone_axis));
+      }
+      if (min_dot > 0.f) {
+        bounds.cone_cutoff = ::std::sqrt(1.f - min_dot * min_dot);
+      }
+    }
+
+    result.meshlets.push_back(current);
+    result.bounds.push_back(bounds);
+    current = Meshlet{static_cast<uint32_t>(result.vertices.size()),
+                      static_cast<uint32_t>(result.triangles.size() / 3), 0,
+                      0};
+  };
+
+  for (size_t i = 0; i + 2 < index_count; i += 3) {
+    uint32_t fresh{0};
+    for (size_t c = 0; c < 3; ++c) {
+      fresh += slots[indices[i + c]] == 0xff;
+    }
+    if (current.vertex_count + fresh > max_vertices ||
+        current.triangle_count + 1 > max_triangles) {
+      finish();
+    }
+    for (size_t c = 0; c < 3; ++c) {
+      auto &slot = slots[indices[i + c]];
+      if (slot == 0xff) {
+        slot = static_cast<uint8_t>(current.vertex_count++);
+        result.vertices.push_back(indices[i + c]);
+      }
+      result.triangles.push_back(slot);
+    }
+    ++current.triangle_count;
+  }
+  finish();
+  return result;
+}
+
+auto is_meshlet_backfacing(MeshletBounds const &bounds, ::glm::vec3 const &eye)
+    -> bool {
+  auto view = bounds.center - eye;
+  return ::glm::dot(view, bounds.cone_axis) >=
+         bounds.cone_cutoff * ::glm::length(view) + bounds.radius;
+}
+
+auto get_meshlet_indices(Meshlets const &meshlets) -> ::std::vector<uint32_t> {
+  ::std::vector<uint32_t> indices;
+  indices.reserve(meshlets.triangles.size());
+  for (auto const &meshlet : meshlets.meshlets) {
+    for (uint32_t i = 0; i < meshlet.triangle_count * 3; ++i) {
+      indices.push_back(
+          meshlets.vertices[meshlet.vertex_offset +
+                            meshlets.triangles[meshlet.triangle_offset * 3 +
+                                               i]]);
+    }
+  }
+  return indices;
+}
@@ -0,0 +1,210 @@
+#include "occlusion_culling.hpp"
+
+#include <assert.h>
+
+#include <tuple>
+
+namespace {
+
+uint32_t const kWorkgroupSize{64};
+
+// push constants of the occlusion cull.comp
+struct OcclusionConstants {
+  ::glm::mat4 view;
+  float p00;
+  float p11;
+  float p22;
+  float p32;
+  float z_near;
+  uint32_t object_count;
+  uint32_t width;
+  uint32_t height;
+  uint32_t phase;
+};
+
+auto align_up(::vk::DeviceSize value, ::vk::DeviceSize alignment)
+    -> ::vk::DeviceSize {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+OcclusionCuller::OcclusionCuller(
+    ::vk::PhysicalDevice &physical, ::vk::Device &device,
+    QueueFamilyIndices &indices, ::vk::CommandPool &pool, ::vk::Queue &queue,
+    LayoutCache &layouts, DescriptorAllocator &descriptors,
+    ::std::filesystem::path const &shader,
+    ::std::vector<DrawObject> const &objects, DepthPyramid const &pyramid,
+    ::vk::Extent2D const &extent, uint32_t frame_count,
+    DeviceFeatures const &features)
+    : device_{device}, draw_count_{features.draw_indirect_count},
+      object_count_{static_cast<uint32_t>(objects.size())}, extent_{extent} {
+  assert(features.multi_draw_indirect &&
+         "occlusion culling needs multi draw indirect!");
+  auto alignment =
+      physical.getProperties().limits.minStorageBufferOffsetAlignment;
+  this->draw_region_ = align_up(
+      sizeof(::vk::DrawIndexedIndirectCommand) * this->object_count_,
+      alignment);
+  this->count_region_ = align_up(sizeof(uint32_t), alignment);
+
+  // nothing was visible before the first frame, its late phase draws all
+  ::std::vector<uint32_t> visibility(objects.size(), 0);
+  ::std::vector object_buffers{
+      wrap_buffer(physical, this->device_, indices, objects.data(),
+                  objects.size(), ::vk::BufferUsageFlagBits::eStorageBuffer),
+      wrap_buffer(physical, this->device_, indices, visibility.data(),
+                  visibility.size(),
+                  ::vk::BufferUsageFlagBits::eStorageBuffer),
+  };
+  ::std::tie(this->buffers_, this->object_memory_) =
+      allocate_memory<::vk::Buffer>(physical, this->device_, pool, queue,
+                                    object_buffers,
+                                    ::vk::MemoryPropertyFlagBits::eDeviceLocal);
+  // written by the compute pass, read as indirect arguments
+  auto region_count = frame_count * 2;
+  ::vk::BufferUsageFlags usage{::vk::BufferUsageFlagBits::eStorageBuffer |
+                               ::vk::BufferUsageFlagBits::eIndirectBuffer |
+                               ::vk::BufferUsageFlagBits::eTransferDst};
+  ::std::vector draw_buffers{
+      create_buffer(this->device_, indices,
+                    this->draw_region_ * region_count, usage),
+      create_buffer(this->device_, indices,
+                    this->count_region_ * region_count, usage),
+  };
+  this->draw_memory_ =
+      allocate_memory(physical, this->device_, draw_buffers,
+                      ::vk::MemoryPropertyFlagBits::eDeviceLocal);
+  this->buffers_.insert(this->buffers_.end(), draw_buffers.begin(),
+                        draw_buffers.end());
+
+  ::std::vector<::vk::DescriptorSetLayoutBinding> bindings;
+  for (uint32_t i = 0; i < 4; ++i) {
+    bindings.emplace_back(i, ::vk::DescriptorType::eStorageBuffer, 1,
+                          ::vk::ShaderStageFlagBits::eCompute);
+  }
+  bindings.emplace_back(4, ::vk::DescriptorType::eCombinedImageSampler, 1,
+                        ::vk::ShaderStageFlagBits::eCompute);
+  auto set_layout = layouts.get_set_layout(bindings);
+  this->layout_ = layouts.get_pipeline_layout(
+      {set_layout}, {::vk::PushConstantRange{
+                        ::vk::ShaderStageFlagBits::eCompute, 0,
+                        sizeof(OcclusionConstants)}});
+  this->sets_ = descriptors.allocate(set_layout, region_count);
+  ::vk::DescriptorImageInfo pyramid_info{pyramid.get_sampler(),
+                                         pyramid.get_view(),
+                                         ::vk::ImageLayout::eGeneral};
+  ::std::vector<::vk::DescriptorBufferInfo> buffer_infos;
+  buffer_infos.reserve(4 * region_count);
+  ::std::vector<::vk::WriteDescriptorSet> writes;
+  for (uint32_t i = 0; i < region_count; ++i) {
+    buffer_infos.emplace_back(this->buffers_[0], 0, VK_WHOLE_SIZE);
+    buffer_infos.emplace_back(this->buffers_[1], 0, VK_WHOLE_SIZE);
+    buffer_infos.emplace_back(this->buffers_[2], this->draw_region_ * i,
+                              this->draw_region_);
+    buffer_infos.emplace_back(this->buffers_[3], this->count_region_ * i,
+                              sizeof(uint32_t));
+    for (uint32_t binding = 0; binding < 4; ++binding) {
+      writes.emplace_back(this->sets_[i], binding, 0, 1,
+                          ::vk::DescriptorType::eStorageBuffer, nullptr,
+                          &buffer_infos[i * 4 + binding]);
+    }
+    writes.emplace_back(this->sets_[i], 4, 0, 1,
+                        ::vk::DescriptorType::eCombinedImageSampler,
+                        &pyramid_info);
+  }
+  this->device_.updateDescriptorSets(writes, {});
+
+  auto module = create_shader_module(this->device_, shader);
+  ::vk::ComputePipelineCreateInfo info;
+  info.setStage(::vk::PipelineShaderStageCreateInfo{
+                    {}, ::vk::ShaderStageFlagBits::eCompute, module, "main"})
+      .setLayout(this->layout_);
+  auto result = this->device_.createComputePipeline(nullptr, info);
+  assert(result.result == ::vk::Result::eSuccess &&
+         "compute pipeline create failed!");
+  this->pipeline_ = result.value;
+  this->device_.destroyShaderModule(module);
+}
+
+auto OcclusionCuller::cull(::vk::CommandBuffer &cbuf, size_t frame,
+                           CullPhase phase, ::glm::mat4 const &view,
+                           ::glm::mat4 const &project, float z_near) -> void {
+  auto region = this->get_region(frame, phase);
+  if (phase == CullPhase::eEarly) {
+    // both phases of the frame start empty
+    cbuf.fillBuffer(this->buffers_[3], this->count_region_ * region,
+                    this->count_region_ * 2, 0);
+    if (!this->draw_count_) {
+      // every slot is drawn, the ones culling leaves empty draw nothing
+      cbuf.fillBuffer(this->buffers_[2], this->draw_region_ * region,
+                      this->draw_region_ * 2, 0);
+    }
+    // also orders the last frame's visibility writes before this frame
+    ::vk::MemoryBarrier clear_barrier{
+        ::vk::AccessFlagBits::eTransferWrite |
+            ::vk::AccessFlagBits::eShaderWrite,
+        ::vk::AccessFlagBits::eShaderRead |
+            ::vk::AccessFlagBits::eShaderWrite};
+    cbuf.pipelineBarrier(::vk::PipelineStageFlagBits::eTransfer |
+                             ::vk::PipelineStageFlagBits::eComputeShader,
+                         ::vk::PipelineStageFlagBits::eComputeShader, {},
+                         clear_barrier, {}, {});
+  }
+
+  OcclusionConstants constants{
+      view,
+      project[0][0],
+      project[1][1],
+      project[2][2],
+      project[3][2],
+      z_near,
+      this->object_count_,
+      this->extent_.width,
+      this->extent_.height,
+      static_cast<uint32_t>(phase),
+  };
+  cbuf.bindPipeline(::vk::PipelineBindPoint::eCompute, this->pipeline_);
+  cbuf.bindDescriptorSets(::vk::PipelineBindPoint::eCompute, this->layout_, 0,
+                          this->sets_[region], {});
+  cbuf.pushConstants(this->layout_, ::vk::ShaderStageFlagBits::eCompute, 0,
+                     sizeof(OcclusionConstants), &constants);
+  cbuf.dispatch((this->object_count_ + kWorkgroupSize - 1) / kWorkgroupSize,
+                1, 1);
+
+  ::vk::MemoryBarrier draw_barrier{::vk::AccessFlagBits::eShaderWrite,
+                                   ::vk::AccessFlagBits::eIndirectCommandRead};
+  cbuf.pipelineBarrier(::vk::PipelineStageFlagBits::eComputeShader,
+                       ::vk::PipelineStageFlagBits::eDrawIndirect, {},
+                       draw_barrier, {}, {});
+}
+
+auto OcclusionCuller::draw(::vk::CommandBuffer &cbuf, size_t frame,
+                           CullPhase phase) const -> void {
+  auto region = this->get_region(frame, phase);
+  if (this->draw_count_) {
+    cbuf.drawIndexedIndirectCount(
+        this->buffers_[2], this->draw_region_ * region, this->buffers_[3],
+        this->count_region_ * region, this->object_count_,
+        sizeof(::vk::DrawIndexedIndirectCommand));
+  } else {
+    cbuf.drawIndexedIndirect(this->buffers_[2], this->draw_region_ * region,
+                             this->object_count_,
+                             sizeof(::vk::DrawIndexedIndirectCommand));
+  }
+}
+
+auto OcclusionCuller::destroy() -> void {
+  // the layout belongs to the LayoutCache and the sets to their allocator
+  this->device_.destroyPipeline(this->pipeline_);
+  for (auto &buffer : this->buffers_) {
+    this->device_.destroyBuffer(buffer);
+  }
+  this->device_.freeMemory(this->object_memory_);
+  this->device_.freeMemory(this->draw_memory_);
+}
+
+auto OcclusionCuller::get_region(size_t frame, CullPhase phase) const
+    -> size_t {
+  return frame * 2 + static_cast<size_t>(phase);
+}
@@ -0,0 +1,550 @@
+#include "pixel_convert.hpp"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||            \
+    defined(_M_IX86)
+#define PIXEL_CONVERT_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define PIXEL_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PIXEL_CONVERT_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PIXEL_CONVERT_TARGET(isa)
+#endif
+
+namespace {
+
+// float -> sRGB8 by piecewise linear interpolation, from stb_image_resize
+::std::array<uint32_t, 104> const kLinearToSrgbTable{
+    0x0073000d, 0x007a000d, 0x0080000d, 0x0087000d, 0x008d000d, 0x0094000d,
+    0x009a000d, 0x00a1000d, 0x00a7001a, 0x00b4001a, 0x00c1001a, 0x00ce001a,
+    0x00da001a, 0x00e7001a, 0x00f4001a, 0x0101001a, 0x010e0033, 0x01280033,
+    0x01410033, 0x015b0033, 0x01750033, 0x018f0033, 0x01a80033, 0x01c20033,
+    0x01dc0067, 0x020f0067, 0x02430067, 0x02760067, 0x02aa0067, 0x02dd0067,
+    0x03110067, 0x03440067, 0x037800ce, 0x03df00ce, 0x044600ce, 0x04ad00ce,
+    0x051400ce, 0x057b00c5, 0x05dd00bc, 0x063b00b5, 0x06970158, 0x07420142,
+    0x07e30130, 0x087b0120, 0x090b0112, 0x09940106, 0x0a1700fc, 0x0a9500f2,
+    0x0b0f01cb, 0x0bf401ae, 0x0ccb0195, 0x0d950180, 0x0e56016e, 0x0f0d015e,
+    0x0fbc0150, 0x10630143, 0x11070264, 0x1238023e, 0x1357021d, 0x14660201,
+    0x156601e9, 0x165a01d3, 0x174401c0, 0x182401af, 0x18fe0331, 0x1a9602fe,
+    0x1c1502d2, 0x1d7e02ad, 0x1ed4028d, 0x201a0270, 0x21520256, 0x227d0240,
+    0x239f0443, 0x25c003fe, 0x27bf03c4, 0x29a10392, 0x2b6a0367, 0x2d1d0341,
+    0x2ebe031f, 0x304d0300, 0x31d105b0, 0x34a80555, 0x37520507, 0x39d504c5,
+    0x3c37048b, 0x3e7c0458, 0x40a8042a, 0x42bd0401, 0x44c20798, 0x488e071e,
+    0x4c1c06b6, 0x4f76065d, 0x52a50610, 0x55ac05cc, 0x5892058f, 0x5b590559,
+    0x5e0c0a23, 0x631c0980, 0x67db08f6, 0x6c55087f, 0x70940818, 0x74a007bd,
+    0x787d076c, 0x7c330723,
+};
+
+uint32_t const kAlmostOneBits{0x3f7f'ffff};
+
+uint32_t const kMinValueBits{(127 - 13) << 23};
+
+float const kUnormScale{1.f / 255.f};
+
+auto srgb_to_linear_table() -> ::std::array<float, 256> const & {
+  static ::std::array<float, 256> const kTable = [] {
+    ::std::array<float, 256> table{};
+    for (size_t i = 0; i < table.size(); ++i) {
+      double c = static_cast<double>(i) / 255.;
+      table[i] = static_cast<float>(
+          c <= .04045 ? c / 12.92 : ::pow((c + .055) / 1.055, 2.4));
+    }
+    return table;
+  }();
+  return kTable;
+}
+
+auto bits_to_float(uint32_t bits) -> float {
+  float value{0.f};
+  ::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+auto float_to_bits(float value) -> uint32_t {
+  uint32_t bits{0};
+  ::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// the scalar kernels are the reference every other instruction set must match
+
+auto float_to_srgb8(float value) -> unsigned char {
+  float const min_value = bits_to_float(kMinValueBits);
+  float const almost_one = bits_to_float(kAlmostOneBits);
+  if (!(value > min_value)) { // also catches NaN
+    value = min_value;
+  }
+  value = ::std::min(value, almost_one);
+  uint32_t bits = float_to_bits(value);
+  uint32_t entry = kLinearToSrgbTable[(bits - kMinValueBits) >> 20];
+  uint32_t bias = (entry >> 16) << 9;
+  uint32_t scale = entry & 0xffff;
+  uint32_t t = (bits >> 12) & 0xff;
+  return static_cast<unsigned char>((bias + scale * t) >> 16);
+}
+
+auto float_to_unorm8(float value) -> unsigned char {
+  value = ::std::min(::std::max(value, 0.f), 1.f);
+  return static_cast<unsigned char>(value * 255.f + .5f);
+}
+
+auto div255(uint32_t value) -> unsigned char {
+  value += 128;
+  return static_cast<unsigned char>((value + (value >> 8)) >> 8);
+}
+
+auto rgb_to_rgba_scalar(unsigned char const *src, unsigned char *dest,
+                        size_t count) -> void {
+  for (size_t i = 0; i < count; ++i) {
+    dest[i * 4 + 0] = src[i * 3 + 0];
+    dest[i * 4 + 1] = src[i * 3 + 1];
+    dest[i * 4 + 2] = src[i * 3 + 2];
+    dest[i * 4 + 3] = 255;
+  }
+}
+
+auto rgba_to_bgra_scalar(unsigned char const *src, unsigned char *dest,
+                         size_t count) -> void {
+  for (size_t i = 0; i < count * 4; i += 4) {
+    unsigned char red = src[i];
+    dest[i] = src[i + 2];
+    dest[i + 1] = src[i + 1];
+    dest[i + 2] = red;
+    dest[i + 3] = src[i + 3];
+  }
+}
+
+auto premultiply_alpha_scalar(unsigned char const *src, unsigned char *dest,
+                              size_t count) -> void {
+  for (size_t i = 0; i < count * 4; i += 4) {
+    uint32_t alpha = src[i + 3];
+    dest[i] = div255(src[i] * alpha);
+    dest[i + 1] = div255(src[i + 1] * alpha);
+    dest[i + 2] = div255(src[i + 2] * alpha);
+    dest[i + 3] = static_cast<unsigned char>(alpha);
+  }
+}
+
+auto srgb_to_linear_scalar(unsigned char const *src, float *dest, size_t count)
+    -> void {
+  auto const &table = srgb_to_linear_table();
+  for (size_t i = 0; i < count * 4; i += 4) {
+    dest[i] = table[src[i]];
+    dest[i + 1] = table[src[i + 1]];
+    dest[i + 2] = table[src[i + 2]];
+    dest[i + 3] = static_cast<float>(src[i + 3]) * kUnormScale;
+  }
+}
+
+auto linear_to_srgb_scalar(float const *src, unsigned char *dest, size_t count)
+    -> void {
+  for (size_t i = 0; i < count * 4; i += 4) {
+    dest[i] = float_to_srgb8(src[i]);
+    dest[i + 1] = float_to_srgb8(src[i + 1]);
+    dest[i + 2] = float_to_srgb8(src[i + 2]);
+    dest[i + 3] = float_to_unorm8(src[i + 3]);
+  }
+}
+
+PixelKernels const kScalarKernels{
+    PixelIsa::kScalar,        rgb_to_rgba_scalar,    rgba_to_bgra_scalar,
+    premultiply_alpha_scalar, srgb_to_linear_scalar, linear_to_srgb_scalar,
+};
+
+#ifdef PIXEL_CONVERT_X86
+
+PIXEL_CONVERT_TARGET("ssse3")
+auto rgb_to_rgba_ssse3(unsigned char const *src, unsigned char *dest,
+                       size_t count) -> void {
+  __m128i const shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1,
+                                        9, 10, 11, -1);
+  __m128i const alpha = _mm_set1_epi32(static_cast<int>(0xff00'0000));
+  size_t i{0};
+  for (; i + 16 <= count; i += 16) {
+    auto const *in = reinterpret_cast<__m128i const *>(src + i * 3);
+    auto *out = reinterpret_cast<__m128i *>(dest + i * 4);
+    __m128i a = _mm_loadu_si128(in);
+    __m128i b = _mm_loadu_si128(in + 1);
+    __m128i c = _mm_loadu_si128(in + 2);
+    _mm_storeu_si128(out, _mm_or_si128(_mm_shuffle_epi8(a, shuffle), alpha));
+    _mm_storeu_si128(out + 1, _mm_or_si128(_mm_shuffle_epi8(
+                                               _mm_alignr_epi8(b, a, 12),
+                                               shuffle),
+                                           alpha));
+    _mm_storeu_si128(out + 2, _mm_or_si128(_mm_shuffle_epi8(
+                                               _mm_alignr_epi8(c, b, 8),
+                                               shuffle),
+                                           alpha));
+    _mm_storeu_si128(out + 3, _mm_or_si128(_mm_shuffle_epi8(
+                                               _mm_srli_si128(c, 4), shuffle),
+                                           alpha));
+  }
+  rgb_to_rgba_scalar(src + i * 3, dest + i * 4, count - i);
+}
+
+PIXEL_CONVERT_TARGET("ssse3")
+auto rgba_to_bgra_ssse3(unsigned char const *src, unsigned char *dest,
+                        size_t count) -> void {
+  __m128i const shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11,
+                                        14, 13, 12, 15);
+  size_t i{0};
+  for (; i + 4 <= count; i += 4) {
+    __m128i texels =
+        _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i * 4));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i * 4),
+                     _mm_shuffle_epi8(texels, shuffle));
+  }
+  rgba_to_bgra_scalar(src + i * 4, dest + i * 4, count - i);
+}
+
+// x is 16 bits per channel, returns round(x * alpha / 255)
+auto premultiply_epi16_sse2(__m128i texels) -> __m128i {
+  __m128i const color_mask = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+  __m128i const alpha_one = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+  __m128i alpha = _mm_shufflelo_epi16(texels, _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm_or_si128(_mm_and_si128(alpha, color_mask), alpha_one);
+  __m128i product =
+      _mm_add_epi16(_mm_mullo_epi16(texels, alpha), _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+}
+
+auto premultiply_alpha_sse2(unsigned char const *src, unsigned char *dest,
+                            size_t count) -> void {
+  __m128i const zero = _mm_setzero_si128();
+  size_t i{0};
+  for (; i + 4 <= count; i += 4) {
+    __m128i texels =
+        _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i * 4));
+    __m128i low = premultiply_epi16_sse2(_mm_unpacklo_epi8(texels, zero));
+    __m128i high = premultiply_epi16_sse2(_mm_unpackhi_epi8(texels, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i * 4),
+                     _mm_packus_epi16(low, high));
+  }
+  premultiply_alpha_scalar(src + i * 4, dest + i * 4, count - i);
+}
+
+// no gather before AVX2, only the alpha lane is computed in vector
+auto srgb_to_linear_sse2(unsigned char const *src, float *dest, size_t count)
+    -> void {
+  auto const &table = srgb_to_linear_table();
+  for (size_t i = 0; i < count * 4; i += 4) {
+    _mm_storeu_ps(dest + i,
+                  _mm_setr_ps(table[src[i]], table[src[i + 1]],
+                              table[src[i + 2]],
+                              static_cast<float>(src[i + 3]) * kUnormScale));
+  }
+}
+
+// one RGBA texel in, four 32 bits channels out
+auto float_to_srgb8_sse2(__m128 texel) -> __m128i {
+  __m128 const min_value =
+      _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(kMinValueBits)));
+  __m128 const almost_one =
+      _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(kAlmostOneBits)));
+  __m128i const alpha_mask = _mm_setr_epi32(0, 0, 0, -1);
+
+  __m128 clamped = _mm_min_ps(_mm_max_ps(texel, min_value), almost_one);
+  __m128i bits = _mm_castps_si128(clamped);
+  __m128i index =
+      _mm_srli_epi32(_mm_sub_epi32(bits, _mm_castps_si128(min_value)), 20);
+  alignas(16) ::std::array<uint32_t, 4> lanes{};
+  _mm_store_si128(reinterpret_cast<__m128i *>(lanes.data()), index);
+  __m128i entry = _mm_setr_epi32(static_cast<int>(kLinearToSrgbTable[lanes[0]]),
+                                 static_cast<int>(kLinearToSrgbTable[lanes[1]]),
+                                 static_cast<int>(kLinearToSrgbTable[lanes[2]]),
+                                 0);
+  // entry is (bias, scale) in 16 bits halves, multiply by (512, t)
+  __m128i t = _mm_and_si128(_mm_srli_epi32(bits, 12), _mm_set1_epi32(0xff));
+  __m128i factor = _mm_or_si128(t, _mm_set1_epi32(0x0200'0000));
+  __m128i color = _mm_srli_epi32(_mm_madd_epi16(entry, factor), 16);
+
+  __m128 unorm =
+      _mm_min_ps(_mm_max_ps(texel, _mm_setzero_ps()), _mm_set1_ps(1.f));
+  __m128i alpha = _mm_cvttps_epi32(
+      _mm_add_ps(_mm_mul_ps(unorm, _mm_set1_ps(255.f)), _mm_set1_ps(.5f)));
+  return _mm_or_si128(_mm_andnot_si128(alpha_mask, color),
+                      _mm_and_si128(alpha_mask, alpha));
+}
+
+auto linear_to_srgb_sse2(float const *src, unsigned char *dest, size_t count)
+    -> void {
+  size_t i{0};
+  for (; i + 4 <= count; i += 4) {
+    __m128i texel0 = float_to_srgb8_sse2(_mm_loadu_ps(src + i * 4));
+    __m128i texel1 = float_to_srgb8_sse2(_mm_loadu_ps(src + i * 4 + 4));
+    __m128i texel2 = float_to_srgb8_sse2(_mm_loadu_ps(src + i * 4 + 8));
+    __m128i texel3 = float_to_srgb8_sse2(_mm_loadu_ps(src + i * 4 + 12));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i * 4),
+                     _mm_packus_epi16(_mm_packs_epi32(texel0, texel1),
+                                      _mm_packs_epi32(texel2, texel3)));
+  }
+  linear_to_srgb_scalar(src + i * 4, dest + i * 4, count - i);
+}
+
+PIXEL_CONVERT_TARGET("avx2")
+auto rgb_to_rgba_avx2(unsigned char const *src, unsigned char *dest,
+                      size_t count) -> void {
+  __m256i const shuffle = _mm256_setr_epi8(
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4,
+      5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  __m256i const alpha = _mm256_set1_epi32(static_cast<int>(0xff00'0000));
+  size_t i{0};
+  // each lane reads 16 bytes for 12 used ones, keep the tail in bounds
+  for (; i + 11 <= count; i += 8) {
+    __m128i low =
+        _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i * 3));
+    __m128i high =
+        _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i * 3 + 12));
+    __m256i texels =
+        _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(dest + i * 4),
+        _mm256_or_si256(_mm256_shuffle_epi8(texels, shuffle), alpha));
+  }
+  rgb_to_rgba_scalar(src + i * 3, dest + i * 4, count - i);
+}
+
+PIXEL_CONVERT_TARGET("avx2")
+auto rgba_to_bgra_avx2(unsigned char const *src, unsigned char *dest,
+                       size_t count) -> void {
+  __m256i const shuffle = _mm256_setr_epi8(
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4,
+      7, 10, 9, 8, 11, 14, 13, 12, 15);
+  size_t i{0};
+  for (; i + 8 <= count; i += 8) {
+    __m256i texels =
+        _mm256_loadu_si256(reinterpret_cast<__m256i const *>(src + i * 4));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + i * 4),
+                        _mm256_shuffle_epi8(texels, shuffle));
+  }
+  rgba_to_bgra_scalar(src + i * 4, dest + i * 4, count - i);
+}
+
+PIXEL_CONVERT_TARGET("avx2")
+auto premultiply_epi16_avx2(__m256i texels) -> __m256i {
+  __m256i const color_mask = _mm256_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0,
+                                               -1, -1, -1, 0, -1, -1, -1, 0);
+  __m256i const alpha_one = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0,
+                                              0, 0, 255, 0, 0, 0, 255);
+  __m256i alpha = _mm256_shufflelo_epi16(texels, _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm256_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm256_or_si256(_mm256_and_si256(alpha, color_mask), alpha_one);
+  __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(texels, alpha),
+                                     _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(
+      _mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+}
+
+PIXEL_CONVERT_TARGET("avx2")
+auto premultiply_alpha_avx2(unsigned char const *src, unsigned char *dest,
+                            size_t count) -> void {
+  __m256i const zero = _mm256_setzero_si256();
+  size_t i{0};
+  for (; i + 8 <= count; i += 8) {
+    __m256i texels =
+        _mm256_loadu_si256(reinterpret_cast<__m256i const *>(src + i * 4));
+    // unpack and pack both work per 128 bits lane, the order is kept
+    __m256i low = premultiply_epi16_avx2(_mm256_unpacklo_epi8(texels, zero));
+    __m256i high = premultiply_epi16_avx2(_mm256_unpackhi_epi8(texels, zero));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + i * 4),
+                        _mm256_packus_epi16(low, high));
+  }
+  premultiply_alpha_scalar(src + i * 4, dest + i * 4, count - i);
+}
+
+PIXEL_CONVERT_TARGET("avx2")
+auto srgb_to_linear_avx2(unsigned char const *src, float *dest, size_t count)
+    -> void {
+  float const *table = srgb_to_linear_table().data();
+  __m256 const scale = _mm256_set1_ps(kUnormScale);
+  size_t i{0};
+  for (; i + 2 <= count; i += 2) {
+    __m256i channels = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<__m128i const *>(src + i * 4)));
+    __m256 color = _mm256_i32gather_ps(table, channels, 4);
+    __m256 alpha = _mm256_mul_ps(_mm256_cvtepi32_ps(channels), scale);
+    _mm256_storeu_ps(dest + i * 4, _mm256_blend_ps(color, alpha, 0x88));
+  }
+  srgb_to_linear_scalar(src + i * 4, dest + i * 4, count - i);
+}
+
+// two RGBA texels in, (r0 g0 b0 a0 r1 g1 b1 a1) in 32 bits out
+PIXEL_CONVERT_TARGET("avx2")
+auto float_to_srgb8_avx2(__m256 texels) -> __m256i {
+  __m256 const min_value = _mm256_castsi256_ps(
+      _mm256_set1_epi32(static_cast<int>(kMinValueBits)));
+  __m256 const almost_one = _mm256_castsi256_ps(
+      _mm256_set1_epi32(static_cast<int>(kAlmostOneBits)));
+  auto const *table = reinterpret_cast<int const *>(kLinearToSrgbTable.data());
+
+  __m256 clamped = _mm256_min_ps(_mm256_max_ps(texels, min_value), almost_one);
+  __m256i bits = _mm256_castps_si256(clamped);
+  __m256i index = _mm256_srli_epi32(
+      _mm256_sub_epi32(bits, _mm256_castps_si256(min_value)), 20);
+  __m256i entry = _mm256_i32gather_epi32(table, index, 4);
+  __m256i t =
+      _mm256_and_si256(_mm256_srli_epi32(bits, 12), _mm256_set1_epi32(0xff));
+  __m256i factor = _mm256_or_si256(t, _mm256_set1_epi32(0x0200'0000));
+  __m256i color = _mm256_srli_epi32(_mm256_madd_epi16(entry, factor), 16);
+
+  __m256 unorm = _mm256_min_ps(_mm256_max_ps(texels, _mm256_setzero_ps()),
+                               _mm256_set1_ps(1.f));
+  __m256i alpha = _mm256_cvttps_epi32(_mm256_add_ps(
+      _mm256_mul_ps(unorm, _mm256_set1_ps(255.f)), _mm256_set1_ps(.5f)));
+  return _mm256_blend_epi32(color, alpha, 0x88);
+}
+
+PIXEL_CONVERT_TARGET("avx2")
+auto linear_to_srgb_avx2(float const *src, unsigned char *dest, size_t count)
+    -> void {
+  size_t i{0};
+  for (; i + 8 <= count; i += 8) {
+    __m256i texel01 = float_to_srgb8_avx2(_mm256_loadu_ps(src + i * 4));
+    __m256i texel23 = float_to_srgb8_avx2(_mm256_loadu_ps(src + i * 4 + 8));
+    __m256i texel45 = float_to_srgb8_avx2(_mm256_loadu_ps(src + i * 4 + 16));
+    __m256i texel67 = float_to_srgb8_avx2(_mm256_loadu_ps(src + i * 4 + 24));
+    // packs work per lane: (01 23) -> 0 2 | 1 3, (45 67) -> 4 6 | 5 7
+    __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(texel01, texel23),
+                                         _mm256_packs_epi32(texel45, texel67));
+    // lanes hold texels (0 2 4 6 | 1 3 5 7), interleave them back
+    packed = _mm256_permutevar8x32_epi32(
+        packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + i * 4), packed);
+  }
+  linear_to_srgb_scalar(src + i * 4, dest + i * 4, count - i);
+}
+
+PixelKernels const kSsse3Kernels{
+    PixelIsa::kSsse3,       rgb_to_rgba_ssse3,   rgba_to_bgra_ssse3,
+    premultiply_alpha_sse2, srgb_to_linear_sse2, linear_to_srgb_sse2,
+};
+
+PixelKernels const kAvx2Kernels{
+    PixelIsa::kAvx2,        rgb_to_rgba_avx2,    rgba_to_bgra_avx2,
+    premultiply_alpha_avx2, srgb_to_linear_avx2, linear_to_srgb_avx2,
+};
+
+auto detect_isa() -> PixelIsa {
+#ifdef _MSC_VER
+  ::std::array<int, 4> info{};
+  __cpuid(info.data(), 0);
+  int leaves = info[0];
+  __cpuid(info.data(), 1);
+  bool ssse3 = (info[2] & (1 << 9)) != 0;
+  bool os_avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 &&
+                (_xgetbv(0) & 0x6) == 0x6;
+  bool avx2{false};
+  if (leaves >= 7 && os_avx) {
+    __cpuidex(info.data(), 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+  }
+#else
+  __builtin_cpu_init();
+  bool ssse3 = __builtin_cpu_supports("ssse3");
+  bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+  if (avx2) {
+    return PixelIsa::kAvx2;
+  }
+  return ssse3 ? PixelIsa::kSsse3 : PixelIsa::kScalar;
+}
+
+#elif defined(PIXEL_CONVERT_NEON)
+
+auto rgb_to_rgba_neon(unsigned char const *src, unsigned char *dest,
+                      size_t count) -> void {
+  size_t i{0};
+  for (; i + 16 <= count; i += 16) {
+    uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+    uint8x16x4_t rgba{{rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(255)}};
+    vst4q_u8(dest + i * 4, rgba);
+  }
+  rgb_to_rgba_scalar(src + i * 3, dest + i * 4, count - i);
+}
+
+auto rgba_to_bgra_neon(unsigned char const *src, unsigned char *dest,
+                       size_t count) -> void {
+  size_t i{0};
+  for (; i + 16 <= count; i += 16) {
+    uint8x16x4_t texels = vld4q_u8(src + i * 4);
+    uint8x16_t red = texels.val[0];
+    texels.val[0] = texels.val[2];
+    texels.val[2] = red;
+    vst4q_u8(dest + i * 4, texels);
+  }
+  rgba_to_bgra_scalar(src + i * 4, dest + i * 4, count - i);
+}
+
+// round(x * alpha / 255) for eight channels
+auto premultiply_u8_neon(uint8x8_t channel, uint8x8_t alpha) -> uint8x8_t {
+  uint16x8_t product = vmull_u8(channel, alpha);
+  return vrshrn_n_u16(vaddq_u16(product, vrshrq_n_u16(product, 8)), 8);
+}
+
+auto premultiply_alpha_neon(unsigned char const *src, unsigned char *dest,
+                            size_t count) -> void {
+  size_t i{0};
+  for (; i + 8 <= count; i += 8) {
+    uint8x8x4_t texels = vld4_u8(src + i * 4);
+    for (int c = 0; c < 3; ++c) {
+      texels.val[c] = premultiply_u8_neon(texels.val[c], texels.val[3]);
+    }
+    vst4_u8(dest + i * 4, texels);
+  }
+  premultiply_alpha_scalar(src + i * 4, dest + i * 4, count - i);
+}
+
+// NEON has no gather, the table based conversions stay scalar
+PixelKernels const kNeonKernels{
+    PixelIsa::kNeon,        rgb_to_rgba_neon,      rgba_to_bgra_neon,
+    premultiply_alpha_neon, srgb_to_linear_scalar, linear_to_srgb_scalar,
+};
+
+auto detect_isa() -> PixelIsa { return PixelIsa::kNeon; }
+
+#else
+
+auto detect_isa() -> PixelIsa { return PixelIsa::kScalar; }
+
+#endif
+
+} // namespace
+
+auto get_pixel_kernels() -> PixelKernels const & {
+  static PixelKernels const &kKernels = *get_pixel_kernels(detect_isa());
+  return kKernels;
+}
+
+auto get_pixel_kernels(PixelIsa isa) -> PixelKernels const * {
+  static PixelIsa const kSupported = detect_isa();
+  switch (isa) {
+  case PixelIsa::kScalar:
+    return &kScalarKernels;
+#ifdef PIXEL_CONVERT_X86
+  case PixelIsa::kSsse3:
+    return kSupported != PixelIsa::kScalar ? &kSsse3Kernels : nullptr;
+  case PixelIsa::kAvx2:
+    return kSupported == PixelIsa::kAvx2 ? &kAvx2Kernels : nullptr;
+#elif defined(PIXEL_CONVERT_NEON)
+  case PixelIsa::kNeon:
+    return &kNeonKernels;
+#endif
+  default:
+    return nullptr;
+  }
+}
@@ -0,0 +1,222 @@
+#include "shader_watcher.hpp"
+
+#include <errno.h>
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+#endif
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <map>
+#include <system_error>
+#endif
+
+namespace {
+
+// how long the watcher sleeps before it looks at is_stopped_ again
+int const kPollMilliseconds{100};
+
+// the extensions the glsl build rules compile
+::std::array const kShaderExtensions{".vert", ".tesc", ".tese",
+                                     ".geom", ".frag", ".comp"};
+
+auto is_shader(::std::filesystem::path const &path) -> bool {
+  auto extension = path.extension().string();
+  for (auto const *shader_extension : kShaderExtensions) {
+    if (extension == shader_extension) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// runs args[0] found on PATH with args, no shell sees them. Returns the exit
+// status, -1 when it could not be started
+auto run(::std::vector<::std::string> const &args) -> int {
+#ifdef _WIN32
+  // the CRT joins argv into one command line, keep paths with spaces whole
+  ::std::vector<::std::string> quoted;
+  for (auto const &arg : args) {
+    quoted.push_back('"' + arg + '"');
+  }
+  ::std::vector<char const *> argv;
+  for (auto const &arg : quoted) {
+    argv.push_back(arg.c_str());
+  }
+  argv.push_back(nullptr);
+  return static_cast<int>(_spawnvp(_P_WAIT, args[0].c_str(), argv.data()));
+#else
+  ::std::vector<char *> argv;
+  for (auto const &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  pid_t pid{0};
+  if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) !=
+      0) {
+    return -1;
+  }
+  int status{0};
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      return -1;
+    }
+  }
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+} // namespace
+
+ShaderWatcher::ShaderWatcher(::std::filesystem::path source_dir,
+                             ::std::filesystem::path output_dir,
+                             ::std::filesystem::path compiler,
+                             Callback on_compiled)
+    : source_dir_{::std::move(source_dir)},
+      output_dir_{::std::move(output_dir)}, compiler_{::std::move(compiler)},
+      on_compiled_{::std::move(on_compiled)} {
+  this->thread_ = ::std::thread{&ShaderWatcher::watch, this};
+}
+
+ShaderWatcher::~ShaderWatcher() {
+  this->is_stopped_ = true;
+  if (this->thread_.joinable()) {
+    this->thread_.join();
+  }
+}
+
+auto ShaderWatcher::watch() -> void {
+  // failures are logged and end the watch, the app keeps its shaders
+#ifdef __linux__
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    ::std::cerr << this->source_dir_.string()
+                << ": inotify init failed, not watching" << ::std::endl;
+    return;
+  }
+  // editors either write in place or rename a temporary over the file
+  if (inotify_add_watch(fd, this->source_dir_.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    ::std::cerr << this->source_dir_.string()
+                << ": inotify add watch failed, not watching" << ::std::endl;
+    close(fd);
+    return;
+  }
+  alignas(inotify_event) ::std::array<char, 4096> buffer;
+  while (!this->is_stopped_) {
+    pollfd poll_fd{fd, POLLIN, 0};
+    if (poll(&poll_fd, 1, kPollMilliseconds) <= 0) {
+      continue;
+    }
+    // a save may raise several events, compile each file once
+    ::std::set<::std::filesystem::path> changed;
+    ssize_t size{0};
+    while ((size = read(fd, buffer.data(), buffer.size())) > 0) {
+      for (ssize_t offset = 0; offset < size;) {
+        auto const *event =
+            reinterpret_cast<inotify_event const *>(buffer.data() + offset);
+        if (event->len > 0) {
+          changed.insert(this->source_dir_ / event->name);
+        }
+        offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+      }
+    }
+    for (auto const &source : changed) {
+      this->compile(source);
+    }
+  }
+  close(fd);
+#else
+  using Times =
+      ::std::map<::std::filesystem::path, ::std::filesystem::file_time_type>;
+  // a throw here would terminate, errors are reported through ec instead
+  auto scan = [this](Times &times) {
+    times.clear();
+    ::std::error_code ec;
+    ::std::filesystem::directory_iterator iter{this->source_dir_, ec};
+    for (; !ec && iter != ::std::filesystem::directory_iterator{};
+         iter.increment(ec)) {
+      // a file removed since it was listed is skipped
+      ::std::error_code time_ec;
+      auto time = iter->last_write_time(time_ec);
+      if (!time_ec) {
+        times.emplace(iter->path(), time);
+      }
+    }
+    if (ec) {
+      ::std::cerr << this->source_dir_.string() << ": " << ec.message()
+                  << ", not watching" << ::std::endl;
+    }
+    return !ec;
+  };
+  Times times;
+  Times current;
+  if (!scan(times)) {
+    return;
+  }
+  while (!this->is_stopped_) {
+    ::std::this_thread::sleep_for(
+        ::std::chrono::milliseconds{kPollMilliseconds});
+    if (!scan(current)) {
+      return;
+    }
+    for (auto const &[source, time] : current) {
+      auto previous = times.find(source);
+      if (previous == times.end() || previous->second != time) {
+        this->compile(source);
+      }
+    }
+    times.swap(current);
+  }
+#endif
+}
+
+auto ShaderWatcher::compile(::std::filesystem::path const &source) -> void {
+  if (!is_shader(source)) {
+    return;
+  }
+  auto binary = this->output_dir_ / (source.filename().string() + ".spv");
+  // the flags of the glsl build rules, without the debug ones
+  bool is_glslang =
+      this->compiler_.filename().string().find("glslangValidator") !=
+      ::std::string::npos;
+  ::std::vector<::std::string> args{this->compiler_.string()};
+  if (is_glslang) {
+    args.insert(args.end(), {"--target-env", "vulkan1.0", "-V"});
+  } else {
+    args.emplace_back("--target-env=vulkan");
+  }
+  args.insert(args.end(), {"-o", binary.string(), source.string()});
+#ifdef DEBUG
+  auto start = ::std::chrono::steady_clock::now();
+#endif
+  if (run(args) != 0) {
+    ::std::cerr << source.string() << ": compile failed, keeping the last one"
+                << ::std::endl;
+    return;
+  }
+#ifdef DEBUG
+  ::std::chrono::duration<float, ::std::milli> elapsed =
+      ::std::chrono::steady_clock::now() - start;
+  ::std::clog << source.string() << ": compiled in " << elapsed.count()
+              << " ms" << ::std::endl;
+#endif
+  this->on_compiled_(source, binary);
+}
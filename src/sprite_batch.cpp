@@ -0,0 +1,134 @@
+#include "sprite_batch.hpp"
+#include "radix_sort.hpp"
+
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+
+#include <tuple>
+
+namespace {
+
+// corners of a unit quad around the origin and their texture coordinates
+::std::array<::glm::vec2, 4> const kCorners{
+    ::glm::vec2{-.5f, -.5f},
+    ::glm::vec2{.5f, -.5f},
+    ::glm::vec2{.5f, .5f},
+    ::glm::vec2{-.5f, .5f},
+};
+
+::std::array<::glm::vec2, 4> const kCoords{
+    ::glm::vec2{0.f, 0.f},
+    ::glm::vec2{1.f, 0.f},
+    ::glm::vec2{1.f, 1.f},
+    ::glm::vec2{0.f, 1.f},
+};
+
+::std::array<uint32_t, 6> const kQuadIndices{0, 1, 2, 2, 3, 0};
+
+uint32_t const kQuadIndexCount{static_cast<uint32_t>(kQuadIndices.size())};
+
+} // namespace
+
+SpriteBatch::SpriteBatch(::vk::PhysicalDevice &physical, ::vk::Device &device,
+                         QueueFamilyIndices &indices, ::vk::CommandPool &pool,
+                         ::vk::Queue &queue, uint32_t frame_count,
+                         uint32_t max_sprites)
+    : device_{device}, max_sprites_{max_sprites} {
+  this->frame_size_ = sizeof(SpriteVertex) * 4 * max_sprites;
+  this->vertex_buffer_ =
+      create_buffer(this->device_, indices, this->frame_size_ * frame_count,
+                    ::vk::BufferUsageFlagBits::eVertexBuffer);
+  this->vertex_memory_ =
+      allocate_memory(physical, this->device_, this->vertex_buffer_,
+                      ::vk::MemoryPropertyFlagBits::eHostVisible |
+                          ::vk::MemoryPropertyFlagBits::eHostCoherent);
+  // coherent memory stays mapped for the batch's whole life
+  this->mapped_ = static_cast<unsigned char *>(
+      this->device_.mapMemory(this->vertex_memory_, 0, VK_WHOLE_SIZE));
+  assert(this->mapped_ && "sprite batch map failed!");
+
+  // quad i reads vertices [4i, 4i + 4), the same for every frame
+  ::std::vector<uint32_t> quad_indices;
+  quad_indices.reserve(kQuadIndices.size() * max_sprites);
+  for (uint32_t i = 0; i < max_sprites; ++i) {
+    for (auto index : kQuadIndices) {
+      quad_indices.emplace_back(i * 4 + index);
+    }
+  }
+  ::std::vector buffers{
+      wrap_buffer(physical, this->device_, indices, quad_indices.data(),
+                  quad_indices.size(),
+                  ::vk::BufferUsageFlagBits::eIndexBuffer),
+  };
+  ::std::tie(this->index_buffers_, this->index_memory_) =
+      allocate_memory<::vk::Buffer>(physical, this->device_, pool, queue,
+                                    buffers,
+                                    ::vk::MemoryPropertyFlagBits::eDeviceLocal);
+}
+
+auto SpriteBatch::begin_frame(size_t frame) -> void {
+  this->begin_ = this->frame_size_ * frame;
+  this->sprites_.clear();
+}
+
+auto SpriteBatch::submit(Sprite const &sprite) -> void {
+  assert(this->sprites_.size() < this->max_sprites_ &&
+         "sprite batch is full!");
+  this->sprites_.push_back(sprite);
+}
+
+auto SpriteBatch::flush() -> ::std::vector<SpriteRun> const & {
+  this->runs_.clear();
+  size_t count = this->sprites_.size();
+  this->keys_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    this->keys_[i] = this->sprites_[i].key;
+  }
+  radix_sort(this->keys_.data(), count, this->order_, this->scratch_);
+
+  auto *vertex = reinterpret_cast<SpriteVertex *>(this->mapped_ + this->begin_);
+  for (uint32_t i = 0; i < count; ++i) {
+    auto const &sprite = this->sprites_[this->order_[i]];
+    float cosine = ::cosf(sprite.rotation);
+    float sine = ::sinf(sprite.rotation);
+    for (size_t corner = 0; corner < kCorners.size(); ++corner) {
+      ::glm::vec2 offset = kCorners[corner] * sprite.size;
+      vertex->position =
+          sprite.position + ::glm::vec2{offset.x * cosine - offset.y * sine,
+                                        offset.x * sine + offset.y * cosine};
+      vertex->coord = Unorm16x2{
+          ::glm::vec2{sprite.region.x, sprite.region.y} +
+          kCoords[corner] * ::glm::vec2{sprite.region.z, sprite.region.w}};
+      vertex->color = Unorm8x4{sprite.color};
+      ++vertex;
+    }
+    if (this->runs_.empty() || this->runs_.back().key != sprite.key) {
+      this->runs_.push_back(SpriteRun{sprite.key, i * kQuadIndexCount, 0});
+    }
+    this->runs_.back().index_count += kQuadIndexCount;
+  }
+  return this->runs_;
+}
+
+auto SpriteBatch::bind(::vk::CommandBuffer &cbuf) const -> void {
+  cbuf.bindVertexBuffers(0, this->vertex_buffer_, this->begin_);
+  cbuf.bindIndexBuffer(this->index_buffers_[0], 0, ::vk::IndexType::eUint32);
+}
+
+auto SpriteBatch::get_vertex_input_description()
+    -> ::std::pair<::std::array<::vk::VertexInputAttributeDescription, 3>,
+                   ::vk::VertexInputBindingDescription> {
+  return get_vertex_layout<&SpriteVertex::position, &SpriteVertex::coord,
+                           &SpriteVertex::color>();
+}
+
+auto SpriteBatch::destroy() -> void {
+  this->device_.unmapMemory(this->vertex_memory_);
+  this->device_.destroyBuffer(this->vertex_buffer_);
+  this->device_.freeMemory(this->vertex_memory_);
+  for (auto &buffer : this->index_buffers_) {
+    this->device_.destroyBuffer(buffer);
+  }
+  this->device_.freeMemory(this->index_memory_);
+}
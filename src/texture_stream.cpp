@@ -0,0 +1,251 @@
+#include "texture_stream.hpp"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <tuple>
+
+namespace {
+
+// mid grey, neither black nor white stands out while the texture streams in
+::std::array<unsigned char, 4> const kPlaceholderTexel{128, 128, 128, 255};
+
+} // namespace
+
+TextureStreamer::TextureStreamer(::vk::PhysicalDevice &physical,
+                                 ::vk::Device &device,
+                                 QueueFamilyIndices &indices,
+                                 ::vk::Queue &queue,
+                                 DeviceFeatures const &features,
+                                 ::vk::DeviceSize frame_budget)
+    : physical_{physical}, device_{device}, indices_{indices}, queue_{queue},
+      features_{features}, frame_budget_{frame_budget} {
+  this->cmdpool_ = create_command_pool(this->device_, this->indices_);
+  if (this->features_.timeline_semaphore) {
+    ::vk::SemaphoreTypeCreateInfo type_info;
+    type_info.setSemaphoreType(::vk::SemaphoreType::eTimeline)
+        .setInitialValue(0);
+    ::vk::SemaphoreCreateInfo info;
+    info.setPNext(&type_info);
+    this->timeline_ = this->device_.createSemaphore(info);
+    assert(this->timeline_ && "timeline semaphore create failed!");
+  }
+
+  // the placeholder is tiny, upload it synchronously
+  ::std::vector images{
+      wrap_image(this->physical_, this->device_, this->indices_,
+                 Image{kPlaceholderTexel.data(), 1, 1},
+                 ::vk::ImageUsageFlagBits::eSampled, this->features_),
+  };
+  ::std::vector<::vk::Image> placeholders;
+  ::std::tie(placeholders, this->placeholder_memory_) =
+      allocate_memory<::vk::Image>(this->physical_, this->device_,
+                                   this->cmdpool_, this->queue_, images,
+                                   ::vk::MemoryPropertyFlagBits::eDeviceLocal);
+  this->placeholder_ = placeholders.front();
+  this->placeholder_view_ =
+      create_image_view(this->device_, this->placeholder_,
+                        ::std::get<3>(images.front()).get_format());
+
+  unsigned int count =
+      ::std::max(::std::thread::hardware_concurrency(), 2u) - 1;
+  for (unsigned int i = 0; i < count; ++i) {
+    this->workers_.emplace_back(&TextureStreamer::work, this);
+  }
+}
+
+TextureStreamer::~TextureStreamer() { this->stop_workers(); }
+
+auto TextureStreamer::request(::std::function<Image()> load)
+    -> TextureHandle {
+  auto handle = static_cast<TextureHandle>(this->textures_.size());
+  this->textures_.emplace_back();
+  {
+    ::std::lock_guard lock{this->mutex_};
+    this->jobs_.push_back(Job{handle, ::std::move(load)});
+  }
+  this->cond_.notify_one();
+  return handle;
+}
+
+auto TextureStreamer::request(::std::filesystem::path const &filename,
+                              int channels, bool srgb) -> TextureHandle {
+  return this->request([filename, channels, srgb] {
+    return generate_mipmaps(create_image_data(filename, channels, srgb));
+  });
+}
+
+auto TextureStreamer::update() -> ::std::vector<TextureHandle> {
+  ::std::vector<TextureHandle> residents;
+  this->retire(residents);
+
+  {
+    ::std::lock_guard lock{this->mutex_};
+    for (auto &loaded : this->loaded_) {
+      this->ready_.emplace_back(::std::move(loaded));
+    }
+    this->loaded_.clear();
+  }
+
+  // the first upload of a frame always goes, so one texture larger than the
+  // budget can not block the queue forever
+  Batch batch;
+  ::vk::DeviceSize spent{0};
+  while (!this->ready_.empty()) {
+    auto &[handle, image] = this->ready_.front();
+    ::vk::DeviceSize size = image.get_size();
+    if (spent != 0 && spent + size > this->frame_budget_) {
+      break;
+    }
+    spent += size;
+    if (this->upload(handle, image, batch)) {
+      this->textures_[handle].resident = true;
+      residents.emplace_back(handle);
+    }
+    this->ready_.pop_front();
+  }
+  if (!batch.cmd_buffer) {
+    return residents;
+  }
+
+  batch.cmd_buffer.end();
+  ::vk::SubmitInfo submit_info;
+  submit_info.setCommandBuffers(batch.cmd_buffer);
+  ::vk::TimelineSemaphoreSubmitInfo timeline_info;
+  if (this->timeline_) {
+    batch.value = ++this->timeline_value_;
+    timeline_info.setSignalSemaphoreValues(batch.value);
+    submit_info.setSignalSemaphores(this->timeline_).setPNext(&timeline_info);
+  } else {
+    batch.fence = this->device_.createFence(::vk::FenceCreateInfo{});
+    assert(batch.fence && "fence create failed!");
+  }
+  this->queue_.submit(submit_info, batch.fence);
+  this->batches_.emplace_back(::std::move(batch));
+  return residents;
+}
+
+auto TextureStreamer::get_view(TextureHandle handle) const -> ::vk::ImageView {
+  auto const &texture = this->textures_[handle];
+  return texture.resident ? texture.view : this->placeholder_view_;
+}
+
+auto TextureStreamer::is_resident(TextureHandle handle) const -> bool {
+  return this->textures_[handle].resident;
+}
+
+auto TextureStreamer::destroy() -> void {
+  this->stop_workers();
+  this->queue_.waitIdle();
+  ::std::vector<TextureHandle> residents;
+  this->retire(residents);
+  assert(this->batches_.empty() && "texture uploads still pending!");
+
+  for (auto &texture : this->textures_) {
+    this->device_.destroyImageView(texture.view);
+    this->device_.destroyImage(texture.image);
+    this->device_.freeMemory(texture.memory);
+  }
+  this->textures_.clear();
+  this->ready_.clear();
+  this->device_.destroyImageView(this->placeholder_view_);
+  this->device_.destroyImage(this->placeholder_);
+  this->device_.freeMemory(this->placeholder_memory_);
+  this->device_.destroySemaphore(this->timeline_);
+  this->device_.destroyCommandPool(this->cmdpool_);
+}
+
+auto TextureStreamer::work() -> void {
+  while (true) {
+    Job job;
+    {
+      ::std::unique_lock lock{this->mutex_};
+      this->cond_.wait(
+          lock, [this] { return this->is_stopped_ || !this->jobs_.empty(); });
+      if (this->is_stopped_) {
+        return;
+      }
+      job = ::std::move(this->jobs_.front());
+      this->jobs_.pop_front();
+    }
+    Image image = job.load();
+    ::std::lock_guard lock{this->mutex_};
+    this->loaded_.emplace_back(job.handle, ::std::move(image));
+  }
+}
+
+auto TextureStreamer::stop_workers() -> void {
+  {
+    ::std::lock_guard lock{this->mutex_};
+    this->is_stopped_ = true;
+  }
+  this->cond_.notify_all();
+  for (auto &worker : this->workers_) {
+    worker.join();
+  }
+  this->workers_.clear();
+}
+
+auto TextureStreamer::retire(::std::vector<TextureHandle> &residents)
+    -> void {
+  while (!this->batches_.empty() && this->is_finished(this->batches_.front())) {
+    auto &batch = this->batches_.front();
+    for (auto &[buffer, memory] : batch.stagings) {
+      this->device_.destroyBuffer(buffer);
+      this->device_.freeMemory(memory);
+    }
+    for (auto handle : batch.handles) {
+      this->textures_[handle].resident = true;
+      residents.emplace_back(handle);
+    }
+    this->device_.freeCommandBuffers(this->cmdpool_, batch.cmd_buffer);
+    this->device_.destroyFence(batch.fence);
+    this->batches_.pop_front();
+  }
+}
+
+auto TextureStreamer::is_finished(Batch const &batch) const -> bool {
+  if (batch.fence) {
+    return this->device_.getFenceStatus(batch.fence) == ::vk::Result::eSuccess;
+  }
+  return this->device_.getSemaphoreCounterValue(this->timeline_) >=
+         batch.value;
+}
+
+auto TextureStreamer::upload(TextureHandle handle, Image const &image,
+                             Batch &batch) -> bool {
+  auto [staging, staging_memory, device_image, data] =
+      wrap_image(this->physical_, this->device_, this->indices_, image,
+                 ::vk::ImageUsageFlagBits::eSampled, this->features_);
+  auto &texture = this->textures_[handle];
+  texture.image = device_image;
+  texture.memory =
+      allocate_memory(this->physical_, this->device_, texture.image,
+                      ::vk::MemoryPropertyFlagBits::eDeviceLocal);
+  texture.view = create_image_view(this->device_, texture.image,
+                                   data.get_format(),
+                                   static_cast<uint32_t>(data.get_levels()));
+  // a host image copy is complete when it returns
+  if (!staging) {
+    copy_image(this->device_, data, texture.image);
+    return true;
+  }
+
+  if (!batch.cmd_buffer) {
+    batch.cmd_buffer =
+        allocate_command_buffers(this->device_, this->cmdpool_, 1).front();
+    ::vk::CommandBufferBeginInfo begin_info;
+    begin_info.setFlags(::vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    batch.cmd_buffer.begin(begin_info);
+  }
+  record_copy_image(batch.cmd_buffer, staging, texture.image,
+                    static_cast<uint32_t>(data.get_width()),
+                    static_cast<uint32_t>(data.get_height()),
+                    static_cast<uint32_t>(data.get_levels()),
+                    data.get_format());
+  batch.stagings.emplace_back(staging, staging_memory);
+  batch.handles.emplace_back(handle);
+  return false;
+}
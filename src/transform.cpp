@@ -0,0 +1,369 @@
+#include "transform.hpp"
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+#include <initializer_list>
+#include <thread>
+#include <type_traits>
+
+// SSE2 and NEON are part of the x86-64 and AArch64 baselines, no dispatch
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_SSE 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define TRANSFORM_NEON 1
+#include <arm_neon.h>
+#endif
+
+uint32_t const TransformHierarchy::kNoParent{0xffff'ffff};
+
+namespace {
+
+// levels smaller than this are not worth waking threads for
+size_t const kParallelMin{8192};
+
+::std::array<float, 12> const kIdentity{1.f, 0.f, 0.f, 0.f, 1.f, 0.f,
+                                        0.f, 0.f, 1.f, 0.f, 0.f, 0.f};
+
+// the arrays one batch reads and writes, indexed by slot
+struct Streams {
+  uint32_t const *parents;
+  ::std::array<float const *, 3> translation;
+  ::std::array<float const *, 4> rotation;
+  ::std::array<float const *, 3> scale;
+  ::std::array<float *, 12> world;
+};
+
+template <typename V> auto splat(float value) -> V;
+template <typename V> auto load(float const *src) -> V;
+template <typename V> auto store(float *dest, V value) -> void;
+// src[slots[i]] of every lane, fallback for roots
+template <typename V>
+auto gather(float const *src, uint32_t const *slots, float fallback) -> V;
+
+template <> auto splat<float>(float value) -> float { return value; }
+template <> auto load<float>(float const *src) -> float { return *src; }
+template <> auto store<float>(float *dest, float value) -> void {
+  *dest = value;
+}
+template <>
+auto gather<float>(float const *src, uint32_t const *slots, float fallback)
+    -> float {
+  return slots[0] == TransformHierarchy::kNoParent ? fallback : src[slots[0]];
+}
+
+#if defined(TRANSFORM_SSE) || defined(TRANSFORM_NEON)
+#define TRANSFORM_SIMD 1
+
+// four nodes, one per lane
+struct Lane4 {
+#ifdef TRANSFORM_SSE
+  __m128 value;
+#else
+  float32x4_t value;
+#endif
+};
+
+#ifdef TRANSFORM_SSE
+auto operator+(Lane4 lhs, Lane4 rhs) -> Lane4 {
+  return {_mm_add_ps(lhs.value, rhs.value)};
+}
+auto operator-(Lane4 lhs, Lane4 rhs) -> Lane4 {
+  return {_mm_sub_ps(lhs.value, rhs.value)};
+}
+auto operator*(Lane4 lhs, Lane4 rhs) -> Lane4 {
+  return {_mm_mul_ps(lhs.value, rhs.value)};
+}
+template <> auto splat<Lane4>(float value) -> Lane4 {
+  return {_mm_set1_ps(value)};
+}
+template <> auto load<Lane4>(float const *src) -> Lane4 {
+  return {_mm_loadu_ps(src)};
+}
+template <> auto store<Lane4>(float *dest, Lane4 value) -> void {
+  _mm_storeu_ps(dest, value.value);
+}
+#else
+auto operator+(Lane4 lhs, Lane4 rhs) -> Lane4 {
+  return {vaddq_f32(lhs.value, rhs.value)};
+}
+auto operator-(Lane4 lhs, Lane4 rhs) -> Lane4 {
+  return {vsubq_f32(lhs.value, rhs.value)};
+}
+auto operator*(Lane4 lhs, Lane4 rhs) -> Lane4 {
+  return {vmulq_f32(lhs.value, rhs.value)};
+}
+template <> auto splat<Lane4>(float value) -> Lane4 {
+  return {vdupq_n_f32(value)};
+}
+template <> auto load<Lane4>(float const *src) -> Lane4 {
+  return {vld1q_f32(src)};
+}
+template <> auto store<Lane4>(float *dest, Lane4 value) -> void {
+  vst1q_f32(dest, value.value);
+}
+#endif
+
+template <>
+auto gather<Lane4>(float const *src, uint32_t const *slots, float fallback)
+    -> Lane4 {
+  alignas(16) ::std::array<float, 4> values;
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = gather<float>(src, slots + i, fallback);
+  }
+  return load<Lane4>(values.data());
+}
+
+#endif
+
+// world = parent world * translate * rotate * scale for the nodes in the
+// lanes of V starting at slot, their parents must be up to date
+template <typename V>
+auto update_batch(Streams const &streams, size_t slot) -> void {
+  V x = load<V>(streams.rotation[0] + slot);
+  V y = load<V>(streams.rotation[1] + slot);
+  V z = load<V>(streams.rotation[2] + slot);
+  V w = load<V>(streams.rotation[3] + slot);
+  V sx = load<V>(streams.scale[0] + slot);
+  V sy = load<V>(streams.scale[1] + slot);
+  V sz = load<V>(streams.scale[2] + slot);
+  V one = splat<V>(1.f);
+  V two = splat<V>(2.f);
+  V xx = x * x, yy = y * y, zz = z * z;
+  V xy = x * y, xz = x * z, yz = y * z;
+  V wx = w * x, wy = w * y, wz = w * z;
+  ::std::array<V, 12> local{
+      (one - two * (yy + zz)) * sx,
+      two * (xy + wz) * sx,
+      two * (xz - wy) * sx,
+      two * (xy - wz) * sy,
+      (one - two * (xx + zz)) * sy,
+      two * (yz + wx) * sy,
+      two * (xz + wy) * sz,
+      two * (yz - wx) * sz,
+      (one - two * (xx + yy)) * sz,
+      load<V>(streams.translation[0] + slot),
+      load<V>(streams.translation[1] + slot),
+      load<V>(streams.translation[2] + slot),
+  };
+
+  ::std::array<V, 12> parent;
+  for (size_t i = 0; i < parent.size(); ++i) {
+    parent[i] =
+        gather<V>(streams.world[i], streams.parents + slot, kIdentity[i]);
+  }
+  for (size_t c = 0; c < 4; ++c) {
+    for (size_t r = 0; r < 3; ++r) {
+      V value = parent[r] * local[c * 3] + parent[3 + r] * local[c * 3 + 1] +
+                parent[6 + r] * local[c * 3 + 2];
+      if (c == 3) {
+        value = value + parent[9 + r];
+      }
+      store<V>(streams.world[c * 3 + r] + slot, value);
+    }
+  }
+}
+
+} // namespace
+
+auto TransformHierarchy::add(uint32_t parent) -> uint32_t {
+  auto id = static_cast<uint32_t>(this->slots_.size());
+  assert((parent == kNoParent || parent < id) &&
+         "transform parent does not exist!");
+  uint32_t parent_slot =
+      parent == kNoParent ? kNoParent : this->slots_[parent];
+  this->parents_.push_back(parent_slot);
+  this->depths_.push_back(
+      parent == kNoParent ? 0 : this->depths_[parent_slot] + 1);
+  this->ids_.push_back(id);
+  this->dirty_.push_back(1);
+  for (auto &values : this->translation_) {
+    values.push_back(0.f);
+  }
+  for (size_t i = 0; i < this->rotation_.size(); ++i) {
+    this->rotation_[i].push_back(i == 3 ? 1.f : 0.f);
+  }
+  for (auto &values : this->scale_) {
+    values.push_back(1.f);
+  }
+  for (size_t i = 0; i < this->world_.size(); ++i) {
+    this->world_[i].push_back(kIdentity[i]);
+  }
+  this->slots_.push_back(static_cast<uint32_t>(this->parents_.size() - 1));
+  this->sorted_ = false;
+  return id;
+}
+
+auto TransformHierarchy::set_translation(uint32_t id,
+                                         ::glm::vec3 const &translation)
+    -> void {
+  uint32_t slot = this->slots_[id];
+  for (int i = 0; i < 3; ++i) {
+    this->translation_[i][slot] = translation[i];
+  }
+  this->dirty_[slot] = 1;
+}
+
+auto TransformHierarchy::set_rotation(uint32_t id, ::glm::quat const &rotation)
+    -> void {
+  uint32_t slot = this->slots_[id];
+  this->rotation_[0][slot] = rotation.x;
+  this->rotation_[1][slot] = rotation.y;
+  this->rotation_[2][slot] = rotation.z;
+  this->rotation_[3][slot] = rotation.w;
+  this->dirty_[slot] = 1;
+}
+
+auto TransformHierarchy::set_scale(uint32_t id, ::glm::vec3 const &scale)
+    -> void {
+  uint32_t slot = this->slots_[id];
+  for (int i = 0; i < 3; ++i) {
+    this->scale_[i][slot] = scale[i];
+  }
+  this->dirty_[slot] = 1;
+}
+
+auto TransformHierarchy::update(unsigned thread_count) -> void {
+  if (!this->sorted_) {
+    this->sort();
+  }
+  // parents come first, one pass carries dirtiness down whole subtrees
+  for (size_t slot = 0; slot < this->size(); ++slot) {
+    uint32_t parent = this->parents_[slot];
+    if (parent != kNoParent && this->dirty_[parent]) {
+      this->dirty_[slot] = 1;
+    }
+  }
+
+  for (size_t level = 0; level + 1 < this->levels_.size(); ++level) {
+    size_t begin = this->levels_[level];
+    size_t end = this->levels_[level + 1];
+    if (thread_count < 2 || end - begin < kParallelMin) {
+      this->update_range(begin, end);
+      continue;
+    }
+    // chunks start on a batch boundary, the caller takes the first one
+    size_t chunk = (end - begin + thread_count - 1) / thread_count;
+    chunk = (chunk + 3) / 4 * 4;
+    ::std::vector<::std::thread> threads;
+    for (size_t first = begin + chunk; first < end; first += chunk) {
+      size_t last = ::std::min(first + chunk, end);
+      threads.emplace_back(
+          [this, first, last] { this->update_range(first, last); });
+    }
+    this->update_range(begin, ::std::min(begin + chunk, end));
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+  ::std::fill(this->dirty_.begin(), this->dirty_.end(), 0);
+}
+
+auto TransformHierarchy::get_world(uint32_t id) const -> ::glm::mat4 {
+  uint32_t slot = this->slots_[id];
+  ::glm::mat4 world{1.f};
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 3; ++r) {
+      world[c][r] = this->world_[c * 3 + r][slot];
+    }
+  }
+  return world;
+}
+
+auto TransformHierarchy::write_world(void *dest, size_t stride) const -> void {
+  auto *bytes = static_cast<unsigned char *>(dest);
+  for (uint32_t id = 0; id < this->slots_.size(); ++id) {
+    ::glm::mat4 world = this->get_world(id);
+    ::memcpy(bytes + id * stride, &world, sizeof(world));
+  }
+}
+
+auto TransformHierarchy::sort() -> void {
+  size_t count = this->size();
+  uint32_t max_depth{0};
+  for (auto depth : this->depths_) {
+    max_depth = ::std::max(max_depth, depth);
+  }
+  // stable counting sort by depth, order[new slot] is the old slot
+  this->levels_.assign(max_depth + 2, 0);
+  for (auto depth : this->depths_) {
+    ++this->levels_[depth + 1];
+  }
+  for (size_t i = 1; i < this->levels_.size(); ++i) {
+    this->levels_[i] += this->levels_[i - 1];
+  }
+  ::std::vector<size_t> next(this->levels_.begin(), this->levels_.end() - 1);
+  ::std::vector<uint32_t> order(count);
+  ::std::vector<uint32_t> new_slots(count);
+  for (uint32_t slot = 0; slot < count; ++slot) {
+    auto new_slot = next[this->depths_[slot]]++;
+    order[new_slot] = slot;
+    new_slots[slot] = static_cast<uint32_t>(new_slot);
+  }
+
+  auto permute = [&order](auto &values) {
+    ::std::remove_reference_t<decltype(values)> sorted(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      sorted[i] = values[order[i]];
+    }
+    values.swap(sorted);
+  };
+  permute(this->parents_);
+  for (auto &parent : this->parents_) {
+    if (parent != kNoParent) {
+      parent = new_slots[parent];
+    }
+  }
+  permute(this->depths_);
+  permute(this->ids_);
+  permute(this->dirty_);
+  for (auto *group : {&this->translation_, &this->scale_}) {
+    for (auto &values : *group) {
+      permute(values);
+    }
+  }
+  for (auto &values : this->rotation_) {
+    permute(values);
+  }
+  for (auto &values : this->world_) {
+    permute(values);
+  }
+  for (uint32_t slot = 0; slot < count; ++slot) {
+    this->slots_[this->ids_[slot]] = slot;
+  }
+  this->sorted_ = true;
+}
+
+auto TransformHierarchy::update_range(size_t begin, size_t end) -> void {
+  Streams streams{this->parents_.data(), {}, {}, {}, {}};
+  for (size_t i = 0; i < 3; ++i) {
+    streams.translation[i] = this->translation_[i].data();
+    streams.scale[i] = this->scale_[i].data();
+  }
+  for (size_t i = 0; i < 4; ++i) {
+    streams.rotation[i] = this->rotation_[i].data();
+  }
+  for (size_t i = 0; i < 12; ++i) {
+    streams.world[i] = this->world_[i].data();
+  }
+
+  size_t slot = begin;
+#ifdef TRANSFORM_SIMD
+  // a batch with any dirty node is recomputed whole, clean lanes come out
+  // the same
+  for (; slot + 4 <= end; slot += 4) {
+    if (this->dirty_[slot] | this->dirty_[slot + 1] | this->dirty_[slot + 2] |
+        this->dirty_[slot + 3]) {
+      update_batch<Lane4>(streams, slot);
+    }
+  }
+#endif
+  for (; slot < end; ++slot) {
+    if (this->dirty_[slot]) {
+      update_batch<float>(streams, slot);
+    }
+  }
+}
@@ -0,0 +1,59 @@
+#include "uniform_ring.hpp"
+
+#include <assert.h>
+#include <string.h>
+
+namespace {
+
+auto align_up(::vk::DeviceSize value, ::vk::DeviceSize alignment)
+    -> ::vk::DeviceSize {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+UniformRing::UniformRing(::vk::PhysicalDevice &physical, ::vk::Device &device,
+                         QueueFamilyIndices &indices, uint32_t frame_count,
+                         bool device_address, ::vk::DeviceSize frame_size)
+    : device_{device} {
+  this->alignment_ =
+      physical.getProperties().limits.minUniformBufferOffsetAlignment;
+  this->frame_size_ = align_up(frame_size, this->alignment_);
+  ::vk::BufferUsageFlags usage{::vk::BufferUsageFlagBits::eUniformBuffer};
+  ::vk::MemoryAllocateFlags alloc_flag;
+  if (device_address) {
+    usage |= ::vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    alloc_flag = ::vk::MemoryAllocateFlagBits::eDeviceAddress;
+  }
+  this->buffer_ = create_buffer(this->device_, indices,
+                                this->frame_size_ * frame_count, usage);
+  this->memory_ =
+      allocate_memory(physical, this->device_, this->buffer_,
+                      ::vk::MemoryPropertyFlagBits::eHostVisible |
+                          ::vk::MemoryPropertyFlagBits::eHostCoherent,
+                      alloc_flag);
+  // coherent memory stays mapped for the ring's whole life
+  this->mapped_ = static_cast<unsigned char *>(
+      this->device_.mapMemory(this->memory_, 0, VK_WHOLE_SIZE));
+  assert(this->mapped_ && "uniform ring map failed!");
+}
+
+auto UniformRing::begin_frame(size_t frame) -> void {
+  this->begin_ = this->frame_size_ * frame;
+  this->head_ = this->begin_;
+}
+
+auto UniformRing::push(void const *data, ::vk::DeviceSize size) -> uint32_t {
+  assert(this->head_ + size <= this->begin_ + this->frame_size_ &&
+         "uniform ring frame is full!");
+  ::vk::DeviceSize offset = this->head_;
+  ::memcpy(this->mapped_ + offset, data, size);
+  this->head_ = align_up(offset + size, this->alignment_);
+  return static_cast<uint32_t>(offset);
+}
+
+auto UniformRing::destroy() -> void {
+  this->device_.unmapMemory(this->memory_);
+  this->device_.destroyBuffer(this->buffer_);
+  this->device_.freeMemory(this->memory_);
+}
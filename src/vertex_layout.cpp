@@ -0,0 +1,90 @@
+#include "vertex_layout.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// round to nearest even, overflow saturates to infinity
+auto pack_half(float value) -> uint16_t {
+  uint32_t bits{0};
+  ::memcpy(&bits, &value, sizeof(bits));
+  auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  uint32_t magnitude = bits & 0x7fff'ffff;
+  if (magnitude >= 0x7f80'0000) {
+    // infinity stays infinity, NaN stays quiet NaN
+    return sign | (magnitude > 0x7f80'0000 ? 0x7e00 : 0x7c00);
+  }
+  if (magnitude >= 0x477f'f000) {
+    // 65520 and above round past the largest half, 65504
+    return sign | 0x7c00;
+  }
+  if (magnitude < 0x3880'0000) {
+    // below 2^-14 the half is subnormal, its unit is 2^-24
+    float absolute{0.f};
+    ::memcpy(&absolute, &magnitude, sizeof(absolute));
+    return sign | static_cast<uint16_t>(::std::nearbyint(absolute * 0x1p24f));
+  }
+  // rebias the exponent from 127 to 15 and drop 13 mantissa bits
+  uint32_t rounded = magnitude + 0x0fff + ((magnitude >> 13) & 1);
+  return sign | static_cast<uint16_t>((rounded - 0x3800'0000) >> 13);
+}
+
+// value in [-1, 1] to a signed integer of the given maximum
+auto pack_snorm(float value, float max) -> int32_t {
+  return static_cast<int32_t>(
+      ::std::lrint(::std::clamp(value, -1.f, 1.f) * max));
+}
+
+// value in [0, 1] to an unsigned integer of the given maximum
+auto pack_unorm(float value, float max) -> uint32_t {
+  return static_cast<uint32_t>(
+      ::std::lrint(::std::clamp(value, 0.f, 1.f) * max));
+}
+
+} // namespace
+
+Half2::Half2(::glm::vec2 const &value)
+    : bits{pack_half(value.x), pack_half(value.y)} {}
+
+Half4::Half4(::glm::vec4 const &value)
+    : bits{pack_half(value.x), pack_half(value.y), pack_half(value.z),
+           pack_half(value.w)} {}
+
+Snorm16x2::Snorm16x2(::glm::vec2 const &value)
+    : bits{static_cast<int16_t>(pack_snorm(value.x, 32767.f)),
+           static_cast<int16_t>(pack_snorm(value.y, 32767.f))} {}
+
+Snorm16x4::Snorm16x4(::glm::vec4 const &value)
+    : bits{static_cast<int16_t>(pack_snorm(value.x, 32767.f)),
+           static_cast<int16_t>(pack_snorm(value.y, 32767.f)),
+           static_cast<int16_t>(pack_snorm(value.z, 32767.f)),
+           static_cast<int16_t>(pack_snorm(value.w, 32767.f))} {}
+
+Snorm8x4::Snorm8x4(::glm::vec4 const &value)
+    : bits{static_cast<int8_t>(pack_snorm(value.x, 127.f)),
+           static_cast<int8_t>(pack_snorm(value.y, 127.f)),
+           static_cast<int8_t>(pack_snorm(value.z, 127.f)),
+           static_cast<int8_t>(pack_snorm(value.w, 127.f))} {}
+
+Unorm16x2::Unorm16x2(::glm::vec2 const &value)
+    : bits{static_cast<uint16_t>(pack_unorm(value.x, 65535.f)),
+           static_cast<uint16_t>(pack_unorm(value.y, 65535.f))} {}
+
+Unorm8x4::Unorm8x4(::glm::vec4 const &value)
+    : bits{pack_unorm(value.x, 255.f) | pack_unorm(value.y, 255.f) << 8 |
+           pack_unorm(value.z, 255.f) << 16 |
+           pack_unorm(value.w, 255.f) << 24} {}
+
+Unorm1010102::Unorm1010102(::glm::vec4 const &value)
+    : bits{pack_unorm(value.x, 1023.f) | pack_unorm(value.y, 1023.f) << 10 |
+           pack_unorm(value.z, 1023.f) << 20 |
+           pack_unorm(value.w, 3.f) << 30} {}
+
+Snorm1010102::Snorm1010102(::glm::vec4 const &value)
+    : bits{(static_cast<uint32_t>(pack_snorm(value.x, 511.f)) & 0x3ff) |
+           (static_cast<uint32_t>(pack_snorm(value.y, 511.f)) & 0x3ff) << 10 |
+           (static_cast<uint32_t>(pack_snorm(value.z, 511.f)) & 0x3ff) << 20 |
+           static_cast<uint32_t>(pack_snorm(value.w, 1.f)) << 30} {}
@@ -1,11 +1,33 @@
 target("VulkanBase")
     set_kind("static")
-    add_files("base_type.cpp"
+    add_files("atlas.cpp"
+              ,"base_type.cpp"
+              ,"bindless.cpp"
               ,"create.cpp"
+              ,"culling.cpp"
+              ,"depth_pyramid.cpp"
+              ,"descriptor_allocator.cpp"
+              ,"descriptor_buffer.cpp"
+              ,"draw_order.cpp"
+              ,"gpu_culling.cpp"
+              ,"image_cache.cpp"
+              ,"layout_cache.cpp"
+              ,"mesh.cpp"
+              ,"mesh_lod.cpp"
+              ,"occlusion_culling.cpp"
+              ,"pixel_convert.cpp"
+              ,"shader_watcher.cpp"
+              ,"sprite_batch.cpp"
+              ,"texture_stream.cpp"
+              ,"transform.cpp"
+              ,"uniform_ring.cpp"
+              ,"vertex_layout.cpp"
               ,"window.cpp"
     )
     add_includedirs(path.join("$(projectdir)", "include"))
     add_includedirs(path.join("$(projectdir)", "third-party"))
+    -- extension entry points are resolved at runtime, see create.cpp
+    add_defines("VULKAN_HPP_DISPATCH_LOADER_DYNAMIC=1", {public = true})
     before_build_file(enable_clang_tidy)
     on_load(function (target)
             target:add(find_packages("vulkan", "sdl2"))